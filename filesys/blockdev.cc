@@ -0,0 +1,330 @@
+// blockdev.cc
+//	Routines to make several simulated disks look like one, by
+//	striping or mirroring the sectors across them.
+//
+//	A request is split into a part for each disk, and the parts are
+//	all started at once; each disk interrupts when its part is done,
+//	and the last of them finishes off the request.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "blockdev.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// BlockDeviceDone
+// 	Disk interrupt handler, for every disk of the device.  Need this
+//	to be a C routine, because C++ can't handle pointers to member
+//	functions.
+//----------------------------------------------------------------------
+
+static void
+BlockDeviceDone(int arg)
+{
+    DeviceDisk *port = (DeviceDisk *) arg;
+
+    port->device->DiskDone(port->which);
+}
+
+//----------------------------------------------------------------------
+// BlockDevice::BlockDevice
+// 	Create the disks of the device, each in its own UNIX file.
+//
+//	"names" -- UNIX file holding each disk
+//	"count" -- number of disks
+//	"raidLevel" -- whether to stripe or mirror the sectors
+//	"callWhenDone", "callArg" -- called when each request is done
+//	"backing", "newSectorsPerTrack", "newNumTracks" -- for each
+//	   disk; see Disk::Disk
+//----------------------------------------------------------------------
+
+BlockDevice::BlockDevice(char **names, int count, RaidLevel raidLevel,
+		VoidFunctionPtr callWhenDone, int callArg, DiskBacking backing,
+		int newSectorsPerTrack, int newNumTracks)
+{
+    ASSERT(count > 0);
+    level = raidLevel;
+    numDisks = count;
+    handler = callWhenDone;
+    handlerArg = callArg;
+    disks = new Disk *[numDisks];
+    ports = new DeviceDisk[numDisks];
+    sent = new int[numDisks];
+    for (int i = 0; i < numDisks; i++) {
+	ports[i].device = this;
+	ports[i].which = i;
+	disks[i] = new Disk(names[i], BlockDeviceDone, (int) &ports[i],
+	    backing, newSectorsPerTrack, newNumTracks);
+	ASSERT(disks[i]->SectorsPerTrack() == disks[0]->SectorsPerTrack()
+	    && disks[i]->NumTracks() == disks[0]->NumTracks());
+	sent[i] = 0;
+    }
+    sectorsPerTrack = disks[0]->SectorsPerTrack();
+    numTracks = disks[0]->NumTracks();
+    if (level == Raid0) {
+	ASSERT(sectorsPerTrack % StripeSectors == 0);
+	sectorsPerTrack *= numDisks;
+    }
+    active = NULL;
+    numActive = 0;
+    lastDone = NULL;
+    DEBUG('d', "Block device: %d disk%s, RAID-%d, %d tracks of %d sectors\n",
+	numDisks, (numDisks == 1) ? "" : "s", (level == Raid0) ? 0 : 1,
+	numTracks, sectorsPerTrack);
+}
+
+//----------------------------------------------------------------------
+// BlockDevice::~BlockDevice
+// 	Close each of the disks.
+//----------------------------------------------------------------------
+
+BlockDevice::~BlockDevice()
+{
+    for (int i = 0; i < numDisks; i++)
+	delete disks[i];
+    delete [] disks;
+    delete [] ports;
+    delete [] sent;
+}
+
+//----------------------------------------------------------------------
+// BlockDevice::SetModel
+// 	Make every disk of the device behave as "model" says; see
+//	Disk::SetModel.
+//----------------------------------------------------------------------
+
+void
+BlockDevice::SetModel(DiskModel *model)
+{
+    for (int i = 0; i < numDisks; i++)
+	disks[i]->SetModel(model);
+}
+
+//----------------------------------------------------------------------
+// BlockDevice::ReadvRequest/WritevRequest
+// 	Start reading/writing a list of sectors of the device, as one
+//	request; "handler" is called once all of them are done.
+//
+//	"sectors" -- the sectors to read/write, in order
+//	"data" -- data[i] holds the bytes for sectors[i]
+//	"count" -- number of sectors in the request
+//----------------------------------------------------------------------
+
+void
+BlockDevice::ReadvRequest(int *sectors, char **data, int count)
+{
+    Start(sectors, data, count, FALSE);
+}
+
+void
+BlockDevice::WritevRequest(int *sectors, char **data, int count)
+{
+    Start(sectors, data, count, TRUE);
+}
+
+//----------------------------------------------------------------------
+// BlockDevice::Split
+// 	Work out which sectors of which disks a request needs, and put
+//	them, in order, in partSectors[d] and partData[d] for each disk d,
+//	newly allocated.  Disks with nothing to do get a count of 0.  If
+//	"data" is NULL, only the sectors are filled in.
+//
+//	For a mirrored read, the pieces are handed out one at a time, to
+//	the disk with the lowest latency to the first sector of the piece
+//	(cf. Disk::ComputeLatency, which counts the seek from the last
+//	sector that disk was asked for).  Ties go to the lowest disk.
+//----------------------------------------------------------------------
+
+void
+BlockDevice::Split(int *sectors, char **data, int count, bool writing,
+		int **partSectors, char ***partData, int *partCount)
+{
+    int i, j, n, d, best, latency, bestLatency, first, last;
+    int stripeRow = StripeSectors * numDisks;
+
+    for (d = 0; d < numDisks; d++) {
+	partSectors[d] = new int[count];
+	if (data != NULL)
+	    partData[d] = new char *[count];
+	partCount[d] = 0;
+    }
+
+    if (level == Raid0) {
+	for (i = 0; i < count; i++) {
+	    ASSERT(sectors[i] >= 0 && sectors[i] < NumSectors());
+	    d = (sectors[i] / StripeSectors) % numDisks;
+	    n = partCount[d]++;
+	    partSectors[d][n] = (sectors[i] / stripeRow) * StripeSectors
+					+ sectors[i] % StripeSectors;
+	    if (data != NULL)
+		partData[d][n] = data[i];
+	}
+    } else if (writing) {
+	for (d = 0; d < numDisks; d++) {
+	    bcopy((char *) sectors, (char *) partSectors[d],
+		count * sizeof(int));
+	    if (data != NULL)
+		bcopy((char *) data, (char *) partData[d],
+		    count * sizeof(char *));
+	    partCount[d] = count;
+	}
+    } else {
+	n = min(numDisks, divRoundUp(count, StripeSectors));
+	for (j = 0; j < n; j++) {
+	    first = j * count / n;
+	    last = (j + 1) * count / n;
+	    best = -1;
+	    bestLatency = 0;
+	    for (d = 0; d < numDisks; d++) {
+		if (partCount[d] > 0)
+		    continue;		// already has a piece
+		latency = disks[d]->ComputeLatency(sectors[first], FALSE);
+		if (best == -1 || latency < bestLatency) {
+		    best = d;
+		    bestLatency = latency;
+		}
+	    }
+	    for (i = first; i < last; i++) {
+		partSectors[best][i - first] = sectors[i];
+		if (data != NULL)
+		    partData[best][i - first] = data[i];
+	    }
+	    partCount[best] = last - first;
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// BlockDevice::Start
+// 	Send each disk its part of a request.  With only one disk, the
+//	request goes to it as it is.
+//----------------------------------------------------------------------
+
+void
+BlockDevice::Start(int *sectors, char **data, int count, bool writing)
+{
+    DeviceRequest *request = new DeviceRequest, **link;
+    int d;
+
+    ASSERT(numActive < QueueDepth());	// too many requests
+    request->sectors = sectors;
+    request->partSectors = new int *[numDisks];
+    request->partData = new char **[numDisks];
+    request->partCount = new int[numDisks];
+    if (numDisks == 1) {
+	request->partSectors[0] = sectors;
+	request->partData[0] = data;
+	request->partCount[0] = count;
+    } else
+	Split(sectors, data, count, writing, request->partSectors,
+	    request->partData, request->partCount);
+    request->pending = 0;
+    for (d = 0; d < numDisks; d++)
+	if (request->partCount[d] > 0)
+	    request->pending++;
+    request->next = NULL;
+    for (link = &active; *link != NULL; link = &(*link)->next)
+	;
+    *link = request;
+    numActive++;
+
+    for (d = 0; d < numDisks; d++) {
+	if (request->partCount[d] == 0)
+	    continue;
+	DEBUG('d', "Disk %d gets %d of %d sectors, starting at %d\n", d,
+	    request->partCount[d], count, request->partSectors[d][0]);
+	sent[d]++;
+	if (writing)
+	    disks[d]->WritevRequest(request->partSectors[d],
+		request->partData[d], request->partCount[d]);
+	else
+	    disks[d]->ReadvRequest(request->partSectors[d],
+		request->partData[d], request->partCount[d]);
+    }
+}
+
+//----------------------------------------------------------------------
+// BlockDevice::DiskDone
+// 	Disk "which" has finished its part of a request: the oldest one
+//	whose part on that disk has the sector list the disk says it
+//	finished.  If that was the last part, throw the parts away, and
+//	say the request is done.
+//----------------------------------------------------------------------
+
+void
+BlockDevice::DiskDone(int which)
+{
+    int *done = disks[which]->LastDone();
+    DeviceRequest **link, *request;
+
+    for (link = &active; *link != NULL; link = &(*link)->next)
+	if ((*link)->partCount[which] > 0
+		&& (*link)->partSectors[which] == done)
+	    break;
+    request = *link;
+    ASSERT(request != NULL);
+    request->partCount[which] = 0;
+    if (--request->pending > 0)
+	return;
+
+    *link = request->next;
+    numActive--;
+    if (numDisks > 1)
+	for (int d = 0; d < numDisks; d++) {
+	    delete [] request->partSectors[d];
+	    delete [] request->partData[d];
+	}
+    delete [] request->partSectors;
+    delete [] request->partData;
+    delete [] request->partCount;
+    lastDone = request->sectors;
+    delete request;
+    (*handler)(handlerArg);
+}
+
+//----------------------------------------------------------------------
+// BlockDevice::CrashAfter
+// 	Simulate the power failing; see Disk::CrashAfter.  Each disk
+//	goes on writing for "numWrites" sectors of its own, so with
+//	striping, the crash comes somewhat later than on one disk.
+//----------------------------------------------------------------------
+
+void
+BlockDevice::CrashAfter(int numWrites)
+{
+    for (int d = 0; d < numDisks; d++)
+	disks[d]->CrashAfter(numWrites);
+}
+
+//----------------------------------------------------------------------
+// BlockDevice::EstimateTime
+// 	Return how long reading "sectors" would take, as a single
+//	request: the time the slowest disk takes over its part.  See
+//	Disk::EstimateTime.
+//----------------------------------------------------------------------
+
+int
+BlockDevice::EstimateTime(int *sectors, int count)
+{
+    int **partSectors, *partCount;
+    int d, ticks = 0;
+
+    if (numDisks == 1)
+	return disks[0]->EstimateTime(sectors, count);
+
+    partSectors = new int *[numDisks];
+    partCount = new int[numDisks];
+    Split(sectors, NULL, count, FALSE, partSectors, NULL, partCount);
+    for (d = 0; d < numDisks; d++) {
+	if (partCount[d] > 0)
+	    ticks = max(ticks, disks[d]->EstimateTime(partSectors[d],
+						      partCount[d]));
+	delete [] partSectors[d];
+    }
+    delete [] partSectors;
+    delete [] partCount;
+    return ticks;
+}
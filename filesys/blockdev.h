@@ -0,0 +1,137 @@
+// blockdev.h
+//	Data structures for a block device: one or more simulated disks
+//	that together look like a single disk to SynchDisk.
+//
+//	With several disks, the sectors of the device are either striped
+//	across them (RAID-0), so that a big request keeps all the disks
+//	busy at once, or mirrored on every one of them (RAID-1), so that
+//	reads can go to whichever disk is closest.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef BLOCKDEV_H
+#define BLOCKDEV_H
+
+#include "disk.h"
+
+// How the sectors of the device are spread over the disks.
+enum RaidLevel { Raid0,			// striped: each disk holds every
+					//  n'th stripe of StripeSectors
+		 Raid1 };		// mirrored: each disk holds them all
+
+// Striping works in units of StripeSectors consecutive sectors, so
+// that a short run of sectors is on a single disk.  It must divide the
+// number of sectors per track, so that a track of the device is the
+// same track on every disk.
+#define StripeSectors		4
+
+class BlockDevice;
+
+// Where the interrupts from each disk of a BlockDevice go.  Internal
+// to the BlockDevice.
+
+class DeviceDisk {
+  public:
+    BlockDevice *device;
+    int which;				// Which of its disks
+};
+
+// A request to a BlockDevice, and each disk's part of it.  Internal
+// to the BlockDevice.
+
+class DeviceRequest {
+  public:
+    int *sectors;			// The sectors asked for
+    int **partSectors;			// Each disk's part: the sectors on
+    char ***partData;			//  that disk, and the buffer for
+    int *partCount;			//  each; 0 once that part is done
+    int pending;			// Parts not yet done
+    DeviceRequest *next;
+};
+
+// The following class defines a block device.  It works just like a
+// Disk: it takes a list of sectors to read or write, and calls back
+// once the request is done; as many requests at a time as the disks
+// each take (see DiskModel).  Underneath, the request is split into
+// one request for each disk that holds any of the sectors, and the
+// disks all work on their parts at the same time; the callback
+// happens once the last of them finishes.
+//
+// Striped, sector s of the device is in stripe s / StripeSectors,
+// and stripes go to the disks in turn, so a track of the device is a
+// track on each of the n disks, n times as long.
+//
+// Mirrored, every write goes to all the disks.  A read is cut into at
+// most one piece per disk, each at least StripeSectors long, and each
+// piece goes to the disk that can get to its first sector soonest,
+// from wherever that disk's head was left by its last request.
+//
+// All the disks must have the same geometry.
+
+class BlockDevice {
+  public:
+    BlockDevice(char **names, int count, RaidLevel raidLevel,
+		VoidFunctionPtr callWhenDone, int callArg,
+		DiskBacking backing, int newSectorsPerTrack,
+		int newNumTracks);
+					// Create the simulated disks in
+					// the UNIX files "names"; see Disk
+    ~BlockDevice();
+
+    void ReadvRequest(int *sectors, char **data, int count);
+    void WritevRequest(int *sectors, char **data, int count);
+					// Start reading/writing the sectors;
+					// at most QueueDepth() at a time
+
+    void SetModel(DiskModel *model);	// Change how every disk behaves
+    int QueueDepth() { return disks[0]->QueueDepth(); }
+					// Requests allowed at a time
+    int *LastDone() { return lastDone; }
+					// The sector list of the request
+					// being reported done
+
+    void CrashAfter(int numWrites);	// Crash each disk after "numWrites"
+					// more sectors; see Disk
+    int EstimateTime(int *sectors, int count);
+					// How long reading them would take,
+					// with every disk working at once
+
+    int SectorsPerTrack() { return sectorsPerTrack; }
+    int NumTracks() { return numTracks; }
+    int NumSectors() { return sectorsPerTrack * numTracks; }
+					// Geometry of the device as a whole
+    int NumDisks() { return numDisks; }
+    Disk *GetDisk(int i) { return disks[i]; }
+    int DiskRequests(int i) { return sent[i]; }
+					// Requests sent to disk "i" so far
+
+    void DiskDone(int which);		// Called when a disk finishes its
+					// part of a request
+
+  private:
+    RaidLevel level;
+    int numDisks;
+    Disk **disks;			// The disks, in stripe order
+    DeviceDisk *ports;			// Where each one interrupts
+    int *sent;				// Requests each disk has been sent
+    int sectorsPerTrack;		// Geometry of the device
+    int numTracks;
+    VoidFunctionPtr handler;		// Called when a request is done
+    int handlerArg;
+
+    DeviceRequest *active;		// Requests not yet done, oldest
+    int numActive;			//  first
+    int *lastDone;			// Sectors of the last one to finish
+
+    void Split(int *sectors, char **data, int count, bool writing,
+		int **partSectors, char ***partData, int *partCount);
+					// Work out each disk's part
+    void Start(int *sectors, char **data, int count, bool writing);
+					// Send the parts to the disks
+};
+
+#endif // BLOCKDEV_H
@@ -1,20 +1,26 @@
 // directory.cc 
 //	Routines to manage a directory of file names.
 //
-//	The directory is a table of fixed length entries; each
-//	entry represents a single file, and contains the file name,
-//	and the location of the file header on disk.  The fixed size
-//	of each directory entry means that we have the restriction
-//	of a fixed maximum size for file names.
-//
-//	The constructor initializes an empty directory of a certain size;
-//	we use ReadFrom/WriteBack to fetch the contents of the directory
+//	The directory is a sequence of SectorSize blocks, each holding
+//	a list of variable length entries; each entry represents a
+//	single file, and contains the file name, whether the file is
+//	itself a directory, and the location of the file header on
+//	disk.  Since an entry never crosses a block boundary, a name
+//	can be at most FileNameMaxLen characters long.
+//
+//	The constructor initializes an empty directory of one block;
+//	we use FetchFrom/WriteBack to fetch the contents of the directory
 //	from disk, and to write back any modifications back to disk.
+//	Only the blocks Add and Remove have changed are written back.
+//
+//	When every block is full, Add tacks a new block onto the end
+//	of the directory; it is up to the caller to grow the directory
+//	file to match before writing it back.
 //
-//	Also, this implementation has the restriction that the size
-//	of the directory cannot expand.  In other words, once all the
-//	entries in the directory are used, no more files can be created.
-//	Fixing this is one of the parts to the assignment.
+//	Lookups go through an in-memory hash table, rebuilt whenever
+//	the directory is read in, so that finding a name does not
+//	require scanning the whole directory.  The table uses open
+//	addressing with linear probing, and is kept at most half full.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -24,6 +30,40 @@
 #include "utility.h"
 #include "filehdr.h"
 #include "directory.h"
+#include "system.h"
+
+#define HashEmpty	-1		// hash slot never used
+#define HashDeleted	-2		// hash slot freed by Remove
+#define MinHashSize	16
+
+//----------------------------------------------------------------------
+// EntrySize
+// 	Return the number of bytes an entry with a "nameLen" character
+//	name takes up in a directory block.
+//----------------------------------------------------------------------
+
+static int
+EntrySize(int nameLen)
+{
+    return divRoundUp(DirEntryHeaderSize + nameLen, 4) * 4;
+}
+
+//----------------------------------------------------------------------
+// HashName
+// 	Hash the first "len" characters of "name" (FNV-1a).
+//----------------------------------------------------------------------
+
+static unsigned int
+HashName(char *name, int len)
+{
+    unsigned int h = 2166136261u;
+
+    for (int i = 0; i < len; i++) {
+	h ^= (unsigned char) name[i];
+	h *= 16777619;
+    }
+    return h;
+}
 
 //----------------------------------------------------------------------
 // Directory::Directory
@@ -32,15 +72,29 @@
 //	is all we need, but otherwise, we need to call FetchFrom in order
 //	to initialize it from disk.
 //
-//	"size" is the number of entries in the directory
+//	An empty directory is one block holding a single unused entry
+//	that covers the whole block.  That block is not on disk yet, so
+//	it starts out dirty.
 //----------------------------------------------------------------------
 
-Directory::Directory(int size)
+Directory::Directory()
 {
-    table = new DirectoryEntry[size];
-    tableSize = size;
-    for (int i = 0; i < tableSize; i++)
-	table[i].inUse = FALSE;
+    DirectoryEntry *e;
+
+    numBlocks = 1;
+    blocks = new char[SectorSize];
+    dirty = new bool[1];
+    dirty[0] = TRUE;
+    lock = new RWLock("directory");
+    e = EntryAt(0);
+    e->sector = -1;
+    e->recLen = SectorSize;
+    e->nameLen = 0;
+    e->flags = 0;
+
+    hashTable = NULL;
+    hashSize = 0;
+    Rehash(MinHashSize);
 }
 
 //----------------------------------------------------------------------
@@ -50,12 +104,16 @@ Directory::Directory(int size)
 
 Directory::~Directory()
 { 
-    delete [] table;
+    delete [] blocks;
+    delete [] dirty;
+    delete [] hashTable;
+    delete lock;
 } 
 
 //----------------------------------------------------------------------
 // Directory::FetchFrom
-// 	Read the contents of the directory from disk.
+// 	Read the contents of the directory from disk, and build the
+//	hash table over its entries.
 //
 //	"file" -- file containing the directory contents
 //----------------------------------------------------------------------
@@ -63,26 +121,134 @@ Directory::~Directory()
 void
 Directory::FetchFrom(OpenFile *file)
 {
-    (void) file->ReadAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    ASSERT((file->Length() % SectorSize) == 0);
+    delete [] blocks;
+    delete [] dirty;
+    numBlocks = file->Length() / SectorSize;
+    blocks = new char[numBlocks * SectorSize];
+    dirty = new bool[numBlocks];
+    for (int i = 0; i < numBlocks; i++)
+	dirty[i] = FALSE;
+    (void) file->ReadAt(blocks, numBlocks * SectorSize, 0);
+    Rehash(MinHashSize);
 }
 
 //----------------------------------------------------------------------
 // Directory::WriteBack
-// 	Write any modifications to the directory back to disk
+// 	Write any modifications to the directory back to disk.  Each run
+//	of changed blocks is written with one WriteAt; blocks that have
+//	not changed are left alone.
 //
-//	"file" -- file to contain the new directory contents
+//	"file" -- file to contain the new directory contents; it must
+//	   already be at least Length() bytes long
 //----------------------------------------------------------------------
 
 void
 Directory::WriteBack(OpenFile *file)
 {
-    (void) file->WriteAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    int first, last;
+
+    ASSERT(file->Length() >= Length());
+    for (first = 0; first < numBlocks; first = last) {
+	if (!dirty[first]) {
+	    last = first + 1;
+	    continue;
+	}
+	for (last = first; last < numBlocks && dirty[last]; last++)
+	    dirty[last] = FALSE;
+	(void) file->WriteAt(&blocks[first * SectorSize],
+			(last - first) * SectorSize, first * SectorSize);
+    }
+}
+
+//----------------------------------------------------------------------
+// Directory::Rehash
+// 	Throw away the hash table and rebuild it from the directory
+//	contents, with at least "size" slots (and enough that it
+//	stays less than a quarter full).  This also clears out the
+//	markers left behind by Remove.
+//----------------------------------------------------------------------
+
+void
+Directory::Rehash(int size)
+{
+    DirectoryEntry *e;
+    int offset, count = 0;
+
+    for (offset = 0; offset < Length(); offset += e->recLen) {
+	e = EntryAt(offset);
+	ASSERT(e->recLen > 0);
+	if (e->flags & DirEntryInUse)
+	    count++;
+    }
+    while (size < 4 * count)
+	size *= 2;			// keep size a power of 2
+
+    delete [] hashTable;
+    hashTable = new int[size];
+    hashSize = size;
+    hashUsed = hashCount = 0;
+    for (int i = 0; i < hashSize; i++)
+	hashTable[i] = HashEmpty;
+
+    for (offset = 0; offset < Length(); offset += e->recLen) {
+	e = EntryAt(offset);
+	if (e->flags & DirEntryInUse)
+	    HashInsert(offset);
+    }
+}
+
+//----------------------------------------------------------------------
+// Directory::HashInsert
+// 	Put the entry at "offset" into the hash table.  The caller
+//	makes sure there is room.
+//----------------------------------------------------------------------
+
+void
+Directory::HashInsert(int offset)
+{
+    DirectoryEntry *e = EntryAt(offset);
+    int i = HashName(e->name, e->nameLen) & (hashSize - 1);
+
+    while (hashTable[i] >= 0)
+	i = (i + 1) & (hashSize - 1);
+    if (hashTable[i] == HashEmpty)
+	hashUsed++;
+    hashTable[i] = offset;
+    hashCount++;
+}
+
+//----------------------------------------------------------------------
+// Directory::FindSlot
+// 	Look up file name in the hash table, and return the slot that
+//	points at its entry.  Return -1 if the name isn't in the directory.
+//
+//	"name" -- the file name to look up
+//----------------------------------------------------------------------
+
+int
+Directory::FindSlot(char *name)
+{
+    int len = strlen(name);
+    int i = HashName(name, len) & (hashSize - 1);
+    DirectoryEntry *e;
+
+    while (hashTable[i] != HashEmpty) {
+	if (hashTable[i] >= 0) {
+	    e = EntryAt(hashTable[i]);
+	    if (e->nameLen == len && !strncmp(e->name, name, len))
+		return i;
+	}
+	i = (i + 1) & (hashSize - 1);
+    }
+    return -1;		// name not in directory
 }
 
 //----------------------------------------------------------------------
 // Directory::FindIndex
-// 	Look up file name in directory, and return its location in the table of
-//	directory entries.  Return -1 if the name isn't in the directory.
+// 	Look up file name in directory, and return the offset of its
+//	entry in the directory blocks.  Return -1 if the name isn't in
+//	the directory.
 //
 //	"name" -- the file name to look up
 //----------------------------------------------------------------------
@@ -90,10 +256,11 @@ Directory::WriteBack(OpenFile *file)
 int
 Directory::FindIndex(char *name)
 {
-    for (int i = 0; i < tableSize; i++)
-        if (table[i].inUse && !strncmp(table[i].name, name, FileNameMaxLen))
-	    return i;
-    return -1;		// name not in directory
+    int slot = FindSlot(name);
+
+    if (slot == -1)
+	return -1;		// name not in directory
+    return hashTable[slot];
 }
 
 //----------------------------------------------------------------------
@@ -111,35 +278,91 @@ Directory::Find(char *name)
     int i = FindIndex(name);
 
     if (i != -1)
-	return table[i].sector;
+	return EntryAt(i)->sector;
     return -1;
 }
 
+//----------------------------------------------------------------------
+// Directory::IsDirectory
+// 	Return TRUE if "name" is in the directory, and is itself
+//	a directory.
+//
+//	"name" -- the file name to look up
+//----------------------------------------------------------------------
+
+bool
+Directory::IsDirectory(char *name)
+{
+    int i = FindIndex(name);
+
+    return (i != -1) && (EntryAt(i)->flags & DirEntryIsDir);
+}
+
 //----------------------------------------------------------------------
 // Directory::Add
 // 	Add a file into the directory.  Return TRUE if successful;
-//	return FALSE if the file name is already in the directory, or if
-//	the directory is completely full, and has no more space for
-//	additional file names.
+//	return FALSE if the file name is already in the directory, or
+//	if the name is empty or too long.
+//
+//	The new entry goes into the first gap big enough to hold it;
+//	if there is none, the directory grows by a block.
 //
 //	"name" -- the name of the file being added
 //	"newSector" -- the disk sector containing the added file's header
+//	"isDir" -- is the added file a directory?
 //----------------------------------------------------------------------
 
 bool
-Directory::Add(char *name, int newSector)
+Directory::Add(char *name, int newSector, bool isDir)
 { 
-    if (FindIndex(name) != -1)
+    int len = strlen(name);
+    int need = EntrySize(len);
+    int offset, used;
+    DirectoryEntry *e, *ne = NULL;
+
+    if (len == 0 || len > FileNameMaxLen || FindIndex(name) != -1)
 	return FALSE;
 
-    for (int i = 0; i < tableSize; i++)
-        if (!table[i].inUse) {
-            table[i].inUse = TRUE;
-            strncpy(table[i].name, name, FileNameMaxLen); 
-            table[i].sector = newSector;
-        return TRUE;
+    for (offset = 0; offset < Length(); offset += e->recLen) {
+	e = EntryAt(offset);
+	used = (e->flags & DirEntryInUse) ? EntrySize(e->nameLen) : 0;
+	if (e->recLen - used >= need) {		// split off the free space
+	    ne = EntryAt(offset + used);
+	    ne->recLen = e->recLen - used;
+	    if (used > 0)
+		e->recLen = used;
+	    offset += used;
+	    break;
 	}
-    return FALSE;	// no space.  Fix when we have extensible files.
+    }
+
+    if (ne == NULL) {				// no space; add a block
+	char *newBlocks = new char[(numBlocks + 1) * SectorSize];
+	bool *newDirty = new bool[numBlocks + 1];
+
+	bcopy(blocks, newBlocks, numBlocks * SectorSize);
+	bcopy((char *) dirty, (char *) newDirty, numBlocks * sizeof(bool));
+	delete [] blocks;
+	delete [] dirty;
+	blocks = newBlocks;
+	dirty = newDirty;
+	offset = numBlocks * SectorSize;
+	numBlocks++;
+	ne = EntryAt(offset);
+	ne->recLen = SectorSize;
+    }
+
+    ne->sector = newSector;
+    ne->nameLen = len;
+    ne->flags = DirEntryInUse | (isDir ? DirEntryIsDir : 0);
+    bcopy(name, ne->name, len);
+    MarkDirty(offset);
+
+    if (2 * (hashUsed + 1) > hashSize)
+	Rehash(MinHashSize);		// also indexes the new entry
+    else
+	HashInsert(offset);
+    return TRUE;	
 }
 
 //----------------------------------------------------------------------
@@ -147,51 +370,524 @@ Directory::Add(char *name, int newSector)
 // 	Remove a file name from the directory.  Return TRUE if successful;
 //	return FALSE if the file isn't in the directory. 
 //
+//	The entry's space is merged into the entry in front of it in
+//	the same block; the first entry of a block is simply marked
+//	unused.
+//
 //	"name" -- the file name to be removed
 //----------------------------------------------------------------------
 
 bool
 Directory::Remove(char *name)
 { 
-    int i = FindIndex(name);
+    int slot = FindSlot(name);
+    int offset, prev;
+    DirectoryEntry *e;
 
-    if (i == -1)
+    if (slot == -1)
 	return FALSE; 		// name not in directory
-    table[i].inUse = FALSE;
+    offset = hashTable[slot];
+    hashTable[slot] = HashDeleted;
+    hashCount--;
+
+    e = EntryAt(offset);
+    MarkDirty(offset);
+    prev = offset - (offset % SectorSize);	// start of the block
+    if (prev == offset) {
+	e->flags = 0;
+	return TRUE;
+    }
+    while (prev + EntryAt(prev)->recLen != offset)
+	prev += EntryAt(prev)->recLen;
+    EntryAt(prev)->recLen += e->recLen;
     return TRUE;	
 }
 
+//----------------------------------------------------------------------
+// Directory::IsEmpty
+// 	Return TRUE if there are no files in the directory.
+//----------------------------------------------------------------------
+
+bool
+Directory::IsEmpty()
+{
+    return hashCount == 0;
+}
+
 //----------------------------------------------------------------------
 // Directory::List
-// 	List all the file names in the directory. 
+// 	List all the file names in the directory, as full path names
+//	starting with "path".  Directories are listed with a trailing
+//	'/', followed by their contents.
+//
+//	"path" -- the path name of this directory ("" for the root)
 //----------------------------------------------------------------------
 
 void
-Directory::List()
+Directory::List(char *path)
 {
-   for (int i = 0; i < tableSize; i++)
-	if (table[i].inUse)
-	    printf("%s\n", table[i].name);
+    DirectoryEntry *e;
+    OpenFile *file;
+    Directory *sub;
+    char *subPath;
+
+    for (int offset = 0; offset < Length(); offset += e->recLen) {
+	e = EntryAt(offset);
+	if (!(e->flags & DirEntryInUse))
+	    continue;
+	if (!(e->flags & DirEntryIsDir)) {
+	    printf("%s/%.*s\n", path, e->nameLen, e->name);
+	    continue;
+	}
+	printf("%s/%.*s/\n", path, e->nameLen, e->name);
+	subPath = new char[strlen(path) + e->nameLen + 2];
+	sprintf(subPath, "%s/%.*s", path, e->nameLen, e->name);
+	file = new OpenFile(e->sector);
+	sub = new Directory;
+	sub->FetchFrom(file);
+	sub->List(subPath);
+	delete sub;
+	delete file;
+	delete [] subPath;
+    }
 }
 
 //----------------------------------------------------------------------
 // Directory::Print
 // 	List all the file names in the directory, their FileHeader locations,
-//	and the contents of each file.  For debugging.
+//	and the contents of each file.  Subdirectories are printed
+//	recursively.  For debugging.
 //----------------------------------------------------------------------
 
 void
 Directory::Print()
 { 
     FileHeader *hdr = new FileHeader;
+    DirectoryEntry *e;
+    OpenFile *file;
+    Directory *sub;
 
     printf("Directory contents:\n");
-    for (int i = 0; i < tableSize; i++)
-	if (table[i].inUse) {
-	    printf("Name: %s, Sector: %d\n", table[i].name, table[i].sector);
-	    hdr->FetchFrom(table[i].sector);
-	    hdr->Print();
+    for (int offset = 0; offset < Length(); offset += e->recLen) {
+	e = EntryAt(offset);
+	if (!(e->flags & DirEntryInUse))
+	    continue;
+	printf("Name: %.*s, Sector: %d%s\n", e->nameLen, e->name, e->sector,
+			(e->flags & DirEntryIsDir) ? ", Directory" : "");
+	hdr->FetchFrom(e->sector);
+	hdr->Print();
+	if (e->flags & DirEntryIsDir) {
+	    file = new OpenFile(e->sector);
+	    sub = new Directory;
+	    sub->FetchFrom(file);
+	    sub->Print();
+	    delete sub;
+	    delete file;
 	}
+    }
     printf("\n");
     delete hdr;
 }
+
+//----------------------------------------------------------------------
+// Directory::Check
+// 	Mark the header, data and indirect blocks of every file in the
+//	directory in "used", and recursively do the same for each
+//	subdirectory.  Print a message, and return FALSE, for any file
+//	that uses a sector some other file already does.
+//
+//	"used" -- bit map of sectors found in use so far
+//----------------------------------------------------------------------
+
+bool
+Directory::Check(BitMap *used)
+{
+    FileHeader *hdr = new FileHeader;
+    DirectoryEntry *e;
+    OpenFile *file;
+    Directory *sub;
+    bool ok = TRUE;
+
+    for (int offset = 0; offset < Length(); offset += e->recLen) {
+	e = EntryAt(offset);
+	if (!(e->flags & DirEntryInUse))
+	    continue;
+	if (e->sector < 0 || e->sector >= synchDisk->NumSectors()
+					|| used->Test(e->sector)) {
+	    printf("Check: %.*s: bad header sector %d\n", e->nameLen,
+		e->name, e->sector);
+	    ok = FALSE;
+	    continue;
+	}
+	used->Mark(e->sector);
+	hdr->FetchFrom(e->sector);
+	if (!hdr->MarkUsed(used)) {
+	    printf("Check: %.*s: uses a sector twice\n", e->nameLen, e->name);
+	    ok = FALSE;
+	}
+	if (e->flags & DirEntryIsDir) {
+	    file = new OpenFile(e->sector);
+	    sub = new Directory;
+	    sub->FetchFrom(file);
+	    if (!sub->Check(used))
+		ok = FALSE;
+	    delete sub;
+	    delete file;
+	}
+    }
+    delete hdr;
+    return ok;
+}
+
+//----------------------------------------------------------------------
+// PathEntry::PathEntry
+// 	Record a file found by Directory::Walk.  "name" is copied.
+//----------------------------------------------------------------------
+
+PathEntry::PathEntry(char *name, int hdrSector, bool dir)
+{
+    path = new char[strlen(name) + 1];
+    strcpy(path, name);
+    sector = hdrSector;
+    isDir = dir;
+}
+
+//----------------------------------------------------------------------
+// Directory::Walk
+// 	Append a PathEntry to "found" for each file in the directory,
+//	with full path names starting with "path"; each subdirectory is
+//	followed right away by the files under it.  The caller deletes
+//	the entries.
+//
+//	"path" -- the path name of this directory ("" for the root)
+//	"found" -- list of PathEntry to add to
+//----------------------------------------------------------------------
+
+void
+Directory::Walk(char *path, class List *found)
+{
+    DirectoryEntry *e;
+    OpenFile *file;
+    Directory *sub;
+    char *subPath;
+
+    for (int offset = 0; offset < Length(); offset += e->recLen) {
+	e = EntryAt(offset);
+	if (!(e->flags & DirEntryInUse))
+	    continue;
+	subPath = new char[strlen(path) + e->nameLen + 2];
+	sprintf(subPath, "%s/%.*s", path, e->nameLen, e->name);
+	found->Append(new PathEntry(subPath, e->sector,
+				(e->flags & DirEntryIsDir) != 0));
+	if (e->flags & DirEntryIsDir) {
+	    file = new OpenFile(e->sector);
+	    sub = new Directory;
+	    sub->FetchFrom(file);
+	    sub->Walk(subPath, found);
+	    delete sub;
+	    delete file;
+	}
+	delete [] subPath;
+    }
+}
+
+//----------------------------------------------------------------------
+// DirectoryTable::DirectoryTable
+// 	Initialize an empty table of in-core directories.
+//
+//	"size" -- number of directories to keep cached
+//----------------------------------------------------------------------
+
+DirectoryTable::DirectoryTable(int size)
+{
+    entries = NULL;
+    numEntries = 0;
+    maxEntries = size;
+    clock = 0;
+    mutex = new Semaphore("directory table", 1);
+}
+
+//----------------------------------------------------------------------
+// DirectoryTable::~DirectoryTable
+// 	De-allocate the table, along with every directory still in it.
+//----------------------------------------------------------------------
+
+DirectoryTable::~DirectoryTable()
+{
+    while (entries != NULL)
+	Drop(&entries);
+    delete mutex;
+}
+
+//----------------------------------------------------------------------
+// DirectoryTable::Drop
+// 	Throw away the entry "link" points at, and its directory.
+//----------------------------------------------------------------------
+
+void
+DirectoryTable::Drop(DirectoryTableEntry **link)
+{
+    DirectoryTableEntry *e = *link;
+
+    *link = e->next;
+    delete e->dir;
+    delete e;
+    numEntries--;
+}
+
+//----------------------------------------------------------------------
+// DirectoryTable::Acquire
+// 	Return the in-core copy of the directory whose header is stored
+//	at "sector", reading it from disk only if it is not already
+//	cached.  If the table is full, the least recently used directory
+//	no one is using makes room; if everyone is using one, the table
+//	grows.  The caller must hand it back with Release when done.
+//
+//	"sector" -- the location on disk of the directory's file header
+//----------------------------------------------------------------------
+
+Directory *
+DirectoryTable::Acquire(int sector)
+{
+    DirectoryTableEntry *e, **link, **victim = NULL;
+    OpenFile *file;
+
+    mutex->P();
+    clock++;
+    for (e = entries; e != NULL; e = e->next)
+	if (e->sector == sector) {
+	    e->refCount++;
+	    e->lastUse = clock;
+	    mutex->V();
+	    return e->dir;
+	}
+
+    if (numEntries >= maxEntries) {
+	for (link = &entries; *link != NULL; link = &(*link)->next)
+	    if ((*link)->refCount == 0 && (victim == NULL
+				|| (*link)->lastUse < (*victim)->lastUse))
+		victim = link;
+	if (victim != NULL) {
+	    DEBUG('f', "Evicting directory at sector %d\n", (*victim)->sector);
+	    Drop(victim);
+	}
+    }
+
+    e = new DirectoryTableEntry;
+    e->sector = sector;
+    e->dir = new Directory;
+    file = new OpenFile(sector);
+    e->dir->FetchFrom(file);
+    delete file;
+    e->refCount = 1;
+    e->lastUse = clock;
+    e->next = entries;
+    entries = e;
+    numEntries++;
+    mutex->V();
+    return e->dir;
+}
+
+//----------------------------------------------------------------------
+// DirectoryTable::Release
+// 	Give back a directory returned by Acquire.  It stays cached,
+//	unless it has since been removed.
+//
+//	"dir" -- the directory being released
+//----------------------------------------------------------------------
+
+void
+DirectoryTable::Release(Directory *dir)
+{
+    DirectoryTableEntry **link;
+
+    mutex->P();
+    for (link = &entries; *link != NULL; link = &(*link)->next)
+	if ((*link)->dir == dir) {
+	    ASSERT((*link)->refCount > 0);
+	    (*link)->refCount--;
+	    if ((*link)->refCount == 0 && (*link)->sector == -1)
+		Drop(link);			// directory was removed
+	    mutex->V();
+	    return;
+	}
+    ASSERT(FALSE);			// not one of ours
+}
+
+//----------------------------------------------------------------------
+// DirectoryTable::Invalidate
+// 	Forget the directory whose header was at "sector", since it has
+//	been removed and the sector may be reused.
+//
+//	"sector" -- the location on disk of the removed directory's header
+//----------------------------------------------------------------------
+
+void
+DirectoryTable::Invalidate(int sector)
+{
+    DirectoryTableEntry **link;
+
+    mutex->P();
+    for (link = &entries; *link != NULL; link = &(*link)->next)
+	if ((*link)->sector == sector) {
+	    (*link)->sector = -1;
+	    if ((*link)->refCount == 0)
+		Drop(link);
+	    break;
+	}
+    mutex->V();
+}
+
+//----------------------------------------------------------------------
+// DirectoryTable::Flush
+// 	Throw away every cached directory that is not in use, so that the
+//	next Acquire of each has to go to disk.  For measurements.
+//----------------------------------------------------------------------
+
+void
+DirectoryTable::Flush()
+{
+    DirectoryTableEntry **link;
+
+    mutex->P();
+    for (link = &entries; *link != NULL; )
+	if ((*link)->refCount == 0)
+	    Drop(link);
+	else
+	    link = &(*link)->next;
+    mutex->V();
+}
+
+//----------------------------------------------------------------------
+// DentryCache::DentryCache
+// 	Initialize an empty cache of path name lookups.
+//
+//	"size" -- most path names to remember
+//----------------------------------------------------------------------
+
+DentryCache::DentryCache(int size)
+{
+    maxEntries = size;
+    numEntries = 0;
+    numBuckets = size;
+    buckets = new DentryCacheEntry *[numBuckets];
+    for (int i = 0; i < numBuckets; i++)
+	buckets[i] = NULL;
+    clock = 0;
+    mutex = new Semaphore("name cache", 1);
+}
+
+//----------------------------------------------------------------------
+// DentryCache::~DentryCache
+// 	De-allocate the cache.
+//----------------------------------------------------------------------
+
+DentryCache::~DentryCache()
+{
+    DentryCacheEntry *e, *next;
+
+    for (int i = 0; i < numBuckets; i++)
+	for (e = buckets[i]; e != NULL; e = next) {
+	    next = e->next;
+	    delete [] e->path;
+	    delete e;
+	}
+    delete [] buckets;
+    delete mutex;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::FindEntry
+// 	Return the link in the hash chain that points at the entry for
+//	"path", or the NULL link at the end of the chain if there is none.
+//----------------------------------------------------------------------
+
+DentryCacheEntry **
+DentryCache::FindEntry(char *path)
+{
+    DentryCacheEntry **link;
+
+    link = &buckets[HashName(path, strlen(path)) % numBuckets];
+    while (*link != NULL && strcmp((*link)->path, path))
+	link = &(*link)->next;
+    return link;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Lookup
+// 	Look for "path" in the cache.  If it is there, return TRUE, and
+//	fill in the sector of its file header (-1 if we know there is no
+//	such file) and whether it is a directory.
+//----------------------------------------------------------------------
+
+bool
+DentryCache::Lookup(char *path, int *sector, bool *isDir)
+{
+    DentryCacheEntry *e;
+
+    mutex->P();
+    e = *FindEntry(path);
+    if (e != NULL) {
+	e->lastUse = ++clock;
+	*sector = e->sector;
+	*isDir = e->isDir;
+    }
+    mutex->V();
+    return e != NULL;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Insert
+// 	Remember that "path" has its header at "sector" (-1 if there
+//	is no such file), replacing anything we knew about it before.
+//----------------------------------------------------------------------
+
+void
+DentryCache::Insert(char *path, int sector, bool isDir)
+{
+    DentryCacheEntry **link, *e;
+
+    mutex->P();
+    link = FindEntry(path);
+    e = *link;
+    if (e == NULL) {
+	if (numEntries == maxEntries) {
+	    Evict();
+	    link = FindEntry(path);	// Evict may have changed the chain
+	}
+	e = new DentryCacheEntry;
+	e->path = new char[strlen(path) + 1];
+	strcpy(e->path, path);
+	e->next = NULL;
+	*link = e;
+	numEntries++;
+    }
+    e->sector = sector;
+    e->isDir = isDir;
+    e->lastUse = ++clock;
+    mutex->V();
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Evict
+// 	Drop the least recently used entry from the cache.
+//----------------------------------------------------------------------
+
+void
+DentryCache::Evict()
+{
+    DentryCacheEntry **link, **victim = NULL;
+
+    for (int i = 0; i < numBuckets; i++)
+	for (link = &buckets[i]; *link != NULL; link = &(*link)->next)
+	    if (victim == NULL || (*link)->lastUse < (*victim)->lastUse)
+		victim = link;
+    if (victim != NULL) {
+	DentryCacheEntry *e = *victim;
+
+	*victim = e->next;
+	delete [] e->path;
+	delete e;
+	numEntries--;
+    }
+}
@@ -4,9 +4,11 @@
 //      A directory is a table of pairs: <file name, sector #>,
 //	giving the name of each file in the directory, and 
 //	where to find its file header (the data structure describing
-//	where to find the file's data blocks) on disk.
+//	where to find the file's data blocks) on disk.  An entry can
+//	itself name a directory, giving a hierarchical name space.
 //
-//      We assume mutual exclusion is provided by the caller.
+//      Each in-core directory has a reader/writer lock; the caller
+//	takes it around lookups and changes.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -18,24 +20,58 @@
 #define DIRECTORY_H
 
 #include "openfile.h"
-
-#define FileNameMaxLen 		9	// for simplicity, we assume 
-					// file names are <= 9 characters long
+#include "synch.h"
+#include "list.h"
+
+// On disk, a directory is a sequence of SectorSize blocks, each packed
+// with variable length entries that never cross a block boundary.
+// Every entry is a DirEntryHeaderSize header followed by the name
+// (without a trailing '\0'), padded out to a multiple of 4 bytes.
+#define DirEntryHeaderSize	8
+#define FileNameMaxLen 		(SectorSize - DirEntryHeaderSize)
+					// longest name that fits in
+					// one directory block
+
+// bits in DirectoryEntry::flags
+#define DirEntryInUse		0x1	// entry names a file
+#define DirEntryIsDir		0x2	// ... and that file is a directory
 
 // The following class defines a "directory entry", representing a file
 // in the directory.  Each entry gives the name of the file, and where
 // the file's header is to be found on disk.
 //
+// "recLen" is the distance to the next entry in the same block; the
+// last entry in a block runs to the end of the block.  Any space in
+// an entry beyond what its own name needs is free, and removing an
+// entry just merges it into the entry in front of it (as in the
+// BSD fast file system).  Only the first "nameLen" bytes of "name"
+// are actually stored.
+//
 // Internal data structures kept public so that Directory operations can
 // access them directly.
 
 class DirectoryEntry {
   public:
-    bool inUse;				// Is this directory entry in use?
     int sector;				// Location on disk to find the 
 					//   FileHeader for this file 
-    char name[FileNameMaxLen + 1];	// Text name for file, with +1 for 
-					// the trailing '\0'
+    unsigned short recLen;		// Bytes from here to the next entry
+    unsigned char nameLen;		// Length of the name
+    unsigned char flags;		// DirEntryInUse, DirEntryIsDir
+    char name[FileNameMaxLen];		// Text name for file, not
+					// '\0'-terminated
+};
+
+// A file found by Directory::Walk: its full path name, and where its
+// header is.
+
+class PathEntry {
+  public:
+    PathEntry(char *name, int hdrSector, bool dir);
+    ~PathEntry() { delete [] path; }
+
+    char *path;				// Full path name, "/a/b/c"
+    int sector;				// Sector of its FileHeader
+    bool isDir;				// Is it a directory?
 };
 
 // The following class defines a UNIX-like "directory".  Each entry in
@@ -46,38 +82,164 @@ class DirectoryEntry {
 //
 // The constructor initializes a directory structure in memory; the
 // FetchFrom/WriteBack operations shuffle the directory information
-// from/to disk. 
+// from/to disk.  A directory grows a block at a time as entries are
+// added; the caller must make sure the directory file is at least
+// Length() bytes long before calling WriteBack.  Each block remembers
+// whether it has changed since it was last read or written, and
+// WriteBack only writes the blocks that have.
+//
+// While in memory, the directory also keeps an open-addressed hash
+// table from name to entry, so that lookups take constant time however
+// many files the directory holds.
 
 class Directory {
   public:
-    Directory(int size); 		// Initialize an empty directory
-					// with space for "size" files
+    Directory(); 			// Initialize an empty directory
     ~Directory();			// De-allocate the directory
 
     void FetchFrom(OpenFile *file);  	// Init directory contents from disk
     void WriteBack(OpenFile *file);	// Write modifications to 
 					// directory contents back to disk
+    RWLock *Lock() { return lock; }	// Shared to look up names,
+					//  exclusive to change them
+
+    int Length() { return numBlocks * SectorSize; }
+					// Size of the directory, in bytes
 
     int Find(char *name);		// Find the sector number of the 
 					// FileHeader for file: "name"
+    bool IsDirectory(char *name);	// Is "name" itself a directory?
 
-    bool Add(char *name, int newSector);  // Add a file name into the directory
+    bool Add(char *name, int newSector, bool isDir);
+					// Add a file name into the directory
 
     bool Remove(char *name);		// Remove a file from the directory
 
-    void List();			// Print the names of all the files
-					//  in the directory
+    bool IsEmpty();			// Does the directory hold no files?
+
+    void List(char *path);		// Print the names of all the files
+					//  in the directory, recursively
     void Print();			// Verbose print of the contents
 					//  of the directory -- all the file
 					//  names and their contents.
+    bool Check(BitMap *used);		// Mark the sectors used by every
+					//  file under the directory
+    void Walk(char *path, class List *found);
+					// Append a PathEntry to "found" for
+					//  every file under the directory,
+					//  recursively
+
+  private:
+    char *blocks;			// Directory contents, as on disk
+    int numBlocks;			// Number of SectorSize blocks
+    int *hashTable;			// Byte offsets of entries in
+					// "blocks", indexed by name hash
+    int hashSize;			// Number of slots in hashTable
+    int hashUsed;			// Slots holding entries or
+					// deleted markers
+    int hashCount;			// Entries in the directory
+    bool *dirty;			// Which blocks WriteBack must write
+    RWLock *lock;
+
+    DirectoryEntry *EntryAt(int offset)
+	{ return (DirectoryEntry *) &blocks[offset]; }
+
+    int FindIndex(char *name);		// Find the offset into "blocks"
+					//  of the entry for "name"
+    int FindSlot(char *name);		// Find the hash slot for "name"
+    void HashInsert(int offset);	// Index the entry at "offset"
+    void Rehash(int size);		// Rebuild the index with "size" slots
+    void MarkDirty(int offset)		// The block holding "offset" changed
+	{ dirty[offset / SectorSize] = TRUE; }
+};
+
+#define NumCachedDirectories	16	// directories to keep in core
+
+// The following class keeps directories in memory, so that operations
+// on names find them there, instead of reading the whole directory in
+// and writing it all back each time.  It works like the
+// FileHeaderTable: each directory is shared by every thread using it,
+// and those no one is using are kept until their room is needed.
+//
+// Whoever changes a directory writes the changed blocks back before
+// releasing it, so that the copy in memory never holds anything the
+// disk does not, and can simply be thrown away.
+
+class DirectoryTableEntry {
+  public:
+    int sector;				// Sector of the directory's header,
+					//  -1 once it has been removed
+    Directory *dir;			// The directory
+    int refCount;			// Number of users
+    int lastUse;			// Time of last Acquire, for LRU
+    DirectoryTableEntry *next;
+};
+
+class DirectoryTable {
+  public:
+    DirectoryTable(int size);		// Initialize an empty table
+    ~DirectoryTable();			// De-allocate it, and the directories
+
+    Directory *Acquire(int sector);	// Return the directory whose header
+					//  is at "sector", reading it in
+					//  if need be
+    void Release(Directory *dir);	// Done with a directory from Acquire
+    void Invalidate(int sector);	// The directory has been removed
+    void Flush();			// Forget every directory not in use
 
   private:
-    int tableSize;			// Number of directory entries
-    DirectoryEntry *table;		// Table of pairs: 
-					// <file name, file header location> 
+    DirectoryTableEntry *entries;	// All the cached directories
+    int numEntries;
+    int maxEntries;			// How many to keep when not in use
+    int clock;				// Counts calls to Acquire
+    Semaphore *mutex;			// One thread in the table at a time
+
+    void Drop(DirectoryTableEntry **link);
+					// Throw the entry away
+};
+
+// The following class caches the results of looking up path names,
+// so that opening a file we have looked up before does not mean
+// reading every directory along its path again.  Both hits and misses
+// are remembered; a miss is recorded with sector -1.
+//
+// Keys are full path names in the canonical form "/a/b/c".  Whoever
+// creates or removes a file must update the cache entry for its path.
+// When the cache is full, the least recently used entry is dropped.
+// Threads take turns using the cache.
+
+class DentryCacheEntry {
+  public:
+    char *path;				// Canonical path name
+    int sector;				// Sector of its FileHeader, or -1
+    bool isDir;				// Is it a directory?
+    int lastUse;			// Time of last lookup, for LRU
+    DentryCacheEntry *next;		// Next entry in the hash chain
+};
 
-    int FindIndex(char *name);		// Find the index into the directory 
-					//  table corresponding to "name"
+class DentryCache {
+  public:
+    DentryCache(int size);		// Initialize an empty cache
+    ~DentryCache();			// De-allocate the cache
+
+    bool Lookup(char *path, int *sector, bool *isDir);
+					// Return TRUE and fill in "sector"
+					//  and "isDir" if "path" is cached
+    void Insert(char *path, int sector, bool isDir);
+					// Remember the result of a lookup
+
+  private:
+    DentryCacheEntry **buckets;		// Hash chains
+    int numBuckets;
+    int numEntries;			// Entries in the cache
+    int maxEntries;			// Most entries we will keep
+    int clock;				// Counts lookups and inserts
+    Semaphore *mutex;			// One thread in the cache at a time
+
+    DentryCacheEntry **FindEntry(char *path);
+					// Find the link pointing at the
+					//  entry for "path"
+    void Evict();			// Drop the least recently used entry
 };
 
 #endif // DIRECTORY_H
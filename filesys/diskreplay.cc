@@ -0,0 +1,291 @@
+// diskreplay.cc
+//	A program to replay a trace of disk requests, recorded by
+//	"nachos -dtrace", against a new simulated disk, without running
+//	whatever made the requests in the first place.  Each request is
+//	made at the same time, relative to the start of the trace, as it
+//	was when the trace was recorded, whether or not the disk has
+//	caught up with the ones before it; so a disk that is faster or
+//	slower than the one traced shows up as requests that wait less or
+//	longer in the queue.  Only the timing is simulated: what is read
+//	and written is nothing in particular.
+//
+//	It is built from the same disk code as Nachos, so that the
+//	scheduling policies, drive models, geometries and arrays of disks
+//	it compares are the ones Nachos would use.
+//
+// Usage: diskreplay -d <debugflags> -disk <unix file>
+//		-geom <sectors per track> <tracks> -raid <level>
+//		-dcache <sectors> -dahead -dqueue <depth>
+//		-sched fcfs|sstf|look|clook <trace file>
+//
+//    -disk names the UNIX file to hold the disk (default REPLAY); it
+//	is made again, empty, for each replay, and removed afterwards;
+//	given more than once, with -raid, the disks form an array
+//    -geom gives the geometry of the disk (default 32 tracks of 32
+//	sectors); it should hold every sector in the trace
+//    -raid makes the disks into one: level 0 stripes the sectors
+//	across them, level 1 mirrors them
+//    -dcache, -dahead and -dqueue describe the disk drives, as for
+//	nachos
+//    -sched replays the trace with just that scheduling policy;
+//	otherwise it is replayed once with each of them
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#define MAIN
+#include "copyright.h"
+#undef MAIN
+
+#include "utility.h"
+#include "system.h"
+
+// A request from the trace, as it will be made again.
+
+class ReplayRequest {
+  public:
+    int number;				// Order it was made in
+    int tick;				// When it was made
+    bool writing;			// Write, rather than read?
+    int *sectors;			// The sectors, from the trace
+    int count;
+};
+
+static char *policyNames[] = { "FCFS", "SSTF", "LOOK", "C-LOOK" };
+static char *policyFlags[] = { "fcfs", "sstf", "look", "clook" };
+
+static Semaphore *replayTime;		// V'ed when it is time for the
+					//  next request
+
+//----------------------------------------------------------------------
+// ReplayWake
+// 	Interrupt handler: the next request of the trace is due.
+//----------------------------------------------------------------------
+
+static void
+ReplayWake(int dummy)
+{
+    replayTime->V();
+}
+
+//----------------------------------------------------------------------
+// WaitUntil
+// 	Wait until the simulated time is "when", if it isn't yet.
+//----------------------------------------------------------------------
+
+static void
+WaitUntil(int when)
+{
+    if (when > stats->totalTicks) {
+	interrupt->Schedule(ReplayWake, 0, when - stats->totalTicks,
+	    DiskInt);			// not TimerInt: Idle ignores those
+	replayTime->P();
+    }
+}
+
+//----------------------------------------------------------------------
+// LoadTrace
+// 	Read every record of the trace in the UNIX file "name" into
+//	"requests", in the order the requests were made (the trace has
+//	them in the order they finished).  Print a summary of the
+//	latencies that were recorded.  Return the number of requests,
+//	and the most sectors in any of them in "maxCount".
+//----------------------------------------------------------------------
+
+static int
+LoadTrace(char *name, ReplayRequest **requests, int *maxCount)
+{
+    DiskTrace *trace = new DiskTrace(name, TRUE);
+    DiskTrace *traced = new DiskTrace(NULL, FALSE);
+    DiskTraceRecord record;
+    ReplayRequest *r, key;
+    int *sectors, i, j, n = 0, size = 64;
+
+    r = new ReplayRequest[size];
+    *maxCount = 0;
+    while ((sectors = trace->Next(&record)) != NULL) {
+	if (n == size) {			// grow the array
+	    ReplayRequest *bigger = new ReplayRequest[size * 2];
+	    for (i = 0; i < n; i++)
+		bigger[i] = r[i];
+	    delete [] r;
+	    r = bigger;
+	    size *= 2;
+	}
+	r[n].number = record.number;
+	r[n].tick = record.tick;
+	r[n].writing = (record.op == TraceWrite);
+	r[n].sectors = sectors;
+	r[n++].count = record.count;
+	*maxCount = max(*maxCount, record.count);
+	traced->Record(record.number, record.tick, record.latency,
+	    (DiskTraceOp) record.op, sectors, record.count);
+    }
+    delete trace;
+
+    for (i = 1; i < n; i++) {		// sort by when they were made
+	key = r[i];
+	for (j = i - 1; j >= 0 && r[j].number > key.number; j--)
+	    r[j + 1] = r[j];
+	r[j + 1] = key;
+    }
+
+    printf("Replaying %s: %d requests over %d ticks\n", name, n,
+	(n == 0) ? 0 : r[n - 1].tick - r[0].tick);
+    traced->Print("traced");
+    delete traced;
+    *requests = r;
+    return n;
+}
+
+//----------------------------------------------------------------------
+// Replay
+// 	Make a new disk, and make each of the requests of the trace of
+//	it, at the time it was made in the trace.  Then wait for them
+//	all to finish, and print how long they took.
+//
+//	How long a request takes depends on where the disk has rotated
+//	to, so we start when the disk is where it was when the trace
+//	started; replayed with the same disk and policy, the requests
+//	then take as long as they did when they were traced, give or
+//	take a tick or two.
+//----------------------------------------------------------------------
+
+static void
+Replay(ReplayRequest *requests, int numRequests, int maxCount,
+	char **names, int numNames, RaidLevel level, int sectorsPerTrack,
+	int numTracks, DiskModel *model, DiskPolicy policy)
+{
+    DiskRequest **pending = new DiskRequest *[numRequests];
+    char **data = new char *[maxCount];
+    char *buffer = new char[SectorSize];
+    DiskTrace *summary = new DiskTrace(NULL, FALSE);
+    SynchDisk *disk;
+    int i, period, start, millis;
+
+    for (i = 0; i < numNames; i++)
+	Unlink(names[i]);
+    disk = new SynchDisk(names, numNames, level, DiskFile,
+	sectorsPerTrack, numTracks);
+    disk->SetPolicy(policy);
+    disk->SetModel(model);
+    disk->SetTrace(summary);
+    for (i = 0; i < maxCount; i++)
+	data[i] = buffer;			// the contents don't matter
+
+    period = disk->Device()->GetDisk(0)->SectorsPerTrack() * RotationTime;
+    start = stats->totalTicks;
+    if (numRequests > 0)
+	start += ((requests[0].tick - start) % period + period) % period;
+    millis = HostMilliseconds();
+    for (i = 0; i < numRequests; i++) {
+	WaitUntil(start + requests[i].tick - requests[0].tick);
+	pending[i] = disk->Submit(requests[i].sectors, data,
+	    requests[i].count, requests[i].writing);
+    }
+    for (i = 0; i < numRequests; i++)
+	disk->Wait(pending[i]);
+
+    summary->Print(policyNames[policy]);
+    printf("    done in %d ticks, %d ms\n", stats->totalTicks - start,
+	HostMilliseconds() - millis);
+
+    delete disk;
+    for (i = 0; i < numNames; i++)
+	Unlink(names[i]);
+    delete summary;
+    delete [] buffer;
+    delete [] data;
+    delete [] pending;
+}
+
+//----------------------------------------------------------------------
+// main
+// 	Start up just enough of Nachos to run the disk, read in the
+//	trace, and replay it with each policy asked for.
+//----------------------------------------------------------------------
+
+int
+main(int argc, char **argv)
+{
+    char *debugArgs = "";
+    char *names[MaxDisks];
+    char *traceName = NULL;
+    int numNames = 0, raidLevel = -1, policy = -1;
+    int sectorsPerTrack = DefaultSectorsPerTrack;
+    int numTracks = DefaultNumTracks;
+    int argCount, numRequests, maxCount, i;
+    DiskModel model;
+    ReplayRequest *requests;
+
+    for (argc--, argv++; argc > 0; argc -= argCount, argv += argCount) {
+	argCount = 1;
+	if (!strcmp(*argv, "-d")) {
+	    ASSERT(argc > 1);
+	    debugArgs = *(argv + 1);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-disk")) {
+	    ASSERT(argc > 1 && numNames < MaxDisks);
+	    names[numNames++] = *(argv + 1);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-geom")) {
+	    ASSERT(argc > 2);
+	    sectorsPerTrack = atoi(*(argv + 1));
+	    numTracks = atoi(*(argv + 2));
+	    argCount = 3;
+	} else if (!strcmp(*argv, "-raid")) {
+	    ASSERT(argc > 1);
+	    raidLevel = atoi(*(argv + 1));
+	    ASSERT(raidLevel == 0 || raidLevel == 1);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-dcache")) {
+	    ASSERT(argc > 1);
+	    model.cacheSectors = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-dqueue")) {
+	    ASSERT(argc > 1);
+	    model.queueDepth = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-dahead")) {
+	    model.readAhead = TRUE;
+	} else if (!strcmp(*argv, "-sched")) {
+	    ASSERT(argc > 1);
+	    for (i = DiskFCFS; i <= DiskCLOOK; i++)
+		if (!strcmp(*(argv + 1), policyFlags[i]))
+		    policy = i;
+	    ASSERT(policy != -1);		// no such policy
+	    argCount = 2;
+	} else
+	    traceName = *argv;
+    }
+    if (traceName == NULL) {
+	printf("Usage: diskreplay [flags] <trace file>\n");
+	Exit(1);
+    }
+    if (numNames == 0)
+	names[numNames++] = "REPLAY";
+    ASSERT(numNames == 1 || raidLevel != -1);	// disks, but no array
+
+    DebugInit(debugArgs);
+    stats = new Statistics();
+    interrupt = new Interrupt;
+    scheduler = new Scheduler();
+    currentThread = new Thread("main");
+    currentThread->setStatus(RUNNING);
+    interrupt->Enable();
+    replayTime = new Semaphore("replay", 0);
+
+    numRequests = LoadTrace(traceName, &requests, &maxCount);
+    for (i = DiskFCFS; i <= DiskCLOOK; i++)
+	if (policy == -1 || policy == i)
+	    Replay(requests, numRequests, maxCount, names, numNames,
+		(raidLevel == 1) ? Raid1 : Raid0, sectorsPerTrack,
+		numTracks, &model, (DiskPolicy) i);
+
+    for (i = 0; i < numRequests; i++)
+	delete [] requests[i].sectors;
+    delete [] requests;
+    Exit(0);
+    return 0;				// Not reached...
+}
@@ -0,0 +1,178 @@
+// disktrace.cc
+//	Routines to record the requests made of a disk in a UNIX file,
+//	and to read them back again.
+//
+//	Records are collected in a buffer, and written out a buffer at a
+//	time, so tracing costs next to nothing while Nachos runs.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "disktrace.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// DiskTrace::DiskTrace
+// 	Create a trace in the UNIX file "name", replacing whatever was
+//	there, or open an existing one to read it back.
+//
+//	"name" -- UNIX file to hold the trace; when recording, NULL means
+//	   keep the summary only
+//	"forReplay" -- TRUE to read an existing trace
+//----------------------------------------------------------------------
+
+DiskTrace::DiskTrace(char *name, bool forReplay)
+{
+    int magic = DiskTraceMagic;
+
+    replaying = forReplay;
+    buffer = NULL;
+    numBuffered = 0;
+    numRequests = numSectors = maxLatency = 0;
+    totalLatency = 0;
+    for (int i = 0; i < NumLatencyBuckets; i++)
+	latency[i] = 0;
+
+    if (name == NULL) {
+	ASSERT(!replaying);
+	file = -1;
+    } else if (replaying) {
+	file = OpenForReadWrite(name, TRUE);
+	if (ReadPartial(file, (char *) &magic, sizeof(int)) != sizeof(int)
+		|| magic != DiskTraceMagic) {
+	    printf("%s is not a disk trace\n", name);
+	    Exit(1);
+	}
+    } else {
+	file = OpenForWrite(name);
+	buffer = new char[DiskTraceBufferSize];
+	Append((char *) &magic, sizeof(int));
+    }
+}
+
+//----------------------------------------------------------------------
+// DiskTrace::~DiskTrace
+// 	Write out any records still in the buffer, and close the file.
+//----------------------------------------------------------------------
+
+DiskTrace::~DiskTrace()
+{
+    if (file == -1)
+	return;
+    if (!replaying) {
+	Flush();
+	delete [] buffer;
+    }
+    Close(file);
+}
+
+//----------------------------------------------------------------------
+// DiskTrace::Record
+// 	Append a record of a request that has just finished, and count
+//	it in the summary.
+//
+//	"number" -- how many requests were made before it
+//	"tick" -- when the request was made
+//	"elapsed" -- how long it took, from then until it was done
+//	"op" -- what kind of request it was
+//	"sectors", "count" -- the sectors it read or wrote, in order
+//----------------------------------------------------------------------
+
+void
+DiskTrace::Record(int number, int tick, int elapsed, DiskTraceOp op,
+		int *sectors, int count)
+{
+    DiskTraceRecord record;
+
+    ASSERT(!replaying);
+    numRequests++;
+    numSectors += count;
+    totalLatency += elapsed;
+    maxLatency = max(maxLatency, elapsed);
+    latency[stats->LatencyBucket(elapsed)]++;
+    if (file == -1)
+	return;
+
+    record.number = number;
+    record.tick = tick;
+    record.latency = elapsed;
+    record.count = count;
+    record.op = op;
+    Append((char *) &record, sizeof(record));
+    Append((char *) sectors, count * sizeof(int));
+}
+
+//----------------------------------------------------------------------
+// DiskTrace::Next
+// 	Read the next record of the trace into "record", and return its
+//	sectors, in an array the caller must de-allocate.  Return NULL
+//	once there are no more records.
+//----------------------------------------------------------------------
+
+int *
+DiskTrace::Next(DiskTraceRecord *record)
+{
+    int *sectors;
+
+    ASSERT(replaying);
+    if (ReadPartial(file, (char *) record, sizeof(DiskTraceRecord))
+		!= sizeof(DiskTraceRecord))
+	return NULL;
+    ASSERT(record->count > 0);
+    sectors = new int[record->count];
+    Read(file, (char *) sectors, record->count * sizeof(int));
+    return sectors;
+}
+
+//----------------------------------------------------------------------
+// DiskTrace::Print
+// 	Print how many requests were recorded, and how long they took.
+//----------------------------------------------------------------------
+
+void
+DiskTrace::Print(char *what)
+{
+    printf("%-7s: %d requests, %d sectors; latency mean %d, max %d\n",
+	what, numRequests, numSectors,
+	(numRequests == 0) ? 0 : (int) (totalLatency / numRequests),
+	maxLatency);
+    if (numRequests > 0) {
+	printf("    ");
+	stats->PrintLatency("request", latency);
+    }
+}
+
+//----------------------------------------------------------------------
+// DiskTrace::Append
+// 	Add "size" bytes to the records waiting to be written, writing
+//	out the buffer first if they don't fit.  Anything bigger than
+//	the whole buffer is written out directly.
+//----------------------------------------------------------------------
+
+void
+DiskTrace::Append(char *data, int size)
+{
+    if (numBuffered + size > DiskTraceBufferSize)
+	Flush();
+    if (size > DiskTraceBufferSize)
+	WriteFile(file, data, size);
+    else {
+	bcopy(data, &buffer[numBuffered], size);
+	numBuffered += size;
+    }
+}
+
+//----------------------------------------------------------------------
+// DiskTrace::Flush
+// 	Write the buffered records out to the trace file.
+//----------------------------------------------------------------------
+
+void
+DiskTrace::Flush()
+{
+    if (numBuffered > 0)
+	WriteFile(file, buffer, numBuffered);
+    numBuffered = 0;
+}
@@ -0,0 +1,78 @@
+// disktrace.h
+//	Data structures for recording the requests made of a disk, and
+//	reading them back, so that the same stream of requests can be
+//	replayed against other disks, drives and scheduling policies
+//	(see diskreplay.cc).
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef DISKTRACE_H
+#define DISKTRACE_H
+
+#include "utility.h"
+#include "stats.h"
+
+// A trace file starts with DiskTraceMagic, followed by one record per
+// request, in the order the requests finished: a DiskTraceRecord,
+// then its "count" sector numbers.  Everything is in host byte order.
+#define DiskTraceMagic		0x4e445452	// "NDTR"
+#define DiskTraceBufferSize	4096		// bytes written at a time
+
+// What kind of request a record is.
+enum DiskTraceOp { TraceRead, TraceWrite, TracePrefetch };
+
+class DiskTraceRecord {
+  public:
+    int number;				// Which request: they are numbered
+					//  from 0, in the order they were made
+    int tick;				// When the request was made
+    int latency;			// Ticks until it was done, counting
+					//  the time it waited in the queue
+    int count;				// Number of sectors
+    int op;				// A DiskTraceOp
+};
+
+// The following class defines a disk trace.  Made for recording, it
+// appends a record for each request it is told about, to the UNIX
+// file "name" (or nowhere, if "name" is NULL), and keeps a summary of
+// how long the requests took.  Made for replaying, it reads back the
+// records of an existing trace, one at a time.
+
+class DiskTrace {
+  public:
+    DiskTrace(char *name, bool forReplay);
+					// Create the trace file, or open
+					// an existing one to replay
+    ~DiskTrace();			// Write out the rest, and close it
+
+    void Record(int number, int tick, int elapsed, DiskTraceOp op,
+		int *sectors, int count);
+					// Append a record for one request
+    int *Next(DiskTraceRecord *record);
+					// Read the next record, and return
+					// its sectors, newly allocated; NULL
+					// at the end of the trace
+
+    void Print(char *what);		// Print the summary
+
+  private:
+    int file;				// UNIX file, or -1 if none
+    bool replaying;			// Reading, rather than writing?
+    char *buffer;			// Records not yet written out
+    int numBuffered;			// ... bytes of them
+
+    int numRequests;			// Summary of the requests
+    int numSectors;			//  recorded: how many, and how
+    double totalLatency;		//  long they took
+    int maxLatency;
+    int latency[NumLatencyBuckets];	// Histogram, as in Statistics
+
+    void Append(char *data, int size);	// Add to the buffer
+    void Flush();			// Write the buffer out
+};
+
+#endif // DISKTRACE_H
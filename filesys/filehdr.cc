@@ -3,12 +3,15 @@
 //	would be called the i-node).
 //
 //	The file header is used to locate where on disk the 
-//	file's data is stored.  We implement this as a fixed size
-//	table of pointers -- each entry in the table points to the 
-//	disk sector containing that portion of the file data
-//	(in other words, there are no indirect or doubly indirect 
-//	blocks). The table size is chosen so that the file header
-//	will be just big enough to fit in one disk sector, 
+//	file's data is stored.  We implement this as a table of
+//	pointers -- each entry in the table points to the disk sector
+//	containing that portion of the file data.  The header sector
+//	holds NumDirect of these pointers directly, followed by a
+//	singly indirect and a doubly indirect pointer, so that a file
+//	can grow to cover the whole disk.  Indirect blocks are only
+//	allocated once the file is big enough to need them.  A file
+//	small enough keeps its data in the header sector instead, and
+//	so has no data blocks at all.
 //
 //      Unlike in a real system, we do not keep track of file permissions, 
 //	ownership, last modification date, etc., in the file header. 
@@ -27,6 +30,76 @@
 #include "system.h"
 #include "filehdr.h"
 
+//----------------------------------------------------------------------
+// IndexSectors
+// 	Return how many indirect blocks a file of "n" data sectors needs:
+//	none if it fits in the direct pointers, one for the singly
+//	indirect block, and for anything bigger, the doubly indirect
+//	block plus one second-level block per NumIndirect data sectors.
+//----------------------------------------------------------------------
+
+static int
+IndexSectors(int n)
+{
+    if (n <= NumDirect)
+	return 0;
+    n -= NumDirect;
+    if (n <= NumIndirect)
+	return 1;
+    n -= NumIndirect;
+    return 2 + divRoundUp(n, NumIndirect);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::FileHeader
+// 	Initialize an empty, zero-length file header.  The header is
+//	filled in either by Allocate (for a new file) or by FetchFrom.
+//----------------------------------------------------------------------
+
+FileHeader::FileHeader()
+{
+    numBytes = numSectors = 0;
+    indirectSector = doubleIndirectSector = -1;
+    table = NULL;
+    tableSize = 0;
+    level2Sectors = NULL;
+    lock = new RWLock("file header");
+}
+
+//----------------------------------------------------------------------
+// FileHeader::~FileHeader
+// 	De-allocate the in-memory copies of the block tables.
+//----------------------------------------------------------------------
+
+FileHeader::~FileHeader()
+{
+    delete [] table;
+    delete [] level2Sectors;
+    delete lock;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::ResizeTable
+// 	Make sure the in-memory table of data sectors has room for
+//	"n" entries, preserving the ones already there.
+//----------------------------------------------------------------------
+
+void
+FileHeader::ResizeTable(int n)
+{
+    int *newTable;
+
+    if (n <= tableSize)
+	return;
+    n = max(n, max(2 * tableSize, NumDirect));
+    newTable = new int[n];
+    for (int i = 0; i < tableSize; i++)
+	newTable[i] = table[i];
+    delete [] table;
+    table = newTable;
+    tableSize = n;
+}
+
 //----------------------------------------------------------------------
 // FileHeader::Allocate
 // 	Initialize a fresh file header for a newly created file.
@@ -41,19 +114,79 @@
 bool
 FileHeader::Allocate(BitMap *freeMap, int fileSize)
 { 
-    numBytes = fileSize;
-    numSectors  = divRoundUp(fileSize, SectorSize);
-    if (freeMap->NumClear() < numSectors)
+    numBytes = numSectors = 0;
+    bzero(InlineData(), MaxInlineSize);
+    return Extend(freeMap, fileSize);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Extend
+// 	Grow the file to "newSize" bytes, allocating data blocks (and
+//	any indirect blocks the new size needs) out of the map of free
+//	disk blocks.  Return FALSE, leaving the header unchanged, if
+//	there is not enough free space or the file would be too big.
+//
+//	An inline file that still fits in the header just gets longer.
+//	One that no longer fits gets its data moved out to its first
+//	data sector; that sector is logged along with the header, so
+//	a crash can't leave the header pointing at a sector that does
+//	not hold the data yet.  Otherwise the new sectors are not
+//	written to disk; the caller must WriteBack the header afterwards.
+//
+//	"freeMap" is the bit map of free disk sectors
+//	"newSize" is the new length of the file, in bytes
+//----------------------------------------------------------------------
+
+bool
+FileHeader::Extend(BitMap *freeMap, int newSize)
+{
+    int newSectors = divRoundUp(newSize, SectorSize);
+    int first2 = NumDirect + NumIndirect;	// first doubly indirect block
+    char data[SectorSize];
+    bool moveOut = FALSE;
+
+    if (newSize < numBytes || newSectors > MaxFileSectors)
+	return FALSE;
+    if (IsInline() && newSize <= MaxInlineSize) {
+	bzero(&InlineData()[numBytes], newSize - numBytes);
+	numBytes = newSize;
+	return TRUE;
+    }
+    if (freeMap->NumClear() < (newSectors - numSectors) 
+		+ IndexSectors(newSectors) - IndexSectors(numSectors))
 	return FALSE;		// not enough space
 
-    for (int i = 0; i < numSectors; i++)
-	dataSectors[i] = freeMap->Find();
+    if (IsInline()) {		// no pointers yet; the data is there
+	bzero(data, SectorSize);
+	bcopy(InlineData(), data, numBytes);
+	moveOut = (numBytes > 0);
+	indirectSector = doubleIndirectSector = -1;
+    }
+    ResizeTable(newSectors);
+    for (int i = numSectors; i < newSectors; i++) {
+	if (i == NumDirect)
+	    indirectSector = freeMap->Find();
+	if (i == first2) {
+	    doubleIndirectSector = freeMap->Find();
+	    level2Sectors = new int[NumIndirect];
+	    for (int j = 0; j < NumIndirect; j++)
+		level2Sectors[j] = -1;		// all of it goes to disk
+	}
+	if (i >= first2 && ((i - first2) % NumIndirect) == 0)
+	    level2Sectors[(i - first2) / NumIndirect] = freeMap->Find();
+	table[i] = freeMap->Find();
+    }
+    numSectors = newSectors;
+    numBytes = newSize;
+    if (moveOut)
+	journal->WriteSector(table[0], data);
     return TRUE;
 }
 
 //----------------------------------------------------------------------
 // FileHeader::Deallocate
-// 	De-allocate all the space allocated for data blocks for this file.
+// 	De-allocate all the space allocated for data blocks for this file,
+//	along with its indirect blocks.
 //
 //	"freeMap" is the bit map of free disk sectors
 //----------------------------------------------------------------------
@@ -61,15 +194,67 @@ FileHeader::Allocate(BitMap *freeMap, int fileSize)
 void 
 FileHeader::Deallocate(BitMap *freeMap)
 {
-    for (int i = 0; i < numSectors; i++) {
-	ASSERT(freeMap->Test((int) dataSectors[i]));  // ought to be marked!
-	freeMap->Clear((int) dataSectors[i]);
+    int i;
+
+    if (IsInline())
+	return;			// nothing but the header
+    for (i = 0; i < numSectors; i++) {
+	ASSERT(freeMap->Test((int) table[i]));  // ought to be marked!
+	freeMap->Clear((int) table[i]);
+    }
+    if (indirectSector != -1)
+	freeMap->Clear(indirectSector);
+    if (doubleIndirectSector != -1) {
+	for (i = 0; i < IndexSectors(numSectors) - 2; i++)
+	    freeMap->Clear(level2Sectors[i]);
+	freeMap->Clear(doubleIndirectSector);
     }
 }
 
+//----------------------------------------------------------------------
+// FileHeader::MarkUsed
+// 	Mark every data and indirect block of this file in "used", for
+//	checking the file system.  Return FALSE if any of them is not a
+//	valid sector number, or was already marked by some other file.
+//
+//	"used" is the bit map of sectors found in use so far
+//----------------------------------------------------------------------
+
+static bool
+MarkSector(BitMap *used, int sector)
+{
+    if (sector < 0 || sector >= synchDisk->NumSectors()
+						|| used->Test(sector))
+	return FALSE;
+    used->Mark(sector);
+    return TRUE;
+}
+
+bool
+FileHeader::MarkUsed(BitMap *used)
+{
+    bool ok = TRUE;
+    int i;
+
+    if (IsInline())
+	return TRUE;
+    for (i = 0; i < numSectors; i++)
+	ok = MarkSector(used, table[i]) && ok;
+    if (indirectSector != -1)
+	ok = MarkSector(used, indirectSector) && ok;
+    if (doubleIndirectSector != -1) {
+	for (i = 0; i < IndexSectors(numSectors) - 2; i++)
+	    ok = MarkSector(used, level2Sectors[i]) && ok;
+	ok = MarkSector(used, doubleIndirectSector) && ok;
+    }
+    return ok;
+}
+
 //----------------------------------------------------------------------
 // FileHeader::FetchFrom
-// 	Fetch contents of file header from disk. 
+// 	Fetch contents of file header from disk, followed by any
+//	indirect blocks, so that the whole table of data sectors is
+//	in memory.
 //
 //	"sector" is the disk sector containing the file header
 //----------------------------------------------------------------------
@@ -77,12 +262,38 @@ FileHeader::Deallocate(BitMap *freeMap)
 void
 FileHeader::FetchFrom(int sector)
 {
-    synchDisk->ReadSector(sector, (char *)this);
+    int first2 = NumDirect + NumIndirect;
+    int i, j, n;
+    int *buf;
+
+    journal->ReadSector(sector, (char *)this);
+    ResizeTable(numSectors);
+    for (i = 0; i < min(numSectors, NumDirect); i++)
+	table[i] = dataSectors[i];
+    if (numSectors <= NumDirect)
+	return;
+
+    buf = new int[NumIndirect];
+    journal->ReadSector(indirectSector, (char *)buf);
+    for (i = NumDirect; i < min(numSectors, first2); i++)
+	table[i] = buf[i - NumDirect];
+    if (numSectors > first2) {
+	if (level2Sectors == NULL)
+	    level2Sectors = new int[NumIndirect];
+	journal->ReadSector(doubleIndirectSector, (char *)level2Sectors);
+	for (j = 0, i = first2; i < numSectors; j++) {
+	    journal->ReadSector(level2Sectors[j], (char *)buf);
+	    for (n = 0; n < NumIndirect && i < numSectors; n++, i++)
+		table[i] = buf[n];
+	}
+    }
+    delete [] buf;
 }
 
 //----------------------------------------------------------------------
 // FileHeader::WriteBack
-// 	Write the modified contents of the file header back to disk. 
+// 	Write the modified contents of the file header back to disk,
+//	along with any indirect blocks.
 //
 //	"sector" is the disk sector to contain the file header
 //----------------------------------------------------------------------
@@ -90,7 +301,30 @@ FileHeader::FetchFrom(int sector)
 void
 FileHeader::WriteBack(int sector)
 {
-    synchDisk->WriteSector(sector, (char *)this); 
+    int first2 = NumDirect + NumIndirect;
+    int i, j, n;
+    int *buf;
+
+    if (!IsInline())		// else the data is in place of these
+	for (i = 0; i < NumDirect; i++)
+	    dataSectors[i] = (i < numSectors) ? table[i] : -1;
+    journal->WriteSector(sector, (char *)this);
+    if (numSectors <= NumDirect)
+	return;
+
+    buf = new int[NumIndirect];
+    for (n = 0, i = NumDirect; n < NumIndirect; n++, i++)
+	buf[n] = (i < numSectors) ? table[i] : -1;
+    journal->WriteSector(indirectSector, (char *)buf);
+    if (numSectors > first2) {
+	for (j = 0, i = first2; i < numSectors; j++) {
+	    for (n = 0; n < NumIndirect; n++, i++)
+		buf[n] = (i < numSectors) ? table[i] : -1;
+	    journal->WriteSector(level2Sectors[j], (char *)buf);
+	}
+	journal->WriteSector(doubleIndirectSector, (char *)level2Sectors);
+    }
+    delete [] buf;
 }
 
 //----------------------------------------------------------------------
@@ -106,7 +340,7 @@ FileHeader::WriteBack(int sector)
 int
 FileHeader::ByteToSector(int offset)
 {
-    return(dataSectors[offset / SectorSize]);
+    return(table[offset / SectorSize]);
 }
 
 //----------------------------------------------------------------------
@@ -120,6 +354,23 @@ FileHeader::FileLength()
     return numBytes;
 }
 
+//----------------------------------------------------------------------
+// PrintBytes
+// 	Print "count" bytes of file data, escaping the unprintable ones.
+//----------------------------------------------------------------------
+
+static void
+PrintBytes(char *data, int count)
+{
+    for (int j = 0; j < count; j++) {
+	if ('\040' <= data[j] && data[j] <= '\176')   // isprint(data[j])
+	    printf("%c", data[j]);
+	else
+	    printf("\\%x", (unsigned char)data[j]);
+    }
+    printf("\n");
+}
+
 //----------------------------------------------------------------------
 // FileHeader::Print
 // 	Print the contents of the file header, and the contents of all
@@ -129,22 +380,352 @@ FileHeader::FileLength()
 void
 FileHeader::Print()
 {
-    int i, j, k;
-    char *data = new char[SectorSize];
+    int i;
+    char *data;
 
+    if (IsInline()) {
+	printf("FileHeader contents.  File size: %d.  Data is inline.\n",
+	    numBytes);
+	printf("File contents:\n");
+	PrintBytes(InlineData(), numBytes);
+	return;
+    }
     printf("FileHeader contents.  File size: %d.  File blocks:\n", numBytes);
     for (i = 0; i < numSectors; i++)
-	printf("%d ", dataSectors[i]);
+	printf("%d ", table[i]);
+    if (indirectSector != -1)
+	printf("\nIndirect blocks: %d", indirectSector);
+    if (doubleIndirectSector != -1) {
+	printf(" %d", doubleIndirectSector);
+	for (i = 0; i < IndexSectors(numSectors) - 2; i++)
+	    printf(" %d", level2Sectors[i]);
+    }
     printf("\nFile contents:\n");
-    for (i = k = 0; i < numSectors; i++) {
-	synchDisk->ReadSector(dataSectors[i], data);
-        for (j = 0; (j < SectorSize) && (k < numBytes); j++, k++) {
-	    if ('\040' <= data[j] && data[j] <= '\176')   // isprint(data[j])
-		printf("%c", data[j]);
-            else
-		printf("\\%x", (unsigned char)data[j]);
-	}
-        printf("\n"); 
+    data = new char[SectorSize];
+    for (i = 0; i < numSectors; i++) {
+	synchDisk->ReadSector(table[i], data);
+	PrintBytes(data, min(SectorSize, numBytes - i * SectorSize));
     }
     delete [] data;
 }
+
+//----------------------------------------------------------------------
+// FileHeader::NumRuns
+// 	Return how many runs of consecutive sectors the file's data is
+//	in: 1 if it is contiguous, 0 if it has none (it is inline).
+//----------------------------------------------------------------------
+
+int
+FileHeader::NumRuns()
+{
+    int runs = 0;
+
+    for (int i = 0; i < numSectors; i++)
+	if (i == 0 || table[i] != table[i - 1] + 1)
+	    runs++;
+    return runs;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::NumTrackSwitches
+// 	Return how many times reading the file from start to end moves
+//	the disk head to a different track.
+//----------------------------------------------------------------------
+
+int
+FileHeader::NumTrackSwitches()
+{
+    int perTrack = synchDisk->SectorsPerTrack();
+    int switches = 0;
+
+    for (int i = 1; i < numSectors; i++)
+	if (table[i] / perTrack != table[i - 1] / perTrack)
+	    switches++;
+    return switches;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::ReadTime
+// 	Return how long the disk would take to read the whole file in a
+//	single request, starting with the head over its first sector.
+//	If "contiguous", return how long it would take if instead the
+//	data were in consecutive sectors, starting at the same place
+//	(or as close to it as the end of the disk allows).
+//----------------------------------------------------------------------
+
+int
+FileHeader::ReadTime(bool contiguous)
+{
+    int *sectors = table;
+    int first, ticks;
+
+    if (numSectors == 0)
+	return 0;
+    if (contiguous) {
+	sectors = new int[numSectors];
+	first = min(table[0], synchDisk->NumSectors() - numSectors);
+	for (int i = 0; i < numSectors; i++)
+	    sectors[i] = first + i;
+    }
+    ticks = synchDisk->EstimateTime(sectors, numSectors);
+    if (contiguous)
+	delete [] sectors;
+    return ticks;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Relocate
+// 	Move the file's data into the first run of free sectors long
+//	enough to hold all of it, TransferChunk sectors at a time, and
+//	free the sectors it was in.  The indirect blocks stay where they
+//	are.
+//
+//	Return FALSE, changing nothing, if the data is already in one
+//	run, or there is no free run long enough.  Otherwise the caller
+//	must write back both the header and "freeMap".  The caller must
+//	also keep anyone else from using the header meanwhile.
+//
+//	The data is written straight to disk, and so is safely in its new
+//	place before the new header is logged.
+//
+//	"freeMap" is the bit map of free disk sectors
+//----------------------------------------------------------------------
+
+bool
+FileHeader::Relocate(BitMap *freeMap)
+{
+    int from[TransferChunk], to[TransferChunk];
+    char *bufs[TransferChunk];
+    char *buf;
+    int first, i, n, count;
+
+    if (NumRuns() <= 1)
+	return FALSE;
+    first = freeMap->FindRun(numSectors);
+    if (first == -1)
+	return FALSE;
+
+    buf = new char[TransferChunk * SectorSize];
+    for (n = 0; n < TransferChunk; n++)
+	bufs[n] = &buf[n * SectorSize];
+    for (i = 0; i < numSectors; i += count) {
+	count = min(TransferChunk, numSectors - i);
+	for (n = 0; n < count; n++) {
+	    from[n] = table[i + n];
+	    to[n] = first + i + n;
+	}
+	journal->ReadSectors(from, bufs, count);
+	journal->WriteSectors(to, bufs, count, FALSE);
+    }
+    delete [] buf;
+
+    for (i = 0; i < numSectors; i++) {
+	freeMap->Clear(table[i]);
+	table[i] = first + i;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeaderTable::FileHeaderTable
+// 	Initialize an empty table of in-core file headers.
+//
+//	"size" -- number of headers to keep cached
+//----------------------------------------------------------------------
+
+FileHeaderTable::FileHeaderTable(int size)
+{
+    numEntries = size;
+    sectors = new int[size];
+    headers = new FileHeader *[size];
+    refCounts = new int[size];
+    lastUse = new int[size];
+    for (int i = 0; i < size; i++) {
+	sectors[i] = -1;
+	headers[i] = NULL;
+	refCounts[i] = lastUse[i] = 0;
+    }
+    clock = 0;
+    mutex = new Semaphore("file header table", 1);
+}
+
+//----------------------------------------------------------------------
+// FileHeaderTable::~FileHeaderTable
+// 	De-allocate the table, along with every header still in it.
+//----------------------------------------------------------------------
+
+FileHeaderTable::~FileHeaderTable()
+{
+    for (int i = 0; i < numEntries; i++)
+	delete headers[i];
+    delete [] sectors;
+    delete [] headers;
+    delete [] refCounts;
+    delete [] lastUse;
+    delete mutex;
+}
+
+//----------------------------------------------------------------------
+// FileHeaderTable::FindFree
+// 	Return the index of an entry that can hold a new header: an
+//	empty one if there is one, otherwise the least recently used
+//	entry no one is using.  If every entry is in use, double the
+//	size of the table.
+//----------------------------------------------------------------------
+
+int
+FileHeaderTable::FindFree()
+{
+    int i, victim = -1;
+
+    for (i = 0; i < numEntries; i++) {
+	if (headers[i] == NULL)
+	    return i;
+	if (refCounts[i] == 0 && (victim == -1 || lastUse[i] < lastUse[victim]))
+	    victim = i;
+    }
+    if (victim != -1) {
+	DEBUG('f', "Evicting header for sector %d\n", sectors[victim]);
+	delete headers[victim];
+	headers[victim] = NULL;
+	return victim;
+    }
+
+    int *newSectors = new int[2 * numEntries];
+    FileHeader **newHeaders = new FileHeader *[2 * numEntries];
+    int *newRefCounts = new int[2 * numEntries];
+    int *newLastUse = new int[2 * numEntries];
+
+    for (i = 0; i < 2 * numEntries; i++) {
+	if (i < numEntries) {
+	    newSectors[i] = sectors[i];
+	    newHeaders[i] = headers[i];
+	    newRefCounts[i] = refCounts[i];
+	    newLastUse[i] = lastUse[i];
+	} else {
+	    newSectors[i] = -1;
+	    newHeaders[i] = NULL;
+	    newRefCounts[i] = newLastUse[i] = 0;
+	}
+    }
+    delete [] sectors;
+    delete [] headers;
+    delete [] refCounts;
+    delete [] lastUse;
+    sectors = newSectors;
+    headers = newHeaders;
+    refCounts = newRefCounts;
+    lastUse = newLastUse;
+    victim = numEntries;
+    numEntries *= 2;
+    return victim;
+}
+
+//----------------------------------------------------------------------
+// FileHeaderTable::Acquire
+// 	Return the in-core header for the file whose header is stored at
+//	"sector", reading it from disk only if it is not already cached.
+//	The caller must hand it back with Release when done.
+//
+//	We keep other threads out of the table while reading the header,
+//	so that two of them can't both read it into separate entries.
+//
+//	"sector" -- the location on disk of the file header
+//----------------------------------------------------------------------
+
+FileHeader *
+FileHeaderTable::Acquire(int sector)
+{
+    FileHeader *hdr;
+    int i;
+
+    mutex->P();
+    clock++;
+    for (i = 0; i < numEntries; i++)
+	if (headers[i] != NULL && sectors[i] == sector) {
+	    refCounts[i]++;
+	    lastUse[i] = clock;
+	    hdr = headers[i];
+	    mutex->V();
+	    return hdr;
+	}
+
+    i = FindFree();
+    headers[i] = new FileHeader;
+    headers[i]->FetchFrom(sector);
+    sectors[i] = sector;
+    refCounts[i] = 1;
+    lastUse[i] = clock;
+    hdr = headers[i];
+    mutex->V();
+    return hdr;
+}
+
+//----------------------------------------------------------------------
+// FileHeaderTable::Release
+// 	Give back a header returned by Acquire.  The header stays cached,
+//	unless its file has since been removed.
+//
+//	"hdr" -- the header being released
+//----------------------------------------------------------------------
+
+void
+FileHeaderTable::Release(FileHeader *hdr)
+{
+    mutex->P();
+    for (int i = 0; i < numEntries; i++)
+	if (headers[i] == hdr) {
+	    ASSERT(refCounts[i] > 0);
+	    refCounts[i]--;
+	    if (refCounts[i] == 0 && sectors[i] == -1) {
+		delete headers[i];		// file was removed
+		headers[i] = NULL;
+	    }
+	    mutex->V();
+	    return;
+	}
+    ASSERT(FALSE);			// not one of ours
+}
+
+//----------------------------------------------------------------------
+// FileHeaderTable::Invalidate
+// 	Forget the cached header for the file at "sector", since the file
+//	has been removed and the sector may be reused.  If the file is
+//	still open, the header lives on until the last Release.
+//
+//	"sector" -- the location on disk of the removed file's header
+//----------------------------------------------------------------------
+
+void
+FileHeaderTable::Invalidate(int sector)
+{
+    mutex->P();
+    for (int i = 0; i < numEntries; i++)
+	if (headers[i] != NULL && sectors[i] == sector) {
+	    sectors[i] = -1;
+	    if (refCounts[i] == 0) {
+		delete headers[i];
+		headers[i] = NULL;
+	    }
+	    break;
+	}
+    mutex->V();
+}
+
+//----------------------------------------------------------------------
+// FileHeaderTable::Flush
+// 	Throw away every cached header that is not in use, so that the
+//	next Acquire of each has to go to disk.  For measurements.
+//----------------------------------------------------------------------
+
+void
+FileHeaderTable::Flush()
+{
+    mutex->P();
+    for (int i = 0; i < numEntries; i++)
+	if (headers[i] != NULL && refCounts[i] == 0) {
+	    delete headers[i];
+	    headers[i] = NULL;
+	}
+    mutex->V();
+}
@@ -16,32 +16,60 @@
 
 #include "disk.h"
 #include "bitmap.h"
+#include "synch.h"
 
-#define NumDirect 	((SectorSize - 2 * sizeof(int)) / sizeof(int))
-#define MaxFileSize 	(NumDirect * SectorSize)
+// The header sector holds the file length, the number of data sectors,
+// NumDirect direct pointers, one singly indirect pointer and one doubly
+// indirect pointer.  An indirect sector is just an array of NumIndirect
+// sector numbers.
+#define NumHeaderSlots	((int) ((SectorSize - 2 * sizeof(int)) / sizeof(int)))
+#define NumDirect 	(NumHeaderSlots - 2)
+#define NumIndirect	((int) (SectorSize / sizeof(int)))
+#define MaxFileSectors	(NumDirect + NumIndirect + NumIndirect * NumIndirect)
+#define MaxFileSize 	(MaxFileSectors * SectorSize)
+
+// A file of at most MaxInlineSize bytes has no data sectors at all:
+// its data is kept in the header sector, where the sector pointers
+// would otherwise be, so reading the header reads the data too.
+#define MaxInlineSize	(NumHeaderSlots * (int) sizeof(int))
 
 // The following class defines the Nachos "file header" (in UNIX terms,  
 // the "i-node"), describing where on disk to find all of the data in the file.
-// The file header is organized as a simple table of pointers to
-// data blocks. 
+// The file header is organized as a table of pointers to data blocks:
+// the first NumDirect blocks are named directly in the header, the
+// next NumIndirect through a singly indirect block, and the rest
+// through a doubly indirect block.
 //
 // The file header data structure can be stored in memory or on disk.
-// When it is on disk, it is stored in a single sector -- this means
-// that we assume the size of this data structure to be the same
-// as one disk sector.  Without indirect addressing, this
-// limits the maximum file length to just under 4K bytes.
+// When it is on disk, it is stored in a single sector -- the first
+// SectorSize bytes of the object are exactly that sector.  While the
+// header is in memory we also keep a flattened copy of every data
+// sector number, so that ByteToSector never has to go to disk.
+//
+// The file header is initialized by allocating blocks for the file (if
+// it is a new file), or by reading it from disk.  Extend grows an
+// existing file, allocating any indirect blocks it needs on the way.
+// A file stays inline (see MaxInlineSize) until it grows too big, and
+// then Extend moves its data out to a data sector.
 //
-// There is no constructor; rather the file header can be initialized
-// by allocating blocks for the file (if it is a new file), or by
-// reading it from disk.
+// An in-core header may be shared by threads with the file open, so
+// it has a reader/writer lock: held shared to look up sectors or the
+// length, exclusive to change them.  The caller does the locking.
 
 class FileHeader {
   public:
+    FileHeader();			// Initialize an empty header
+    ~FileHeader();			// De-allocate the in-memory tables
+
     bool Allocate(BitMap *bitMap, int fileSize);// Initialize a file header, 
 						//  including allocating space 
 						//  on disk for the file data
+    bool Extend(BitMap *bitMap, int newSize);	// Grow the file to "newSize"
+						//  bytes
     void Deallocate(BitMap *bitMap);  		// De-allocate this file's 
-						//  data blocks
+						//  data and indirect blocks
+    bool MarkUsed(BitMap *used);		// Mark them all in "used";
+						//  FALSE if any already was
 
     void FetchFrom(int sectorNumber); 	// Initialize file header from disk
     void WriteBack(int sectorNumber); 	// Write modifications to file header
@@ -56,11 +84,81 @@ class FileHeader {
 
     void Print();			// Print the contents of the file.
 
+    bool IsInline() { return numSectors == 0; }
+					// Is the data in the header?
+    char *InlineData() { return (char *) dataSectors; }
+					// ... then here it is
+
+    int NumRuns();			// Runs of consecutive data sectors
+    int NumTrackSwitches();		// Times a sequential read moves
+					//  to another track
+    int ReadTime(bool contiguous);	// Ticks to read the file in one
+					//  request, as it is laid out, or
+					//  if it were contiguous
+    bool Relocate(BitMap *freeMap);	// Move the data into one run of
+					//  free sectors
+
+    RWLock *Lock() { return lock; }	// Guards the header in memory
+
   private:
+    // on-disk image -- these fields must add up to exactly SectorSize
     int numBytes;			// Number of bytes in the file
-    int numSectors;			// Number of data sectors in the file
-    int dataSectors[NumDirect];		// Disk sector numbers for each data 
-					// block in the file
+    int numSectors;			// Number of data sectors in the file,
+					// 0 if the data is inline
+    int dataSectors[NumDirect];		// Disk sector numbers for the first
+					// NumDirect data blocks in the file
+    int indirectSector;			// Singly indirect block, or -1
+    int doubleIndirectSector;		// Doubly indirect block, or -1
+					// (the data of an inline file
+					// takes the place of these three)
+
+    // in-memory only
+    int *table;				// Sector numbers of all numSectors
+					// data blocks, in file order
+    int tableSize;			// Allocated length of "table"
+    int *level2Sectors;			// Contents of the doubly indirect
+					// block, NULL if there is none
+    RWLock *lock;			// Shared to read the header,
+					// exclusive to change it
+
+    void ResizeTable(int n);		// Make room for "n" entries in table
+};
+
+#define NumCachedHeaders	32	// initial size of the FileHeaderTable
+
+// The following class keeps the in-core copies of file headers, so that
+// every OpenFile on the same file shares one FileHeader (and sees the
+// file grow when any of them extends it), and so that opening a file
+// whose header is already in memory costs no disk I/O.
+//
+// Each entry counts the OpenFiles using it.  Entries no one is using
+// stay cached until their slot is needed for another header; then the
+// least recently used one is thrown away.  The table only grows when
+// every entry is in use.  Threads take turns using the table itself.
+
+class FileHeaderTable {
+  public:
+    FileHeaderTable(int size);		// Initialize an empty table
+    ~FileHeaderTable();			// De-allocate the table and headers
+
+    FileHeader *Acquire(int sector);	// Return the header stored at
+					//  "sector", fetching it if needed
+    void Release(FileHeader *hdr);	// Done with a header from Acquire
+    void Invalidate(int sector);	// The file at "sector" is gone;
+					//  forget its header
+    void Flush();			// Forget every header not in use
+
+  private:
+    int *sectors;			// Header sector of each entry,
+					//  -1 if the entry is stale
+    FileHeader **headers;		// In-core header, NULL if unused
+    int *refCounts;			// Number of users of each entry
+    int *lastUse;			// Time of last Acquire, for LRU
+    int numEntries;			// Size of the arrays above
+    int clock;				// Counts calls to Acquire
+    Semaphore *mutex;			// One thread in the table at a time
+
+    int FindFree();			// Find or make an unused entry
 };
 
 #endif // FILEHDR_H
@@ -11,33 +11,50 @@
 //
 // 	The file system consists of several data structures:
 //	   A bitmap of free disk sectors (cf. bitmap.h)
-//	   A directory of file names and file headers
+//	   A root directory of file names and file headers; an entry
+//	     in a directory may itself name a directory
 //
-//      Both the bitmap and the directory are represented as normal
-//	files.  Their file headers are located in specific sectors
-//	(sector 0 and sector 1), so that the file system can find them 
-//	on bootup.
+//      Both the bitmap and the directories are represented as normal
+//	files.  The file headers of the bitmap and the root directory are
+//	located in specific sectors (sector 0 and sector 1), so that the
+//	file system can find them on bootup.
+//
+//	File names are UNIX-style paths, such as "/usr/bin/ls", always
+//	taken relative to the root directory; the leading '/' is optional.
 //
 //	The file system assumes that the bitmap and directory files are
-//	kept "open" continuously while Nachos is running.
+//	kept "open" continuously while Nachos is running.  The bitmap
+//	itself is kept in memory too, as are the directories most
+//	recently used.
 //
 //	For those operations (such as Create, Remove) that modify the
 //	directory and/or bitmap, if the operation succeeds, the changes
-//	are written immediately back to disk (the two files are kept
-//	open during all this time).  If the operation fails, and we have
-//	modified part of the directory and/or bitmap, we simply discard
-//	the changed version, without writing it back to disk.
+//	are written back through the journal (cf. journal.h), which
+//	logs them before they go to their home on disk, so that a crash
+//	leaves either all of an operation on disk or none of it.  The
+//	journal lives in a third file, whose header is in sector 2.
+//	If the operation fails, and we have modified part of the directory
+//	and/or bitmap, we simply discard the changed version, without
+//	writing it back.
+//
+//	Operations on names (Create, Mkdir, Remove, Open) from different
+//	threads can run at once.  Each directory has a reader/writer
+//	lock: lookups hold it shared, so any number of them can proceed
+//	together, while adding or removing a name holds it exclusive.
+//	The bitmap has a lock of its own, held only while allocating or
+//	freeing sectors.  Removing a directory locks out every other
+//	operation on names, so that no directory disappears while some
+//	thread is on its way through it.  Locks are always taken in the
+//	order: directories, parent before child; the bitmap; file headers.
 //
 // 	Our implementation at this point has the following restrictions:
 //
-//	   there is no synchronization for concurrent accesses
+//	   the changes to names from all threads are committed to the
+//	     journal together
 //	   files have a fixed size, set when the file is created
-//	   files cannot be bigger than about 3KB in size
-//	   there is no hierarchical directory structure, and only a limited
-//	     number of files can be added to the system
-//	   there is no attempt to make the system robust to failures
-//	    (if Nachos exits in the middle of an operation that modifies
-//	    the file system, it may corrupt the disk)
+//	     (only directories grow, as names are added to them)
+//	   only metadata is journaled; a crash can lose file data
+//	     written shortly before it
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -50,19 +67,21 @@
 #include "directory.h"
 #include "filehdr.h"
 #include "filesys.h"
+#include "system.h"
 
 // Sectors containing the file headers for the bitmap of free sectors,
 // and the directory of files.  These file headers are placed in well-known 
 // sectors, so that they can be located on boot-up.
 #define FreeMapSector 		0
 #define DirectorySector 	1
+#define JournalSector		2
+
+// Initial file size for the bitmap, which has a bit for each sector on
+// the disk.  Directories start out one sector long, and grow as needed.
+#define FreeMapFileSize 	divRoundUp(synchDisk->NumSectors(), BitsInByte)
 
-// Initial file sizes for the bitmap and directory; until the file system
-// supports extensible files, the directory size sets the maximum number 
-// of files that can be loaded onto the disk.
-#define FreeMapFileSize 	(NumSectors / BitsInByte)
-#define NumDirEntries 		10
-#define DirectoryFileSize 	(sizeof(DirectoryEntry) * NumDirEntries)
+// Number of path names to remember in the name cache.
+#define DentryCacheSize 	64
 
 //----------------------------------------------------------------------
 // FileSystem::FileSystem
@@ -72,7 +91,8 @@
 //	not all of the sectors marked as free).  
 //
 //	If format = FALSE, we just have to open the files
-//	representing the bitmap and the directory.
+//	representing the bitmap and the directory -- after the journal
+//	has redone any changes a crash kept from reaching their homes.
 //
 //	"format" -- should we initialize the disk?
 //----------------------------------------------------------------------
@@ -80,24 +100,32 @@
 FileSystem::FileSystem(bool format)
 { 
     DEBUG('f', "Initializing the file system.\n");
+    dentryCache = new DentryCache(DentryCacheSize);
+    dirTable = new DirectoryTable(NumCachedDirectories);
+    freeMapLock = new Semaphore("free map", 1);
+    treeLock = new RWLock("directory tree");
+    freeMap = new BitMap(synchDisk->NumSectors());
     if (format) {
-        BitMap *freeMap = new BitMap(NumSectors);
-        Directory *directory = new Directory(NumDirEntries);
+        Directory *directory = new Directory;
 	FileHeader *mapHdr = new FileHeader;
 	FileHeader *dirHdr = new FileHeader;
+	FileHeader *journalHdr = new FileHeader;
 
         DEBUG('f', "Formatting the file system.\n");
 
-    // First, allocate space for FileHeaders for the directory and bitmap
-    // (make sure no one else grabs these!)
+    // First, allocate space for FileHeaders for the directory, bitmap
+    // and journal (make sure no one else grabs these!)
 	freeMap->Mark(FreeMapSector);	    
 	freeMap->Mark(DirectorySector);
+	freeMap->Mark(JournalSector);
 
     // Second, allocate space for the data blocks containing the contents
     // of the directory and bitmap files.  There better be enough space!
 
 	ASSERT(mapHdr->Allocate(freeMap, FreeMapFileSize));
-	ASSERT(dirHdr->Allocate(freeMap, DirectoryFileSize));
+	ASSERT(dirHdr->Allocate(freeMap, directory->Length()));
+	ASSERT(journalHdr->Allocate(freeMap,
+		JournalSectorsFor(synchDisk->NumSectors()) * SectorSize));
 
     // Flush the bitmap and directory FileHeaders back to disk
     // We need to do this before we can "Open" the file, since open
@@ -107,6 +135,7 @@ FileSystem::FileSystem(bool format)
         DEBUG('f', "Writing headers back to disk.\n");
 	mapHdr->WriteBack(FreeMapSector);    
 	dirHdr->WriteBack(DirectorySector);
+	journalHdr->WriteBack(JournalSector);
 
     // OK to open the bitmap and directory files now
     // The file system operations assume these two files are left open
@@ -114,6 +143,8 @@ FileSystem::FileSystem(bool format)
 
         freeMapFile = new OpenFile(FreeMapSector);
         directoryFile = new OpenFile(DirectorySector);
+	freeMapFile->SetMetadata();
+	directoryFile->SetMetadata();
      
     // Once we have the files "open", we can write the initial version
     // of each file back to disk.  The directory at this point is completely
@@ -125,11 +156,14 @@ FileSystem::FileSystem(bool format)
 	freeMap->WriteBack(freeMapFile);	 // flush changes to disk
 	directory->WriteBack(directoryFile);
 
+    // Everything from here on is logged.
+	journal->Open(JournalSector, TRUE);
+	delete journalHdr;
+
 	if (DebugIsEnabled('f')) {
 	    freeMap->Print();
 	    directory->Print();
 
-        delete freeMap; 
 	delete directory; 
 	delete mapHdr; 
 	delete dirHdr;
@@ -137,9 +171,189 @@ FileSystem::FileSystem(bool format)
     } else {
     // if we are not formatting the disk, just open the files representing
     // the bitmap and directory; these are left open while Nachos is running
+	journal->Open(JournalSector, FALSE);
         freeMapFile = new OpenFile(FreeMapSector);
         directoryFile = new OpenFile(DirectorySector);
+	freeMapFile->SetMetadata();
+	directoryFile->SetMetadata();
+	freeMap->FetchFrom(freeMapFile);
+    }
+}
+
+//----------------------------------------------------------------------
+// FileSystem::~FileSystem
+// 	Get everything in the journal onto the disk, close the bitmap
+//	and root directory, and throw away the in-core directories and
+//	the name cache.
+//----------------------------------------------------------------------
+
+FileSystem::~FileSystem()
+{
+    journal->Close();
+    delete freeMapFile;
+    delete directoryFile;
+    delete freeMap;
+    delete freeMapLock;
+    delete dirTable;
+    delete dentryCache;
+    delete treeLock;
+}
+
+//----------------------------------------------------------------------
+// CanonicalPath
+// 	Return a newly allocated copy of "path" in the form the name
+//	cache uses: every component preceded by exactly one '/', with
+//	no trailing '/'.  "usr//bin/" becomes "/usr/bin".
+//----------------------------------------------------------------------
+
+static char *
+CanonicalPath(char *path)
+{
+    char *canon = new char[strlen(path) + 2];
+    char *p = canon;
+
+    while (*path != '\0') {
+	if (*path == '/') {
+	    path++;
+	    continue;
+	}
+	*p++ = '/';
+	while (*path != '\0' && *path != '/')
+	    *p++ = *path++;
+    }
+    *p = '\0';
+    return canon;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::FindParent
+// 	Walk a path name down from the root directory, and return the
+//	directory that should contain the last component of the path,
+//	locked shared, or exclusive if "exclusive".  The sector holding
+//	its file header is returned in "dirSector".  The last component
+//	itself is copied into "name", which must have room for
+//	FileNameMaxLen+1 characters.
+//
+//	Each directory along the way is looked up in the name cache
+//	first; only on a miss do we look in the directory itself, under
+//	a shared lock, and remember what we found while still holding it.
+//
+//	Return NULL if some directory along the way does not exist, or
+//	if the last component is empty or too long.  Otherwise the caller
+//	must hand the directory back with ReleaseDirectory.
+//
+//	The caller holds treeLock, so none of the directories can be
+//	removed while we look through them.
+//
+//	"path" -- the path name, components separated by '/'
+//	"name" -- buffer to hold the last component
+//	"exclusive" -- lock the directory to change it?
+//	"dirSector" -- set to the location of the directory's header
+//----------------------------------------------------------------------
+
+Directory *
+FileSystem::FindParent(char *path, char *name, bool exclusive,
+			int *dirSector)
+{
+    int sector = DirectorySector;
+    char *prefix = new char[strlen(path) + 2];	// canonical path so far
+    int prefixLen = 0;
+    char *end;
+    int len, next;
+    bool isDir;
+    Directory *directory;
+
+    for (;;) {
+	while (*path == '/')			// skip empty components
+	    path++;
+	for (end = path; *end != '\0' && *end != '/'; end++)
+	    ;
+	len = end - path;
+	if (len > FileNameMaxLen) {
+	    sector = -1;
+	    break;
+	}
+	strncpy(name, path, len);
+	name[len] = '\0';
+	while (*end == '/')
+	    end++;
+	if (*end == '\0') {			// "name" is the last component
+	    if (len == 0)
+		sector = -1;
+	    break;
+	}
+
+	sprintf(prefix + prefixLen, "/%s", name);	// step into "name"
+	prefixLen += len + 1;
+	if (!dentryCache->Lookup(prefix, &next, &isDir)) {
+	    directory = dirTable->Acquire(sector);
+	    directory->Lock()->AcquireShared();
+	    next = directory->Find(name);
+	    isDir = directory->IsDirectory(name);
+	    dentryCache->Insert(prefix, next, isDir);
+	    ReleaseDirectory(directory, FALSE);
+	}
+	sector = isDir ? next : -1;
+	if (sector == -1)
+	    break;
+	path = end;
     }
+    delete [] prefix;
+    *dirSector = sector;
+    if (sector == -1)
+	return NULL;
+
+    directory = dirTable->Acquire(sector);
+    if (exclusive)
+	directory->Lock()->AcquireExclusive();
+    else
+	directory->Lock()->AcquireShared();
+    return directory;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::ReleaseDirectory
+// 	Unlock a directory returned by FindParent (or locked after
+//	DirectoryTable::Acquire), and hand it back to the table.
+//
+//	"dir" -- the directory
+//	"exclusive" -- was it locked exclusive?
+//----------------------------------------------------------------------
+
+void
+FileSystem::ReleaseDirectory(Directory *dir, bool exclusive)
+{
+    if (exclusive)
+	dir->Lock()->ReleaseExclusive();
+    else
+	dir->Lock()->ReleaseShared();
+    dirTable->Release(dir);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::OpenDirectory
+// 	Return an OpenFile for the directory whose header is at "sector".
+//	The root directory is always open, so we hand back directoryFile
+//	for it; call CloseDirectory when done.
+//----------------------------------------------------------------------
+
+OpenFile *
+FileSystem::OpenDirectory(int sector)
+{
+    OpenFile *dirFile;
+
+    if (sector == DirectorySector)
+	return directoryFile;
+    dirFile = new OpenFile(sector);
+    dirFile->SetMetadata();
+    return dirFile;
+}
+
+void
+FileSystem::CloseDirectory(OpenFile *dirFile)
+{
+    if (dirFile != directoryFile)
+	delete dirFile;
 }
 
 //----------------------------------------------------------------------
@@ -149,68 +363,135 @@ FileSystem::FileSystem(bool format)
 //	to give Create the initial size of the file.
 //
 //	The steps to create a file are:
+//	  Find the directory the file goes in
 //	  Make sure the file doesn't already exist
 //        Allocate a sector for the file header
 // 	  Allocate space on disk for the data blocks for the file
-//	  Add the name to the directory
+//	  Add the name to the directory, growing it if need be
 //	  Store the new file header on disk 
 //	  Flush the changes to the bitmap and the directory back to disk
 //
+//	All of this is one operation for the journal.
+//
 //	Return TRUE if everything goes ok, otherwise, return FALSE.
 //
 // 	Create fails if:
+//		some directory in the path does not exist
 //   		file is already in directory
 //	 	no free space for file header
-//	 	no free entry for file in directory
 //	 	no free space for data blocks for the file 
+//		no free space to grow the directory
 //
-// 	Note that this implementation assumes there is no concurrent access
-//	to the file system!
+// 	Only one thread at a time creates, removes or opens a file; see
+//	CreateEntry.
 //
-//	"name" -- name of file to be created
+//	"name" -- path name of file to be created
 //	"initialSize" -- size of file to be created
 //----------------------------------------------------------------------
 
 bool
 FileSystem::Create(char *name, int initialSize)
 {
+    DEBUG('f', "Creating file %s, size %d\n", name, initialSize);
+    return CreateEntry(name, initialSize, FALSE);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Mkdir
+// 	Create a new, empty directory (similar to UNIX mkdir).
+//	Return TRUE if successful; fails for the same reasons as Create.
+//
+//	"name" -- path name of directory to be created
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Mkdir(char *name)
+{
+    DEBUG('f', "Creating directory %s\n", name);
+    return CreateEntry(name, SectorSize, TRUE);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::CreateEntry
+// 	Do the work for Create and Mkdir: add "path" to its parent
+//	directory, as a file of "initialSize" bytes.  If "isDir", the
+//	new file is initialized to hold an empty directory.
+//
+//	The parent directory is locked exclusive while we change it, and
+//	the bitmap while we allocate space.  If anything goes wrong, we
+//	read both back in from disk, to throw away what we changed.
+//	The locks are released before the operation ends, since ending
+//	it may mean waiting for the journal to commit, and other threads
+//	can carry on into the next transaction meanwhile.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::CreateEntry(char *path, int initialSize, bool isDir)
+{
+    char name[FileNameMaxLen + 1];
+    char *canon;
+    OpenFile *dirFile;
     Directory *directory;
-    BitMap *freeMap;
     FileHeader *hdr;
-    int sector;
+    int dirSector, sector;
     bool success;
 
-    DEBUG('f', "Creating file %s, size %d\n", name, initialSize);
-
-    directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
+    journal->Begin();
+    treeLock->AcquireShared();
+    directory = FindParent(path, name, TRUE, &dirSector);
+    if (directory == NULL) {
+	treeLock->ReleaseShared();
+	journal->End();
+	return FALSE;				// no such directory
+    }
 
     if (directory->Find(name) != -1)
       success = FALSE;			// file is already in directory
     else {	
-        freeMap = new BitMap(NumSectors);
-        freeMap->FetchFrom(freeMapFile);
+	dirFile = OpenDirectory(dirSector);
+	freeMapLock->P();
         sector = freeMap->Find();	// find a sector to hold the file header
     	if (sector == -1) 		
             success = FALSE;		// no free block for file header 
-        else if (!directory->Add(name, sector))
-            success = FALSE;	// no space in directory
+        else if (!directory->Add(name, sector, isDir))
+            success = FALSE;	// bad name
 	else {
     	    hdr = new FileHeader;
 	    if (!hdr->Allocate(freeMap, initialSize))
             	success = FALSE;	// no space on disk for data
+	    else if (!dirFile->Extend(freeMap, directory->Length()))
+		success = FALSE;	// no space to grow the directory
 	    else {	
 	    	success = TRUE;
 		// everthing worked, flush all changes back to disk
     	    	hdr->WriteBack(sector); 		
-    	    	directory->WriteBack(directoryFile);
+		canon = CanonicalPath(path);
+		dentryCache->Insert(canon, sector, isDir);
+		delete [] canon;
+		if (isDir) {
+		    OpenFile *newFile = new OpenFile(sector);
+		    Directory *newDir = new Directory;
+
+		    newFile->SetMetadata();
+		    newDir->WriteBack(newFile);
+		    delete newDir;
+		    delete newFile;
+		}
+    	    	directory->WriteBack(dirFile);
     	    	freeMap->WriteBack(freeMapFile);
 	    }
             delete hdr;
 	}
-        delete freeMap;
+	if (!success) {			// throw away our changes
+	    freeMap->FetchFrom(freeMapFile);
+	    directory->FetchFrom(dirFile);
+	}
+	freeMapLock->V();
+	CloseDirectory(dirFile);
     }
-    delete directory;
+    ReleaseDirectory(directory, TRUE);
+    treeLock->ReleaseShared();
+    journal->End();			// may commit; don't hold any locks
     return success;
 }
 
@@ -218,87 +499,254 @@ FileSystem::Create(char *name, int initialSize)
 // FileSystem::Open
 // 	Open a file for reading and writing.  
 //	To open a file:
-//	  Find the location of the file's header, using the directory 
-//	  Bring the header into memory
+//	  Find the directory holding the file, using the name cache
+//	    for the directories along the way if we have looked them up
+//	    before
+//	  Look the file up in that directory, which is kept in memory
+//	  Bring the header into memory, if it isn't there already
+//
+//	The directory is only locked shared, so that threads can open
+//	files in it at the same time.  It stays locked until we have the
+//	header, so the file can't be removed in between.
 //
-//	"name" -- the text name of the file to be opened
+//	Directories cannot be opened this way.
+//
+//	"name" -- the path name of the file to be opened
 //----------------------------------------------------------------------
 
 OpenFile *
 FileSystem::Open(char *name)
 { 
-    Directory *directory = new Directory(NumDirEntries);
+    char leaf[FileNameMaxLen + 1];
     OpenFile *openFile = NULL;
-    int sector;
+    Directory *directory;
+    int dirSector, sector;
 
     DEBUG('f', "Opening file %s\n", name);
-    directory->FetchFrom(directoryFile);
-    sector = directory->Find(name); 
-    if (sector >= 0) 		
-	openFile = new OpenFile(sector);	// name was found in directory 
-    delete directory;
+    treeLock->AcquireShared();
+    directory = FindParent(name, leaf, FALSE, &dirSector);
+    if (directory != NULL) {
+	sector = directory->Find(leaf);
+	if (sector >= 0 && !directory->IsDirectory(leaf))
+	    openFile = new OpenFile(sector);	// name was found in directory
+	ReleaseDirectory(directory, FALSE);
+    }
+    treeLock->ReleaseShared();
     return openFile;				// return NULL if not found
 }
 
+//----------------------------------------------------------------------
+// FileSystem::Extend
+// 	Grow "file" to "newLength" bytes, as one operation for the
+//	journal.  Files do not grow by themselves when they are written
+//	past the end, so a caller that wants to append must call this
+//	first.
+//
+//	Return FALSE, leaving the file as it was, if there is not enough
+//	free space on disk.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Extend(OpenFile *file, int newLength)
+{
+    bool success;
+
+    journal->Begin();
+    freeMapLock->P();
+    success = file->Extend(freeMap, newLength);
+    if (success)
+	freeMap->WriteBack(freeMapFile);
+    else
+	freeMap->FetchFrom(freeMapFile);	// throw away what we changed
+    freeMapLock->V();
+    journal->End();
+    return success;
+}
+
 //----------------------------------------------------------------------
 // FileSystem::Remove
 // 	Delete a file from the file system.  This requires:
-//	    Remove it from the directory
+//	    Remove it from its directory
 //	    Delete the space for its header
 //	    Delete the space for its data blocks
 //	    Write changes to directory, bitmap back to disk
+//	as one operation for the journal.
+//
+//	The parent directory is locked exclusive.  If the file turns out
+//	to be a directory, we start over with treeLock exclusive, so that
+//	no other thread is looking through it when it goes away.
 //
 //	Return TRUE if the file was deleted, FALSE if the file wasn't
-//	in the file system.
+//	in the file system, or is a directory that is not empty.
 //
-//	"name" -- the text name of the file to be removed
+//	"name" -- the path name of the file to be removed
 //----------------------------------------------------------------------
 
 bool
 FileSystem::Remove(char *name)
 { 
+    char leaf[FileNameMaxLen + 1];
+    char *canon;
+    OpenFile *dirFile;
     Directory *directory;
-    BitMap *freeMap;
     FileHeader *fileHdr;
-    int sector;
+    int dirSector, sector;
+    bool isDir, wholeTree = FALSE;
     
-    directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
-    sector = directory->Find(name);
-    if (sector == -1) {
-       delete directory;
-       return FALSE;			 // file not found 
+    journal->Begin();
+    for (;;) {
+	if (wholeTree)
+	    treeLock->AcquireExclusive();
+	else
+	    treeLock->AcquireShared();
+	directory = FindParent(name, leaf, TRUE, &dirSector);
+	sector = (directory == NULL) ? -1 : directory->Find(leaf);
+	isDir = (sector != -1) && directory->IsDirectory(leaf);
+	if (!isDir || wholeTree)
+	    break;
+	ReleaseDirectory(directory, TRUE);	// start over
+	treeLock->ReleaseShared();
+	wholeTree = TRUE;
     }
-    fileHdr = new FileHeader;
-    fileHdr->FetchFrom(sector);
-
-    freeMap = new BitMap(NumSectors);
-    freeMap->FetchFrom(freeMapFile);
+    if (sector == -1 || (isDir && !DirectoryIsEmpty(sector))) {
+	if (directory != NULL)
+	    ReleaseDirectory(directory, TRUE);
+	if (wholeTree)
+	    treeLock->ReleaseExclusive();
+	else
+	    treeLock->ReleaseShared();
+	journal->End();
+	return FALSE;			 // file not found, or busy directory
+    }
+    fileHdr = fileHeaderTable->Acquire(sector);
 
+    freeMapLock->P();
+    fileHdr->Lock()->AcquireExclusive();
     fileHdr->Deallocate(freeMap);  		// remove data blocks
+    fileHdr->Lock()->ReleaseExclusive();
     freeMap->Clear(sector);			// remove header block
-    directory->Remove(name);
-
     freeMap->WriteBack(freeMapFile);		// flush to disk
-    directory->WriteBack(directoryFile);        // flush to disk
-    delete fileHdr;
-    delete directory;
-    delete freeMap;
+    freeMapLock->V();
+
+    directory->Remove(leaf);
+    dirFile = OpenDirectory(dirSector);
+    directory->WriteBack(dirFile);        	// flush to disk
+    CloseDirectory(dirFile);
+    fileHeaderTable->Release(fileHdr);
+    fileHeaderTable->Invalidate(sector);	// sector may be reused
+    if (isDir)
+	dirTable->Invalidate(sector);
+    canon = CanonicalPath(name);
+    dentryCache->Insert(canon, -1, FALSE);	// remember it is gone
+    delete [] canon;
+    ReleaseDirectory(directory, TRUE);
+    if (wholeTree)
+	treeLock->ReleaseExclusive();
+    else
+	treeLock->ReleaseShared();
+    journal->End();
     return TRUE;
 } 
 
+//----------------------------------------------------------------------
+// FileSystem::DirectoryIsEmpty
+// 	Return TRUE if the directory whose header is at "sector" holds
+//	no files.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::DirectoryIsEmpty(int sector)
+{
+    Directory *directory = dirTable->Acquire(sector);
+    bool empty;
+
+    directory->Lock()->AcquireShared();
+    empty = directory->IsEmpty();
+    ReleaseDirectory(directory, FALSE);
+    return empty;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::FlushCaches
+// 	Write everything in the journal home, empty the name cache, drop
+//	all unused in-core directories and file headers, and empty the
+//	disk's buffer cache, so the next lookups see the cost of going
+//	to disk.
+//----------------------------------------------------------------------
+
+void
+FileSystem::FlushCaches()
+{
+    journal->Sync();
+    delete dentryCache;
+    dentryCache = new DentryCache(DentryCacheSize);
+    dirTable->Flush();
+    fileHeaderTable->Flush();
+    synchDisk->FlushCache();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Check
+// 	Check that the file system is consistent: that no sector is used
+//	twice, and that the bitmap marks exactly the sectors that some
+//	file header, data block or indirect block reachable from the root
+//	directory is using.  Print what is wrong, if anything, and return
+//	TRUE if nothing is.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Check()
+{
+    static int wellKnown[] = { FreeMapSector, DirectorySector, JournalSector };
+    BitMap *diskMap = new BitMap(synchDisk->NumSectors());
+    BitMap *used = new BitMap(synchDisk->NumSectors());
+    FileHeader *hdr = new FileHeader;
+    Directory *directory = new Directory;
+    bool ok = TRUE;
+    int i;
+
+    for (i = 0; i < 3; i++)
+	used->Mark(wellKnown[i]);
+    for (i = 0; i < 3; i++) {
+	hdr->FetchFrom(wellKnown[i]);
+	if (!hdr->MarkUsed(used)) {
+	    printf("Check: file at sector %d uses a sector twice\n",
+		wellKnown[i]);
+	    ok = FALSE;
+	}
+    }
+    directory->FetchFrom(directoryFile);
+    if (!directory->Check(used))
+	ok = FALSE;
+
+    diskMap->FetchFrom(freeMapFile);
+    for (i = 0; i < synchDisk->NumSectors(); i++)
+	if (used->Test(i) != diskMap->Test(i)) {
+	    printf("Check: sector %d is %s, but the bitmap says it is %s\n",
+		i, used->Test(i) ? "in use" : "free",
+		diskMap->Test(i) ? "in use" : "free");
+	    ok = FALSE;
+	}
+    delete diskMap;
+    delete used;
+    delete hdr;
+    delete directory;
+    return ok;
+}
+
 //----------------------------------------------------------------------
 // FileSystem::List
-// 	List all the files in the file system directory.
+// 	List all the files in the file system, starting at the root
+//	directory.
 //----------------------------------------------------------------------
 
 void
 FileSystem::List()
 {
-    Directory *directory = new Directory(NumDirEntries);
+    Directory *directory = new Directory;
 
     directory->FetchFrom(directoryFile);
-    directory->List();
+    directory->List("");
     delete directory;
 }
 
@@ -317,8 +765,8 @@ FileSystem::Print()
 {
     FileHeader *bitHdr = new FileHeader;
     FileHeader *dirHdr = new FileHeader;
-    BitMap *freeMap = new BitMap(NumSectors);
-    Directory *directory = new Directory(NumDirEntries);
+    BitMap *diskMap = new BitMap(synchDisk->NumSectors());
+    Directory *directory = new Directory;
 
     printf("Bit map file header:\n");
     bitHdr->FetchFrom(FreeMapSector);
@@ -328,14 +776,178 @@ FileSystem::Print()
     dirHdr->FetchFrom(DirectorySector);
     dirHdr->Print();
 
-    freeMap->FetchFrom(freeMapFile);
-    freeMap->Print();
+    diskMap->FetchFrom(freeMapFile);
+    diskMap->Print();
 
     directory->FetchFrom(directoryFile);
     directory->Print();
 
     delete bitHdr;
     delete dirHdr;
-    delete freeMap;
+    delete diskMap;
     delete directory;
 } 
+
+//----------------------------------------------------------------------
+// FileSystem::PrintLayout
+// 	Report how fragmented the disk is, to explain why some files
+//	take longer to read than others:
+//	  a histogram of the sizes of the runs of free sectors
+//	  for each file, the number of runs of consecutive sectors its
+//	    data is in, and how often reading it switches tracks
+//	  for each file, how long the disk would take to read it in one
+//	    request, and how much longer that is than if it were
+//	    contiguous
+//----------------------------------------------------------------------
+
+#define NumExtentBuckets	24	// free runs of 1, 2-3, 4-7, ... sectors
+
+void
+FileSystem::PrintLayout()
+{
+    int counts[NumExtentBuckets], sizes[NumExtentBuckets];
+    int i, run, bucket, largest = 0, numRuns = 0;
+    int numFiles = 0, numFragmented = 0, ticks, best;
+    Directory *directory = new Directory;
+    class List *files = new class List;
+    Directory *parent;
+    PathEntry *entry;
+    FileHeader *hdr;
+
+    for (i = 0; i < NumExtentBuckets; i++)
+	counts[i] = sizes[i] = 0;
+    freeMapLock->P();
+    for (i = run = 0; i <= synchDisk->NumSectors(); i++) {
+	if (i < synchDisk->NumSectors() && !freeMap->Test(i)) {
+	    run++;
+	    continue;
+	}
+	if (run > 0) {
+	    for (bucket = 0; bucket < NumExtentBuckets - 1
+				&& (2 << bucket) <= run; bucket++)
+		;
+	    counts[bucket]++;
+	    sizes[bucket] += run;
+	    largest = max(largest, run);
+	    numRuns++;
+	}
+	run = 0;
+    }
+    freeMapLock->V();
+
+    printf("Free space: %d sectors in %d runs, largest %d\n",
+	freeMap->NumClear(), numRuns, largest);
+    for (i = 0; i < NumExtentBuckets; i++)
+	if (counts[i] > 0)
+	    printf("  %7d-%7d sectors: %5d runs, %7d sectors\n", 1 << i,
+		(2 << i) - 1, counts[i], sizes[i]);
+
+    treeLock->AcquireShared();
+    directory->FetchFrom(directoryFile);
+    directory->Walk("", files);
+
+    printf("%-24s %8s %5s %7s %9s %6s\n", "File", "Bytes", "Runs",
+	"Seeks", "Ticks", "Slower");
+    while ((entry = (PathEntry *) files->Remove()) != NULL) {
+	if ((parent = LockEntry(entry)) != NULL) {
+	    hdr = fileHeaderTable->Acquire(entry->sector);
+	    hdr->Lock()->AcquireShared();
+	    ticks = hdr->ReadTime(FALSE);
+	    best = hdr->ReadTime(TRUE);
+	    printf("%-24s %8d %5d %7d %9d %5d%%\n", entry->path,
+		hdr->FileLength(), hdr->NumRuns(), hdr->NumTrackSwitches(),
+		ticks, (best == 0) ? 0 : 100 * (ticks - best) / best);
+	    numFiles++;
+	    if (hdr->NumRuns() > 1)
+		numFragmented++;
+	    hdr->Lock()->ReleaseShared();
+	    fileHeaderTable->Release(hdr);
+	    ReleaseDirectory(parent, FALSE);
+	}
+	delete entry;
+    }
+    treeLock->ReleaseShared();
+    printf("%d of %d files are fragmented\n", numFragmented, numFiles);
+    delete files;
+    delete directory;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Defragment
+// 	Move every fragmented file (other than directories) into the first
+//	run of free sectors that can hold it, while the file system stays
+//	in use.  Each move is one operation for the journal.
+//
+//	Each file is looked up again just before it moves, in case it
+//	has been removed since we walked the tree, and its directory is
+//	kept locked, so it can't be removed while it moves.  Reads and
+//	writes of the file wait on its header lock, and then see the
+//	new header.
+//----------------------------------------------------------------------
+
+void
+FileSystem::Defragment()
+{
+    Directory *directory = new Directory;
+    class List *files = new class List;
+    Directory *parent;
+    PathEntry *entry;
+    FileHeader *hdr;
+    int moved = 0;
+
+    treeLock->AcquireShared();
+    directory->FetchFrom(directoryFile);
+    directory->Walk("", files);
+    treeLock->ReleaseShared();
+
+    while ((entry = (PathEntry *) files->Remove()) != NULL) {
+	journal->Begin();
+	treeLock->AcquireShared();
+	if (!entry->isDir && (parent = LockEntry(entry)) != NULL) {
+	    hdr = fileHeaderTable->Acquire(entry->sector);
+	    freeMapLock->P();
+	    hdr->Lock()->AcquireExclusive();
+	    if (hdr->Relocate(freeMap)) {
+		hdr->WriteBack(entry->sector);
+		freeMap->WriteBack(freeMapFile);
+		DEBUG('f', "Moved %s to sector %d\n", entry->path,
+		    hdr->ByteToSector(0));
+		moved++;
+	    }
+	    hdr->Lock()->ReleaseExclusive();
+	    freeMapLock->V();
+	    fileHeaderTable->Release(hdr);
+	    ReleaseDirectory(parent, FALSE);
+	}
+	treeLock->ReleaseShared();
+	journal->End();			// may commit; don't hold any locks
+	delete entry;
+    }
+    printf("Defragment: moved %d files\n", moved);
+    delete files;
+    delete directory;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::LockEntry
+// 	Look up "entry", found earlier by Directory::Walk, again, and
+//	return the directory holding it, locked shared, so that the file
+//	can't be removed until the caller hands the directory back with
+//	ReleaseDirectory.  Return NULL if the path no longer names the
+//	same file header.  The caller holds treeLock shared.
+//----------------------------------------------------------------------
+
+Directory *
+FileSystem::LockEntry(PathEntry *entry)
+{
+    char name[FileNameMaxLen + 1];
+    Directory *parent;
+    int dirSector;
+
+    parent = FindParent(entry->path, name, FALSE, &dirSector);
+    if (parent != NULL && parent->Find(name) != entry->sector) {
+	ReleaseDirectory(parent, FALSE);
+	parent = NULL;
+    }
+    return parent;
+}
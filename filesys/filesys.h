@@ -20,11 +20,11 @@
 //	file system (in a file named "DISK"). 
 //
 //	In the "real" implementation, there are two key data structures used 
-//	in the file system.  There is a single "root" directory, listing
-//	all of the files in the file system; unlike UNIX, the baseline
-//	system does not provide a hierarchical directory structure.  
+//	in the file system.  There is a "root" directory, from which
+//	every file in the file system can be reached; as in UNIX, an
+//	entry in a directory may itself be a directory.
 //	In addition, there is a bitmap for allocating
-//	disk sectors.  Both the root directory and the bitmap are themselves
+//	disk sectors.  Both the directories and the bitmap are themselves
 //	stored as files in the Nachos file system -- this causes an interesting
 //	bootstrap problem when the simulated disk is initialized. 
 //
@@ -62,9 +62,18 @@ class FileSystem {
 
     bool Remove(char *name) { return Unlink(name) == 0; }
 
+    bool Extend(OpenFile *file, int newLength) { return TRUE; }
+				// UNIX files grow as they are written
 };
 
 #else // FILESYS
+class DentryCache;
+class DirectoryTable;
+class Directory;
+class PathEntry;
+class Semaphore;
+class RWLock;
+
 class FileSystem {
   public:
     FileSystem(bool format);		// Initialize the file system.
@@ -73,23 +82,62 @@ class FileSystem {
     					// If "format", there is nothing on
 					// the disk, so initialize the directory
     					// and the bitmap of free blocks.
+    ~FileSystem();			// Close the bitmap and root directory
 
     bool Create(char *name, int initialSize);  	
 					// Create a file (UNIX creat)
 
+    bool Mkdir(char *name);		// Create a directory (UNIX mkdir)
+
     OpenFile* Open(char *name); 	// Open a file (UNIX open)
 
-    bool Remove(char *name);  		// Delete a file (UNIX unlink)
+    bool Remove(char *name);  		// Delete a file, or an empty
+					// directory (UNIX unlink, rmdir)
+
+    bool Extend(OpenFile *file, int newLength);
+					// Grow an open file, so that it
+					// can be written past its end
 
     void List();			// List all the files in the file system
 
     void Print();			// List all the files and their contents
 
+    void PrintLayout();			// Report on free space fragmentation,
+					// and how each file is laid out
+    void Defragment();			// Move each fragmented file into
+					// consecutive sectors
+
+    void FlushCaches();			// Forget cached names and headers
+
+    bool Check();			// Is the file system consistent?
+
   private:
    OpenFile* freeMapFile;		// Bit map of free disk blocks,
 					// represented as a file
    OpenFile* directoryFile;		// "Root" directory -- list of 
 					// file names, represented as a file
+   BitMap *freeMap;			// In-core copy of the bitmap
+   Semaphore *freeMapLock;		// One thread changing it at a time
+   DirectoryTable *dirTable;		// Directories kept in memory
+   DentryCache *dentryCache;		// Recently looked up path names
+   RWLock *treeLock;			// Exclusive to remove a directory,
+					// shared for every other operation
+					// on names
+
+   Directory *FindParent(char *path, char *name, bool exclusive,
+			int *dirSector);
+					// Find and lock the directory
+					// holding "path"
+   void ReleaseDirectory(Directory *dir, bool exclusive);
+					// Unlock it, and let it go
+   Directory *LockEntry(PathEntry *entry);
+					// Find and lock the directory
+					// holding a file found by Walk
+   OpenFile *OpenDirectory(int sector);	// Open a directory by header sector
+   void CloseDirectory(OpenFile *dirFile);
+   bool DirectoryIsEmpty(int sector);	// Does that directory hold no files?
+   bool CreateEntry(char *path, int initialSize, bool isDir);
+					// Common code for Create and Mkdir
 };
 
 #endif // FILESYS
@@ -3,10 +3,15 @@
 //
 //	We implement:
 //	   Copy -- copy a file from UNIX to Nachos
+//	   CopyOut -- copy a file from Nachos to UNIX
 //	   Print -- cat the contents of a Nachos file 
 //	   Perftest -- a stress test for the Nachos file system
 //		read and write a really large file in tiny chunks
 //		(won't work on baseline system!)
+//	   OpenTest -- open the same files over and over, to measure
+//		the cost of name lookup
+//	   DiskSchedTest -- many threads reading random sectors, to
+//		compare the disk scheduling policies
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -21,11 +26,17 @@
 #include "disk.h"
 #include "stats.h"
 
-#define TransferSize 	10 	// make it small, just to be difficult
+#define CopySize	(synchDisk->SectorsPerTrack() * SectorSize)
+				// a track at a time, for Copy and CopyOut
 
 //----------------------------------------------------------------------
 // Copy
 // 	Copy the contents of the UNIX file "from" to the Nachos file "to"
+//
+//	The Nachos file is created at its full length, so all of its
+//	sectors are allocated at once, and then written a track at a
+//	time; every write but the last covers whole sectors, so none of
+//	them has to read a sector in first.
 //----------------------------------------------------------------------
 
 void
@@ -58,9 +69,9 @@ Copy(char *from, char *to)
     openFile = fileSystem->Open(to);
     ASSERT(openFile != NULL);
     
-// Copy the data in TransferSize chunks
-    buffer = new char[TransferSize];
-    while ((amountRead = fread(buffer, sizeof(char), TransferSize, fp)) > 0)
+// Copy the data in CopySize chunks
+    buffer = new char[CopySize];
+    while ((amountRead = fread(buffer, sizeof(char), CopySize, fp)) > 0)
 	openFile->Write(buffer, amountRead);	
     delete [] buffer;
 
@@ -69,6 +80,41 @@ Copy(char *from, char *to)
     fclose(fp);
 }
 
+//----------------------------------------------------------------------
+// CopyOut
+// 	Copy the contents of the Nachos file "from" to the UNIX file "to",
+//	a track at a time.
+//----------------------------------------------------------------------
+
+void
+CopyOut(char *from, char *to)
+{
+    FILE *fp;
+    OpenFile* openFile;
+    int amountRead;
+    char *buffer;
+
+    if ((openFile = fileSystem->Open(from)) == NULL) {
+	printf("CopyOut: couldn't open input file %s\n", from);
+	return;
+    }
+    if ((fp = fopen(to, "w")) == NULL) {
+	printf("CopyOut: couldn't create output file %s\n", to);
+	delete openFile;
+	return;
+    }
+
+    DEBUG('f', "Copying file %s, size %d, to file %s\n", from,
+		openFile->Length(), to);
+    buffer = new char[CopySize];
+    while ((amountRead = openFile->Read(buffer, CopySize)) > 0)
+	fwrite(buffer, sizeof(char), amountRead, fp);
+    delete [] buffer;
+
+    delete openFile;
+    fclose(fp);
+}
+
 //----------------------------------------------------------------------
 // Print
 // 	Print the contents of the Nachos file "name".
@@ -86,8 +132,8 @@ Print(char *name)
 	return;
     }
     
-    buffer = new char[TransferSize];
-    while ((amountRead = openFile->Read(buffer, TransferSize)) > 0)
+    buffer = new char[CopySize];
+    while ((amountRead = openFile->Read(buffer, CopySize)) > 0)
 	for (i = 0; i < amountRead; i++)
 	    printf("%c", buffer[i]);
     delete [] buffer;
@@ -183,3 +229,975 @@ PerformanceTest()
     stats->Print();
 }
 
+
+//----------------------------------------------------------------------
+// OpenTest
+// 	Measure how many disk reads it takes to open files.  Builds a
+//	few levels of directories with a file at the bottom, then opens
+//	it (and a name that does not exist) over and over.  The first
+//	open, with the caches flushed, costs what every open did before
+//	there were caches: reading every directory along the path.  Once
+//	the name cache and the in-core header table are warm, later opens
+//	should not touch the disk at all.
+//----------------------------------------------------------------------
+
+#define OpenDepth	4
+#define OpenIterations	100
+
+static int
+OpenLoop(char *name, int iterations)
+{
+    int reads = stats->numDiskReads;
+    OpenFile *openFile;    
+
+    for (int i = 0; i < iterations; i++) {
+	openFile = fileSystem->Open(name);
+	delete openFile;		// close file (NULL if missing)
+    }
+    return stats->numDiskReads - reads;
+}
+
+void
+OpenTest()
+{
+    char path[OpenDepth * 4 + 16];
+    char missing[sizeof(path) + 8];	// path, and "/nothere"
+    int i, cold, warm;
+
+    printf("Starting file system open test:\n");
+    path[0] = '\0';
+    for (i = 0; i < OpenDepth; i++) {
+	sprintf(path + strlen(path), "/d%d", i);
+	if (!fileSystem->Mkdir(path)) {
+	    printf("Open test: can't make directory %s\n", path);
+	    return;
+	}
+    }
+    sprintf(missing, "%s/nothere", path);
+    strcat(path, "/file");
+    if (!fileSystem->Create(path, 0)) {
+	printf("Open test: can't create %s\n", path);
+	return;
+    }
+
+    fileSystem->FlushCaches();
+    cold = OpenLoop(path, 1);
+    warm = OpenLoop(path, OpenIterations - 1);
+    printf("Open %s: first time %d disk reads, next %d times %d disk reads\n",
+	path, cold, OpenIterations - 1, warm);
+    fileSystem->FlushCaches();
+    cold = OpenLoop(missing, 1);
+    warm = OpenLoop(missing, OpenIterations - 1);
+    printf("Open %s: first time %d disk reads, next %d times %d disk reads\n",
+	missing, cold, OpenIterations - 1, warm);
+
+    fileSystem->Remove(path);
+    for (i = OpenDepth - 1; i >= 0; i--) {
+	*strrchr(path, '/') = '\0';
+	fileSystem->Remove(path);
+    }
+}
+
+//----------------------------------------------------------------------
+// DiskSchedTest
+// 	Compare the disk scheduling policies.  For each policy, fork
+//	SchedThreads threads, each reading SchedRequests random sectors
+//	one at a time, so that the disk queue stays full.  Report the
+//	throughput, and the spread of the time each read took from
+//	request to completion.  Every policy sees the same sectors.
+//
+//	Implemented as:
+//	  RandomReader -- one thread's share of the reads
+//	  DiskSchedTest -- overall control, and print out performance #'s
+//----------------------------------------------------------------------
+
+#define SchedThreads	8
+#define SchedRequests	25
+#define SchedSeed	17
+
+static int schedLatency[SchedThreads * SchedRequests];
+static int schedCount;
+static Semaphore *schedDone;
+
+static void
+RandomReader(int which)
+{
+    char buffer[SectorSize];
+    int start;
+
+    for (int i = 0; i < SchedRequests; i++) {
+	start = stats->totalTicks;
+	synchDisk->ReadSector(Random() % synchDisk->NumSectors(), buffer);
+	schedLatency[schedCount++] = stats->totalTicks - start;
+    }
+    schedDone->V();
+}
+
+void
+DiskSchedTest()
+{
+    static char *policyNames[] = { "FCFS", "SSTF", "LOOK", "C-LOOK" };
+    int n = SchedThreads * SchedRequests;
+    int policy, i, j, key, start, elapsed;
+    Thread *t;
+
+    printf("Starting disk scheduling test: %d threads, %d reads each\n",
+	SchedThreads, SchedRequests);
+    schedDone = new Semaphore("disk sched test", 0);
+    for (policy = DiskFCFS; policy <= DiskCLOOK; policy++) {
+	synchDisk->SetPolicy((DiskPolicy) policy);
+	RandomInit(SchedSeed);
+	schedCount = 0;
+	start = stats->totalTicks;
+	for (i = 0; i < SchedThreads; i++) {
+	    t = new Thread("random reader");
+	    t->Fork(RandomReader, (void *) i);
+	}
+	for (i = 0; i < SchedThreads; i++)
+	    schedDone->P();
+	elapsed = stats->totalTicks - start;
+
+	for (i = 1; i < n; i++) {		// sort the latencies
+	    key = schedLatency[i];
+	    for (j = i - 1; j >= 0 && schedLatency[j] > key; j--)
+		schedLatency[j + 1] = schedLatency[j];
+	    schedLatency[j + 1] = key;
+	}
+	printf("%-6s: %d reads in %d ticks, %d ticks/read; "
+	       "latency p50 %d, p90 %d, p99 %d, max %d\n",
+	    policyNames[policy], n, elapsed, elapsed / n,
+	    schedLatency[n / 2], schedLatency[n * 9 / 10],
+	    schedLatency[n * 99 / 100], schedLatency[n - 1]);
+    }
+    synchDisk->SetPolicy(DiskCLOOK);
+    delete schedDone;
+}
+
+//----------------------------------------------------------------------
+// SmallWriteTest
+// 	Time lots of small writes at unaligned offsets, some of them
+//	straddling a sector boundary, the way a program writing records
+//	one at a time would.  Each write has to read the sectors it only
+//	partly covers, so report the disk reads and writes per write as
+//	well as the time.  Finally read the file back in one unaligned
+//	piece, and check it against a copy kept in memory.
+//----------------------------------------------------------------------
+
+#define SmallFileName	"SmallWrites"
+#define SmallFileSize	(16 * SectorSize)
+#define SmallWriteSize	10
+#define SmallWrites	1000
+#define SmallStride	37
+
+void
+SmallWriteTest()
+{
+    char *expected = new char[SmallFileSize];
+    char *result = new char[SmallFileSize];
+    char record[SmallWriteSize];
+    OpenFile *openFile;
+    int i, j, position, start, reads, writes, elapsed;
+
+    printf("Starting small write test: %d writes of %d bytes\n",
+	SmallWrites, SmallWriteSize);
+    if (!fileSystem->Create(SmallFileName, SmallFileSize)) {
+	printf("Small write test: can't create %s\n", SmallFileName);
+	return;
+    }
+    openFile = fileSystem->Open(SmallFileName);
+    bzero(expected, SmallFileSize);
+    openFile->WriteAt(expected, SmallFileSize, 0);
+
+    start = stats->totalTicks;
+    reads = stats->numDiskReads;
+    writes = stats->numDiskWrites;
+    position = 1;
+    for (i = 0; i < SmallWrites; i++) {
+	for (j = 0; j < SmallWriteSize; j++)
+	    record[j] = 'a' + (i + j) % 26;
+	openFile->WriteAt(record, SmallWriteSize, position);
+	bcopy(record, &expected[position], SmallWriteSize);
+	position = (position + SmallStride) % (SmallFileSize - SmallWriteSize);
+    }
+    elapsed = stats->totalTicks - start;
+    reads = stats->numDiskReads - reads;
+    writes = stats->numDiskWrites - writes;
+    printf("%d writes in %d ticks, %d ticks/write; %d disk reads, "
+	   "%d disk writes\n", SmallWrites, elapsed, elapsed / SmallWrites,
+	reads, writes);
+
+    if (openFile->ReadAt(result + 3, SmallFileSize - 5, 3) != SmallFileSize - 5
+	  || bcmp(result + 3, expected + 3, SmallFileSize - 5))
+	printf("Small write test: file contents are wrong!\n");
+    delete openFile;
+    fileSystem->Remove(SmallFileName);
+    delete [] expected;
+    delete [] result;
+}
+
+//----------------------------------------------------------------------
+// CrashTest
+// 	Check that the journal keeps the file system consistent however
+//	a crash cuts it off.  Each trial makes the disk lose every write
+//	after a random point part way through a series of creates and
+//	removes, then throws away everything in memory and mounts the
+//	disk again, as if Nachos had been restarted.  The file system
+//	should always come back consistent, without reading more than
+//	the log to get there.
+//
+//	First, though, crash right after a mount that had nothing to redo
+//	(CrashAfterMount).
+//
+//	Implemented as:
+//	  CrashOps -- the operations the crash interrupts
+//	  CrashCleanup -- remove whatever of them made it to disk
+//	  PowerFail -- throw away everything in memory
+//	  CrashAfterMount -- commit one transaction after a mount, and crash
+//	  CrashTest -- overall control, and print out the results
+//----------------------------------------------------------------------
+
+#define CrashFiles	8
+#define CrashTrials	20
+
+static void
+CrashOps()
+{
+    char name[32];
+    int i;
+
+    fileSystem->Mkdir("/crash");
+    for (i = 0; i < CrashFiles; i++) {
+	sprintf(name, "/crash/f%d", i);
+	fileSystem->Create(name, i * 1000);
+    }
+    for (i = 0; i < CrashFiles; i += 2) {
+	sprintf(name, "/crash/f%d", i);
+	fileSystem->Remove(name);
+    }
+    fileSystem->Mkdir("/crash/sub");
+    fileSystem->Create("/crash/sub/x", 3000);
+    fileSystem->FlushCaches();			// checkpoint, too
+}
+
+static void
+CrashCleanup()
+{
+    char name[32];
+
+    fileSystem->Remove("/crash/sub/x");
+    fileSystem->Remove("/crash/sub");
+    for (int i = 0; i < CrashFiles; i++) {
+	sprintf(name, "/crash/f%d", i);
+	fileSystem->Remove(name);
+    }
+    fileSystem->Remove("/crash");
+    fileSystem->FlushCaches();
+}
+
+static void
+PowerFail()
+{
+    delete fileSystem;				// the power fails...
+    synchDisk->FlushCache();			// ...and memory is lost
+    fileHeaderTable->Flush();
+    synchDisk->CrashAfter(-1);
+}
+
+// Mounting has to start the log over at the next sequence number even
+// when there is nothing to redo, or the first transaction after it is
+// logged under a number the next mount doesn't look for, and is lost.
+
+static bool
+CrashAfterMount()
+{
+    OpenFile *openFile;
+
+    fileSystem->FlushCaches();			// empty the log
+    PowerFail();
+    fileSystem = new FileSystem(FALSE);		// nothing to redo
+    journal->SetCommitInterval(0);
+    fileSystem->Create("/mounted", 0);		// committed...
+    journal->SetCommitInterval(JournalCommitInterval);
+    synchDisk->CrashAfter(0);			// ...but never checkpointed
+    PowerFail();
+    fileSystem = new FileSystem(FALSE);
+
+    openFile = fileSystem->Open("/mounted");
+    if (openFile == NULL) {
+	printf("Crash after mount: committed file is lost!\n");
+	return FALSE;
+    }
+    delete openFile;
+    fileSystem->Remove("/mounted");
+    return TRUE;
+}
+
+void
+CrashTest()
+{
+    int trial, writes, crashAt, start, reads, ticks;
+    int maxTicks = 0, totalTicks = 0, maxReads = 0, consistent = 0;
+    int replays = stats->numJournalReplays;
+
+    printf("Starting crash test: %d trials\n", CrashTrials);
+    if (CrashAfterMount())
+	printf("Crash after mount: committed file survived\n");
+    CrashCleanup();
+    writes = stats->numDiskWrites;
+    CrashOps();
+    writes = stats->numDiskWrites - writes;
+    CrashCleanup();
+
+    for (trial = 0; trial < CrashTrials; trial++) {
+	crashAt = Random() % writes;
+	synchDisk->CrashAfter(crashAt);
+	CrashOps();
+	PowerFail();
+
+	start = stats->totalTicks;
+	reads = stats->numDiskReads;
+	fileSystem = new FileSystem(FALSE);	// mount, and recover
+	ticks = stats->totalTicks - start;
+	reads = stats->numDiskReads - reads;
+	maxTicks = max(maxTicks, ticks);
+	maxReads = max(maxReads, reads);
+	totalTicks += ticks;
+
+	if (fileSystem->Check())
+	    consistent++;
+	else
+	    printf("Crash after %d of %d writes: file system is "
+		   "inconsistent!\n", crashAt, writes);
+	CrashCleanup();
+    }
+    printf("%d of %d crashes recovered consistently; %d transactions "
+	   "redone\n", consistent, CrashTrials,
+	stats->numJournalReplays - replays);
+    printf("Mount took %d ticks on average, at most %d ticks and %d "
+	   "disk reads\n", totalTicks / CrashTrials, maxTicks, maxReads);
+}
+
+//----------------------------------------------------------------------
+// GroupCommitTest
+// 	Measure how fast threads can create and remove files, with and
+//	without grouping their changes into one journal commit per
+//	commit interval.  Each of the threads creates and removes its
+//	own files, all in the same directory, so every operation changes
+//	that directory and the bitmap.  Report operations per simulated
+//	second (a tick being a microsecond), counting the time to get
+//	them all onto the disk at the end, and what they cost in commits
+//	and disk writes.
+//
+//	Implemented as:
+//	  CreateRemover -- one thread's share of the operations
+//	  GroupCommitTest -- overall control, and print out performance #'s
+//----------------------------------------------------------------------
+
+#define CommitThreads	8
+#define CommitPairs	20		// creates and removes per thread
+
+static Semaphore *commitDone;
+
+static void
+CreateRemover(int which)
+{
+    char name[32];
+
+    for (int i = 0; i < CommitPairs; i++) {
+	sprintf(name, "/gc/t%d_%d", which, i);
+	if (!fileSystem->Create(name, SectorSize)
+			|| !fileSystem->Remove(name))
+	    printf("Group commit test: %s failed\n", name);
+    }
+    commitDone->V();
+}
+
+void
+GroupCommitTest()
+{
+    static int intervals[] = { 0, JournalCommitInterval };
+    static int numThreads[] = { 1, CommitThreads };
+    int i, j, k, ops, start, ticks, writes, commits;
+    Thread *t;
+
+    printf("Starting group commit test: %d creates and removes "
+	   "per thread\n", 2 * CommitPairs);
+    if (!fileSystem->Mkdir("/gc")) {
+	printf("Group commit test: can't make /gc\n");
+	return;
+    }
+    commitDone = new Semaphore("group commit test", 0);
+    for (i = 0; i < 2; i++) {
+	journal->SetCommitInterval(intervals[i]);
+	for (j = 0; j < 2; j++) {
+	    fileSystem->FlushCaches();		// start with an empty log
+	    ops = 2 * CommitPairs * numThreads[j];
+	    start = stats->totalTicks;
+	    writes = stats->numDiskWrites;
+	    commits = stats->numJournalCommits;
+	    for (k = 0; k < numThreads[j]; k++) {
+		t = new Thread("create/remove");
+		t->Fork(CreateRemover, (void *) k);
+	    }
+	    for (k = 0; k < numThreads[j]; k++)
+		commitDone->P();
+	    journal->Sync();			// until it's all on disk
+	    ticks = stats->totalTicks - start;
+	    printf("commit interval %5d, %d thread%s: %d ops in %d ticks, "
+		   "%d ops/sec; %d commits, %d disk writes\n",
+		intervals[i], numThreads[j], (numThreads[j] == 1) ? "" : "s",
+		ops, ticks, (int) ((double) ops * 1000000 / ticks),
+		stats->numJournalCommits - commits,
+		stats->numDiskWrites - writes);
+	}
+    }
+    journal->SetCommitInterval(JournalCommitInterval);
+    fileSystem->Remove("/gc");
+    delete commitDone;
+}
+
+//----------------------------------------------------------------------
+// ConcurrencyTest
+// 	Fill a directory with files, reporting how many sectors each
+//	create logs -- only the directory blocks that changed, not the
+//	whole directory.  Then have threads open and read the files,
+//	all in that one directory, while another thread keeps creating
+//	and removing files in it.  Every reader checks what it reads.
+//	Run with -rs, so that threads are switched at random points.
+//
+//	Implemented as:
+//	  FileChecker -- one reader thread
+//	  Churner -- the thread changing the directory
+//	  ConcurrencyTest -- overall control, and print out the results
+//----------------------------------------------------------------------
+
+#define ConcFiles	64
+#define ConcFileSize	(2 * SectorSize)
+#define ConcReaders	8
+#define ConcReads	40
+
+static Semaphore *concDone;
+static int concErrors;
+
+static void
+FileChecker(int which)
+{
+    char name[32], buffer[ConcFileSize];
+    OpenFile *openFile;
+    int i, j, f;
+
+    for (i = 0; i < ConcReads; i++) {
+	f = (which * ConcReads + i * 7) % ConcFiles;
+	sprintf(name, "/cc/f%d", f);
+	openFile = fileSystem->Open(name);
+	if (openFile == NULL) {
+	    printf("Concurrency test: can't open %s\n", name);
+	    concErrors++;
+	    continue;
+	}
+	if (openFile->ReadAt(buffer, ConcFileSize, 0) != ConcFileSize)
+	    concErrors++;
+	else
+	    for (j = 0; j < ConcFileSize; j++)
+		if (buffer[j] != (char) ('a' + f % 26)) {
+		    printf("Concurrency test: %s has bad data\n", name);
+		    concErrors++;
+		    break;
+		}
+	delete openFile;
+    }
+    concDone->V();
+}
+
+static void
+Churner(int dummy)
+{
+    char name[32];
+
+    for (int i = 0; i < ConcReads; i++) {
+	sprintf(name, "/cc/tmp%d", i);
+	if (!fileSystem->Create(name, SectorSize)
+			|| !fileSystem->Remove(name)) {
+	    printf("Concurrency test: %s failed\n", name);
+	    concErrors++;
+	}
+    }
+    concDone->V();
+}
+
+void
+ConcurrencyTest()
+{
+    char name[32], buffer[ConcFileSize];
+    OpenFile *openFile;
+    int i, logged, start;
+    Thread *t;
+
+    printf("Starting concurrency test: %d files, %d reader threads\n",
+	ConcFiles, ConcReaders);
+    if (!fileSystem->Mkdir("/cc")) {
+	printf("Concurrency test: can't make /cc\n");
+	return;
+    }
+    journal->SetCommitInterval(0);		// log each create by itself
+    logged = stats->numJournalSectors;
+    for (i = 0; i < ConcFiles; i++) {
+	sprintf(name, "/cc/f%d", i);
+	memset(buffer, 'a' + i % 26, ConcFileSize);
+	if (!fileSystem->Create(name, ConcFileSize)
+		|| (openFile = fileSystem->Open(name)) == NULL) {
+	    printf("Concurrency test: can't create %s\n", name);
+	    return;
+	}
+	openFile->WriteAt(buffer, ConcFileSize, 0);
+	delete openFile;
+    }
+    printf("%d creates logged %d sectors, %d per create\n", ConcFiles,
+	stats->numJournalSectors - logged,
+	(stats->numJournalSectors - logged) / ConcFiles);
+    journal->SetCommitInterval(JournalCommitInterval);
+
+    fileSystem->FlushCaches();
+    concDone = new Semaphore("concurrency test", 0);
+    concErrors = 0;
+    start = stats->totalTicks;
+    for (i = 0; i < ConcReaders; i++) {
+	t = new Thread("file checker");
+	t->Fork(FileChecker, (void *) i);
+    }
+    t = new Thread("churner");
+    t->Fork(Churner, (void *) 0);
+    for (i = 0; i <= ConcReaders; i++)
+	concDone->P();
+    printf("%d opens and reads, %d creates and removes in %d ticks; "
+	   "%d errors\n", ConcReaders * ConcReads, ConcReads,
+	stats->totalTicks - start, concErrors);
+
+    for (i = 0; i < ConcFiles; i++) {
+	sprintf(name, "/cc/f%d", i);
+	fileSystem->Remove(name);
+    }
+    fileSystem->Remove("/cc");
+    delete concDone;
+}
+
+//----------------------------------------------------------------------
+// SmallFileTest
+// 	Measure what it costs to read many small files, the way a
+//	directory of configuration files or source files would be read:
+//	fill a directory with files of less than a sector, flush the
+//	caches, then open and read every file, checking what it reads.
+//	Then grow one of them past what fits in its header, and check
+//	that its old contents survive.
+//----------------------------------------------------------------------
+
+#define SmallFiles	64
+#define SmallGrowSize	(3 * SectorSize)
+
+static int
+SmallSize(int i)
+{
+    return 16 + (i % 6) * 20;			// 16 to 116 bytes
+}
+
+static bool
+SmallCheck(char *name, char fill, int size)
+{
+    char buffer[SmallGrowSize];
+    OpenFile *openFile = fileSystem->Open(name);
+    bool ok;
+
+    if (openFile == NULL)
+	return FALSE;
+    ok = (openFile->Length() == size)
+	    && (openFile->ReadAt(buffer, size, 0) == size);
+    for (int i = 0; ok && i < size; i++)
+	ok = (buffer[i] == fill + i % 7);
+    delete openFile;
+    return ok;
+}
+
+void
+SmallFileTest()
+{
+    char name[32], buffer[SmallGrowSize];
+    OpenFile *openFile;
+    int i, j, reads, writes, errors = 0;
+
+    printf("Starting small file test: %d files of %d to %d bytes\n",
+	SmallFiles, SmallSize(0), SmallSize(5));
+    if (!fileSystem->Mkdir("/sf")) {
+	printf("Small file test: can't make /sf\n");
+	return;
+    }
+    writes = stats->numDiskWrites;
+    for (i = 0; i < SmallFiles; i++) {
+	sprintf(name, "/sf/f%d", i);
+	for (j = 0; j < SmallSize(i); j++)
+	    buffer[j] = 'a' + i % 19 + j % 7;
+	if (!fileSystem->Create(name, SmallSize(i))
+		|| (openFile = fileSystem->Open(name)) == NULL) {
+	    printf("Small file test: can't create %s\n", name);
+	    return;
+	}
+	openFile->WriteAt(buffer, SmallSize(i), 0);
+	delete openFile;
+    }
+    fileSystem->FlushCaches();
+    printf("Create and write: %d disk writes\n",
+	stats->numDiskWrites - writes);
+
+    reads = stats->numDiskReads;
+    for (i = 0; i < SmallFiles; i++) {
+	sprintf(name, "/sf/f%d", i);
+	if (!SmallCheck(name, 'a' + i % 19, SmallSize(i)))
+	    errors++;
+    }
+    reads = stats->numDiskReads - reads;
+    printf("Open and read: %d disk reads, %d.%02d per file; %d errors\n",
+	reads, reads / SmallFiles, (reads * 100 / SmallFiles) % 100, errors);
+
+    // grow a file well past one sector
+    openFile = fileSystem->Open("/sf/f1");
+    for (j = 0; j < SmallGrowSize; j++)
+	buffer[j] = 'b' + j % 7;
+    if (!fileSystem->Extend(openFile, SmallGrowSize)
+	    || openFile->WriteAt(&buffer[SmallSize(1)],
+		SmallGrowSize - SmallSize(1), SmallSize(1))
+			!= SmallGrowSize - SmallSize(1))
+	printf("Small file test: can't grow /sf/f1\n");
+    delete openFile;
+    fileSystem->FlushCaches();
+    if (!SmallCheck("/sf/f1", 'b', SmallGrowSize))
+	printf("Small file test: /sf/f1 is wrong after growing\n");
+
+    for (i = 0; i < SmallFiles; i++) {
+	sprintf(name, "/sf/f%d", i);
+	fileSystem->Remove(name);
+    }
+    fileSystem->Remove("/sf");
+}
+
+//----------------------------------------------------------------------
+// TimeDisks
+// 	Run "func(arg)", and return how many ticks it took.  The disk
+//	tests time the same work on one disk and then on several; the
+//	run on one disk ("count" is 1) is saved in "*oneDisk", for
+//	PrintSpeedup to compare the later runs against.
+//
+// PrintSpeedup
+// 	Print how many times faster "ticks" is than "oneDisk".
+//----------------------------------------------------------------------
+
+static int
+TimeDisks(VoidFunctionPtr func, int arg, int count, int *oneDisk)
+{
+    int start = stats->totalTicks, ticks;
+
+    (*func)(arg);
+    ticks = stats->totalTicks - start;
+    if (count == 1)
+	*oneDisk = ticks;
+    return ticks;
+}
+
+static void
+PrintSpeedup(int ticks, int oneDisk)
+{
+    printf("%d.%02dx", oneDisk / ticks, (oneDisk * 100 / ticks) % 100);
+}
+
+//----------------------------------------------------------------------
+// ParallelDiskTest
+// 	Show what spreading I/O over several disks buys.  ParallelThreads
+//	threads each read ParallelReads random sectors, one at a time;
+//	first all from the first disk, then spread over the first two
+//	disks, and so on, up to every disk (cf. -disk).  The disks work
+//	at the same time, so the same reads should take less time the
+//	more disks they are spread over.
+//
+//	Implemented as:
+//	  ParallelReader -- one thread's share of the reads
+//	  ParallelRound -- all the threads' reads, over parallelDisks disks
+//	  ParallelDiskTest -- overall control, and print out performance #'s
+//----------------------------------------------------------------------
+
+#define ParallelThreads	8
+#define ParallelReads	25
+#define ParallelSeed	23
+
+static int parallelDisks;		// disks in use this round
+static Semaphore *parallelDone;
+
+static void
+ParallelReader(int which)
+{
+    SynchDisk *disk = synchDisks[which % parallelDisks];
+    char buffer[SectorSize];
+
+    for (int i = 0; i < ParallelReads; i++)
+	disk->ReadSector(Random() % disk->NumSectors(), buffer);
+    parallelDone->V();
+}
+
+static void
+ParallelRound(int dummy)
+{
+    Thread *t;
+    int i;
+
+    for (i = 0; i < ParallelThreads; i++) {
+	t = new Thread("parallel reader");
+	t->Fork(ParallelReader, (void *) i);
+    }
+    for (i = 0; i < ParallelThreads; i++)
+	parallelDone->P();
+}
+
+void
+ParallelDiskTest()
+{
+    int n = ParallelThreads * ParallelReads;
+    int i, elapsed, oneDisk = 0;
+
+    printf("Starting parallel disk test: %d threads, %d reads each\n",
+	ParallelThreads, ParallelReads);
+    parallelDone = new Semaphore("parallel disk test", 0);
+    for (parallelDisks = 1; parallelDisks <= numDisks; parallelDisks++) {
+	for (i = 0; i < parallelDisks; i++)
+	    synchDisks[i]->FlushCache();
+	RandomInit(ParallelSeed);
+	elapsed = TimeDisks(ParallelRound, 0, parallelDisks, &oneDisk);
+	printf("%d disk%s: %d reads in %d ticks, %d ticks/read, ",
+	    parallelDisks, (parallelDisks == 1) ? "" : "s", n, elapsed,
+	    elapsed / n);
+	PrintSpeedup(elapsed, oneDisk);
+	printf(" one disk\n");
+    }
+    delete parallelDone;
+}
+
+//----------------------------------------------------------------------
+// RaidTest
+// 	Show how striped (RAID-0) and mirrored (RAID-1) disks scale.  For
+//	each, over 1, 2 and 4 new disks in scratch UNIX files: write
+//	RaidSectors sectors, RaidChunk sectors per request; read them
+//	back the same way; then read RaidReads random sectors among them,
+//	one at a time.  Report the time each takes, and how much faster
+//	that is than on one disk.
+//
+//	Striping splits each big request over all the disks, which
+//	transfer their parts at the same time.  Mirroring writes every
+//	disk, so writes gain nothing, but a big read is split like a
+//	striped one, and a small one goes to whichever disk's head is
+//	closest.  Only one request is sent to the disks at a time, so
+//	random reads gain only from the shorter seeks.
+//
+//	Implemented as:
+//	  RaidPass -- one of the three passes over the array
+//	  RaidRun -- time one kind of array, over some number of disks
+//	  RaidTest -- overall control
+//----------------------------------------------------------------------
+
+#define RaidMaxDisks	4
+#define RaidSectors	512
+#define RaidChunk	64
+#define RaidReads	200
+#define RaidSeed	29
+
+static char *raidNames[RaidMaxDisks] = { "RAID0", "RAID1", "RAID2", "RAID3" };
+static char *raidPassNames[3] = { "write", "read", "random" };
+static SynchDisk *raidDisk;		// the array being timed
+static char *raidBuffer;		// RaidChunk sectors' worth
+
+static void
+RaidPass(int which)
+{
+    int sectors[RaidChunk];
+    char *data[RaidChunk];
+    int i, j;
+
+    for (j = 0; j < RaidChunk; j++)
+	data[j] = &raidBuffer[j * SectorSize];
+    if (which == 2) {			// random reads
+	for (i = 0; i < RaidReads; i++)
+	    raidDisk->ReadSector(Random() % RaidSectors, raidBuffer);
+	return;
+    }
+    for (i = 0; i < RaidSectors; i += RaidChunk) {
+	for (j = 0; j < RaidChunk; j++)
+	    sectors[j] = i + j;
+	if (which == 0)
+	    raidDisk->WriteSectors(sectors, data, RaidChunk);
+	else
+	    raidDisk->ReadSectors(sectors, data, RaidChunk);
+    }
+}
+
+static void
+RaidRun(RaidLevel level, int count, int *oneDisk)
+{
+    int i, ticks;
+    BlockDevice *device;
+
+    for (i = 0; i < count; i++)
+	Unlink(raidNames[i]);
+    raidDisk = new SynchDisk(raidNames, count, level, DiskFile,
+	DefaultSectorsPerTrack, DefaultNumTracks);
+    raidBuffer = new char[RaidChunk * SectorSize];
+
+    printf("RAID-%d, %d disk%s:", (level == Raid0) ? 0 : 1, count,
+	(count == 1) ? " " : "s");
+    for (i = 0; i < 3; i++) {
+	raidDisk->FlushCache();		// reads have to go to the disks
+	RandomInit(RaidSeed);
+	ticks = TimeDisks(RaidPass, i, count, &oneDisk[i]);
+	printf(" %s %d (", raidPassNames[i], ticks);
+	PrintSpeedup(ticks, oneDisk[i]);
+	printf(")");
+    }
+    printf("\n    requests per disk:");
+    device = raidDisk->Device();
+    for (i = 0; i < count; i++)
+	printf(" %d", device->DiskRequests(i));
+    printf("\n");
+
+    delete raidDisk;
+    for (i = 0; i < count; i++)		// don't leave the scratch files
+	Unlink(raidNames[i]);
+    delete [] raidBuffer;
+}
+
+void
+RaidTest()
+{
+    int oneDisk[3];
+
+    printf("Starting RAID test: %d sectors, %d per request, "
+	   "%d random reads; times in ticks\n", RaidSectors, RaidChunk,
+	RaidReads);
+    for (int n = 1; n <= RaidMaxDisks; n *= 2)
+	RaidRun(Raid0, n, oneDisk);
+    for (int n = 1; n <= RaidMaxDisks; n *= 2)
+	RaidRun(Raid1, n, oneDisk);
+}
+
+//----------------------------------------------------------------------
+// DriveModelTest
+// 	Compare kinds of disk drive (see DiskModel), each on a new disk
+//	in a scratch UNIX file.  On each: read ModelSectors consecutive
+//	sectors one at a time, as reading a file laid out in one run
+//	would; do it again, spending ModelThink ticks on each sector
+//	before asking for the next; write ModelSectors random sectors one
+//	at a time; and fork ModelThreads threads that each read
+//	ModelReads random sectors.  Report the time each takes, and the
+//	histograms of how long each disk request took.
+//
+//	Implemented as:
+//	  ModelReader -- one thread's share of the random reads
+//	  ModelRun -- time one kind of drive
+//	  DriveModelTest -- overall control
+//----------------------------------------------------------------------
+
+#define ModelSectors	256
+#define ModelThink	2000
+#define ModelThreads	8
+#define ModelReads	25
+#define ModelCache	32
+#define ModelQueue	8
+#define ModelSeed	31
+
+static char *modelName = "MODEL";
+static SynchDisk *modelDisk;
+static Semaphore *modelDone;
+
+static void
+ModelReader(int which)
+{
+    char buffer[SectorSize];
+
+    for (int i = 0; i < ModelReads; i++)
+	modelDisk->ReadSector(Random() % modelDisk->NumSectors(), buffer);
+    modelDone->V();
+}
+
+static void
+ModelRun(char *what, int cacheSectors, bool readAhead, int queueDepth)
+{
+    char buffer[SectorSize];
+    int readLatency[NumLatencyBuckets], writeLatency[NumLatencyBuckets];
+    int i, j, start, ticks[4];
+    DiskModel model;
+    Thread *t;
+
+    Unlink(modelName);
+    modelDisk = new SynchDisk(&modelName, 1, Raid0, DiskFile,
+	DefaultSectorsPerTrack, DefaultNumTracks);
+    model.cacheSectors = cacheSectors;
+    model.readAhead = readAhead;
+    model.queueDepth = queueDepth;
+    modelDisk->SetModel(&model);
+    for (i = 0; i < NumLatencyBuckets; i++) {
+	readLatency[i] = stats->diskReadLatency[i];
+	writeLatency[i] = stats->diskWriteLatency[i];
+    }
+    RandomInit(ModelSeed);
+
+    start = stats->totalTicks;
+    for (i = 0; i < ModelSectors; i++)
+	modelDisk->ReadSector(i, buffer);
+    ticks[0] = stats->totalTicks - start;
+
+    modelDisk->FlushCache();
+    start = stats->totalTicks;
+    for (i = 0; i < ModelSectors; i++) {
+	modelDisk->ReadSector(ModelSectors + i, buffer);
+	for (j = 0; j < ModelThink / SystemTick; j++)
+	    interrupt->OneTick();
+    }
+    ticks[1] = stats->totalTicks - start;
+
+    start = stats->totalTicks;
+    for (i = 0; i < ModelSectors; i++)
+	modelDisk->WriteSector(Random() % modelDisk->NumSectors(), buffer);
+    ticks[2] = stats->totalTicks - start;
+
+    modelDisk->FlushCache();
+    start = stats->totalTicks;
+    for (i = 0; i < ModelThreads; i++) {
+	t = new Thread("model reader");
+	t->Fork(ModelReader, (void *) i);
+    }
+    for (i = 0; i < ModelThreads; i++)
+	modelDone->P();
+    ticks[3] = stats->totalTicks - start;
+
+    printf("%-11s sequential %6d, with think %7d, writes %7d, "
+	   "random %7d\n", what, ticks[0], ticks[1], ticks[2], ticks[3]);
+    for (i = 0; i < NumLatencyBuckets; i++) {
+	readLatency[i] = stats->diskReadLatency[i] - readLatency[i];
+	writeLatency[i] = stats->diskWriteLatency[i] - writeLatency[i];
+    }
+    printf("    ");
+    stats->PrintLatency("read", readLatency);
+    printf("    ");
+    stats->PrintLatency("write", writeLatency);
+
+    delete modelDisk;
+    Unlink(modelName);
+}
+
+void
+DriveModelTest()
+{
+    printf("Starting drive model test: %d sectors, %d threads x %d "
+	   "reads; times in ticks\n", ModelSectors, ModelThreads,
+	ModelReads);
+    modelDone = new Semaphore("drive model test", 0);
+    ModelRun("plain", 0, FALSE, 1);
+    ModelRun("write cache", ModelCache, FALSE, 1);
+    ModelRun("read-ahead", 0, TRUE, 1);
+    ModelRun("queueing", 0, FALSE, ModelQueue);
+    ModelRun("all three", ModelCache, TRUE, ModelQueue);
+    delete modelDone;
+}
@@ -0,0 +1,139 @@
+// fstool.cc 
+//	A program to prepare and check Nachos disks from UNIX, without
+//	simulating the disk.  It is built from the same file system
+//	code as Nachos, but with imagedisk.cc in place of synchdisk.cc,
+//	so the disk image is mapped into memory and every sector is read
+//	or written with a copy, rather than waiting on the simulated disk.
+//
+// Usage: fstool -d <debugflags> -disk <unix file>
+//		-geom <sectors per track> <tracks> -f
+//		-import <unix directory> <nachos directory>
+//		-check -l -D -frag -defrag
+//
+//    -disk names the disk image (default DISK); it is created if
+//	it doesn't exist
+//    -geom gives the geometry of a new disk image (default 32 tracks
+//	of 32 sectors)
+//    -f formats the disk
+//    -import copies every file and directory under the UNIX directory
+//	into the Nachos directory, which must exist ("/" always does)
+//    -check checks that the file system is consistent; fstool exits
+//	with status 1 if it is not
+//    -l lists the files on the disk
+//    -D prints the contents of the entire file system
+//    -frag reports how fragmented the files and the free space are
+//    -defrag moves each fragmented file into one run of sectors
+//
+//  The flags are done in order, so for example
+//	fstool -disk DISK -f -import data / -check
+//  makes a new disk holding the files under "data", and checks it.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#define MAIN
+#include "copyright.h"
+#undef MAIN
+
+#include "utility.h"
+#include "system.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+extern void Copy(char *unixFile, char *nachosFile);
+
+//----------------------------------------------------------------------
+// Import
+// 	Copy the UNIX directory tree "from" into the Nachos directory
+//	"to", making a Nachos directory for each UNIX one.  Anything
+//	that is neither a file nor a directory is skipped.
+//----------------------------------------------------------------------
+
+static void
+Import(char *from, char *to)
+{
+    DIR *dir;
+    struct dirent *entry;
+    struct stat info;
+    char *unixPath, *nachosPath;
+
+    if ((dir = opendir(from)) == NULL) {
+	printf("Import: couldn't open directory %s\n", from);
+	return;
+    }
+    while ((entry = readdir(dir)) != NULL) {
+	if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+	    continue;
+	unixPath = new char[strlen(from) + strlen(entry->d_name) + 2];
+	sprintf(unixPath, "%s/%s", from, entry->d_name);
+	nachosPath = new char[strlen(to) + strlen(entry->d_name) + 2];
+	if (!strcmp(to, "/"))
+	    sprintf(nachosPath, "/%s", entry->d_name);
+	else
+	    sprintf(nachosPath, "%s/%s", to, entry->d_name);
+
+	if (stat(unixPath, &info) == 0 && S_ISDIR(info.st_mode)) {
+	    if (fileSystem->Mkdir(nachosPath))
+		Import(unixPath, nachosPath);
+	    else
+		printf("Import: couldn't create directory %s\n", nachosPath);
+	} else if (stat(unixPath, &info) == 0 && S_ISREG(info.st_mode))
+	    Copy(unixPath, nachosPath);
+	delete [] unixPath;
+	delete [] nachosPath;
+    }
+    closedir(dir);
+}
+
+//----------------------------------------------------------------------
+// main
+// 	Map the disk, mount the file system (redoing whatever is left in
+//	the journal), and carry out the flags in order.  Then write
+//	everything back to the image.
+//----------------------------------------------------------------------
+
+int
+main(int argc, char **argv)
+{
+    int argCount;
+    bool ok = TRUE;
+
+    (void) Initialize(argc, argv);	// does -d, -disk, -geom and -f
+
+    for (argc--, argv++; argc > 0; argc -= argCount, argv += argCount) {
+	argCount = 1;
+	if (!strcmp(*argv, "-d") || !strcmp(*argv, "-disk")) {
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-geom")) {
+	    argCount = 3;
+	} else if (!strcmp(*argv, "-import")) {
+	    ASSERT(argc > 2);
+	    Import(*(argv + 1), *(argv + 2));
+	    argCount = 3;
+	} else if (!strcmp(*argv, "-check")) {
+	    journal->Sync();
+	    if (fileSystem->Check())
+		printf("File system is consistent\n");
+	    else
+		ok = FALSE;
+	} else if (!strcmp(*argv, "-l")) {
+	    fileSystem->List();
+	} else if (!strcmp(*argv, "-D")) {
+	    fileSystem->Print();
+	} else if (!strcmp(*argv, "-frag")) {
+	    fileSystem->PrintLayout();
+	} else if (!strcmp(*argv, "-defrag")) {
+	    fileSystem->Defragment();
+	}
+    }
+
+    journal->Sync();
+    delete fileSystem;
+    delete journal;
+    delete fileHeaderTable;
+    delete synchDisk;			// writes the image back
+    Exit(ok ? 0 : 1);
+    return 0;				// Not reached...
+}
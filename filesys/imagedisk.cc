@@ -0,0 +1,171 @@
+// imagedisk.cc
+//	Another implementation of SynchDisk, for fstool: rather than
+//	going through the simulated Disk, with its interrupts and its
+//	seek and rotational delays, the UNIX file holding the disk is
+//	mapped straight into memory, and reading or writing a sector is
+//	just a copy.  Every request is done by the time it returns, so
+//	there is no queue, and no cache is needed.
+//
+//	Link this in place of synchdisk.cc.  It keeps its state here,
+//	rather than in the SynchDisk, so there can only be one, on a
+//	single disk.  A BlockDevice on the same file is still made, to
+//	create the file if need be, and to say where each sector is in
+//	it, and as a model of how long requests would take, for
+//	EstimateTime; it is never sent a request.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "synchdisk.h"
+#include "system.h"
+
+static int imageFile;			// The UNIX file holding the disk
+static char *image;			// ... mapped into memory
+static Disk *imageDisk;			// ... and its layout
+
+//----------------------------------------------------------------------
+// SectorData
+// 	Return where the contents of "sector" are in the image.
+//----------------------------------------------------------------------
+
+static char *
+SectorData(int sector)
+{
+    ASSERT((sector >= 0) && (sector < imageDisk->NumSectors()));
+    return &image[imageDisk->SectorOffset(sector)];
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::SynchDisk
+// 	Map the disk image "names[0]" into memory, first creating it,
+//	empty, with the given geometry, if it doesn't exist.  The image
+//	is always mapped, so "backing" makes no difference.  Images
+//	striped or mirrored over several files are not handled.
+//----------------------------------------------------------------------
+
+SynchDisk::SynchDisk(char** names, int count, RaidLevel level,
+		DiskBacking backing, int sectorsPerTrack, int numTracks)
+{
+    ASSERT(imageDisk == NULL && count == 1);	// only one disk
+    device = new BlockDevice(names, 1, level, NULL, 0, DiskFile,
+	sectorsPerTrack, numTracks);
+    imageDisk = device->GetDisk(0);
+    imageFile = OpenForReadWrite(names[0], TRUE);
+    image = MapFile(imageFile, imageDisk->FileSize());
+    queue = active = NULL;
+    numActive = 0;
+    trace = NULL;
+    numSubmitted = 0;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::~SynchDisk
+// 	Write the image back to the file, and unmap it.
+//----------------------------------------------------------------------
+
+SynchDisk::~SynchDisk()
+{
+    UnmapFile(image, imageDisk->FileSize());
+    Close(imageFile);
+    delete device;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ReadSector/WriteSector/ReadSectors/WriteSectors
+// 	Copy sectors out of or into the image.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::ReadSector(int sectorNumber, char* data)
+{
+    bcopy(SectorData(sectorNumber), data, SectorSize);
+    stats->numDiskReads++;
+}
+
+void
+SynchDisk::WriteSector(int sectorNumber, char* data)
+{
+    bcopy(data, SectorData(sectorNumber), SectorSize);
+    stats->numDiskWrites++;
+}
+
+void
+SynchDisk::ReadSectors(int *sectors, char **data, int count)
+{
+    for (int i = 0; i < count; i++)
+	ReadSector(sectors[i], data[i]);
+}
+
+void
+SynchDisk::WriteSectors(int *sectors, char **data, int count)
+{
+    for (int i = 0; i < count; i++)
+	WriteSector(sectors[i], data[i]);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Submit/Wait
+// 	Do the request right away; Wait only has to free it.
+//----------------------------------------------------------------------
+
+DiskRequest *
+SynchDisk::Submit(int *sectors, char **data, int count, bool writing)
+{
+    DiskRequest *request = new DiskRequest;
+
+    if (writing)
+	WriteSectors(sectors, data, count);
+    else
+	ReadSectors(sectors, data, count);
+    request->sectors = sectors;
+    request->data = data;
+    request->count = count;
+    request->writing = writing;
+    request->done = NULL;
+    request->prefetch = FALSE;
+    request->number = numSubmitted++;
+    request->arrived = stats->totalTicks;
+    request->next = NULL;
+    return request;
+}
+
+void
+SynchDisk::Wait(DiskRequest *request)
+{
+    delete request;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::SetPolicy/SetModel/Prefetch/FlushCache/RequestDone
+// 	With no queue, no cache, and no interrupts, there is nothing
+//	for these to do.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::SetPolicy(DiskPolicy newPolicy)
+{
+    policy = newPolicy;
+}
+
+void
+SynchDisk::SetModel(DiskModel *model)
+{
+}
+
+void
+SynchDisk::Prefetch(int *sectors, int count)
+{
+}
+
+void
+SynchDisk::FlushCache()
+{
+}
+
+void
+SynchDisk::RequestDone()
+{
+    ASSERT(FALSE);
+}
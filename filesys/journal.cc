@@ -0,0 +1,696 @@
+// journal.cc
+//	Routines to log changes to the file system metadata, so that
+//	after a crash, each group of changes is either all on disk or
+//	not there at all.
+//
+//	The log is written before anything else: a transaction is
+//	committed by writing all of its sectors to the log, together with
+//	descriptors saying where each one belongs.  Only at a checkpoint
+//	are the sectors written to their home locations, and only then is
+//	the log emptied, by advancing the sequence number in its header.
+//	If Nachos stops at any point, mounting the disk again redoes every
+//	complete transaction in the log, and ignores the rest.
+//
+//	Committing is cheap: the log is one contiguous file, so all of a
+//	transaction goes to the disk as a single request, and a sector
+//	changed by many operations (say, the bitmap of free sectors) is
+//	logged only once per transaction, and written home only once per
+//	checkpoint.  Operations from every thread are grouped into one
+//	transaction per commit interval, and a transaction is committed
+//	once the interval is up, whether or not another operation comes
+//	along to do it.
+//
+//	File data is not logged.  It goes straight to the disk, except
+//	when it lands on a sector whose old life as metadata is still in
+//	the journal; if we wrote that sector directly, a crash could leave
+//	the data where the log says metadata should be.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "journal.h"
+#include "filehdr.h"
+#include "system.h"
+
+#include <strings.h>
+
+//----------------------------------------------------------------------
+// Checksum
+// 	Compute a checksum (FNV-1a) over "count" logged sectors: both
+//	their home sector numbers and their contents.
+//----------------------------------------------------------------------
+
+static unsigned int
+Checksum(int *sectors, char **data, int count)
+{
+    unsigned int hash = 2166136261u;
+    int i, j;
+
+    for (i = 0; i < count; i++) {
+	hash = (hash ^ (unsigned int) sectors[i]) * 16777619;
+	for (j = 0; j < SectorSize; j++)
+	    hash = (hash ^ (unsigned char) data[i][j]) * 16777619;
+    }
+    return hash;
+}
+
+// Dummy functions because C++ is weird about pointers to member functions
+static void JournalDeadline(int arg)
+{ Journal *j = (Journal *)arg; j->DeadlinePassed(); }
+static void JournalCommitter(int arg)
+{ Journal *j = (Journal *)arg; j->CommitWhenDue(); }
+
+//----------------------------------------------------------------------
+// JournalBlocks::JournalBlocks
+// 	Initialize an empty set of sectors.  The arrays grow as needed.
+//----------------------------------------------------------------------
+
+JournalBlocks::JournalBlocks()
+{
+    count = 0;
+    size = 0;
+    sectors = NULL;
+    data = NULL;
+}
+
+JournalBlocks::~JournalBlocks()
+{
+    delete [] sectors;
+    delete [] data;
+}
+
+//----------------------------------------------------------------------
+// JournalBlocks::Find
+// 	Return the contents we have for "sector", or NULL if it is not
+//	in the set.
+//----------------------------------------------------------------------
+
+char *
+JournalBlocks::Find(int sector)
+{
+    for (int i = 0; i < count; i++)
+	if (sectors[i] == sector)
+	    return &data[i * SectorSize];
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// JournalBlocks::Put
+// 	Record that "sector" should contain "contents", replacing what
+//	we had for it before, if anything.
+//----------------------------------------------------------------------
+
+void
+JournalBlocks::Put(int sector, char *contents)
+{
+    char *p = Find(sector);
+    int *newSectors;
+    char *newData;
+
+    if (p == NULL) {
+	if (count == size) {		// out of room; double the arrays
+	    size = (size == 0) ? JournalMinSectors / 4 : 2 * size;
+	    newSectors = new int[size];
+	    newData = new char[size * SectorSize];
+	    if (count > 0) {
+		bcopy(sectors, newSectors, count * sizeof(int));
+		bcopy(data, newData, count * SectorSize);
+	    }
+	    delete [] sectors;
+	    delete [] data;
+	    sectors = newSectors;
+	    data = newData;
+	}
+	sectors[count] = sector;
+	p = &data[count++ * SectorSize];
+    }
+    bcopy(contents, p, SectorSize);
+}
+
+void
+JournalBlocks::Clear()
+{
+    count = 0;
+}
+
+//----------------------------------------------------------------------
+// Journal::Journal
+// 	Initialize the journal.  Until Open is called, it just passes
+//	reads and writes through to the disk.
+//----------------------------------------------------------------------
+
+Journal::Journal()
+{
+    active = FALSE;
+    numLogSectors = 0;
+    logSectors = NULL;
+    logEnd = 1;
+    nextSeq = 1;
+    depth = numOps = 0;
+    txn = new JournalBlocks;
+    logged = new JournalBlocks;
+    commitInterval = JournalCommitInterval;
+    txnStart = 0;
+    commitPending = FALSE;
+    beginReady = new Semaphore("journal begin", 0);
+    beginWaiters = 0;
+    opsDrained = new Semaphore("journal drained", 0);
+    syncWaiting = FALSE;
+    commitMutex = new Semaphore("journal commit", 1);
+    deadlinePending = FALSE;
+    deadline = new Semaphore("journal deadline", 0);
+    committerStarted = FALSE;
+}
+
+Journal::~Journal()
+{
+    Close();
+    delete txn;
+    delete logged;
+    delete beginReady;
+    delete opsDrained;
+    delete commitMutex;
+    delete deadline;
+    delete [] logSectors;
+}
+
+//----------------------------------------------------------------------
+// Journal::Open
+// 	Start logging metadata changes, in the file whose header is at
+//	"hdrSector".  If "format", the log is new, and we just mark it
+//	empty.  Otherwise the disk may have been left by a crash, so
+//	first redo every committed transaction still in the log.
+//
+//	Anything we had in memory from before is forgotten; after a
+//	crash, it never made it to disk.
+//----------------------------------------------------------------------
+
+void
+Journal::Open(int hdrSector, bool format)
+{
+    FileHeader *hdr = new FileHeader;
+
+    ASSERT(!active);
+    hdr->FetchFrom(hdrSector);
+    numLogSectors = hdr->FileLength() / SectorSize;
+    ASSERT(numLogSectors >= JournalMinSectors);
+    delete [] logSectors;
+    logSectors = new int[numLogSectors];
+    for (int i = 0; i < numLogSectors; i++)
+	logSectors[i] = hdr->ByteToSector(i * SectorSize);
+    delete hdr;
+
+    txn->Clear();
+    logged->Clear();
+    depth = numOps = 0;
+    commitPending = FALSE;
+    txnStart = stats->totalTicks;
+    logEnd = 1;
+    if (format) {
+	nextSeq = 1;
+	WriteHeader();
+    } else
+	Replay();
+    active = TRUE;
+    if (!committerStarted) {
+	committerStarted = TRUE;
+	(new Thread("journal committer"))->Fork(JournalCommitter, (int) this);
+    }
+}
+
+//----------------------------------------------------------------------
+// Journal::Close
+// 	Get everything in the journal to its home on disk, and go back
+//	to passing reads and writes straight through.
+//----------------------------------------------------------------------
+
+void
+Journal::Close()
+{
+    if (!active)
+	return;
+    Sync();
+    active = FALSE;
+}
+
+//----------------------------------------------------------------------
+// Journal::Begin/End
+// 	Bracket one file system operation, so that it is never split
+//	between transactions.  Operations may be running in several
+//	threads at once; "depth" counts them.
+//
+//	Once the transaction is old enough, or big enough, an ending
+//	operation marks it due to commit.  From then on new operations
+//	wait in Begin, and the last running operation to End does the
+//	commit (or wakes up Sync, if it is waiting to).  Until the commit,
+//	the operations in the transaction could still be lost in a crash
+//	-- but never only some of them.
+//
+//	The first operation of a transaction also sets a deadline, for
+//	when the transaction is old enough.  If no operation has ended
+//	by then, CommitWhenDue commits it instead.
+//----------------------------------------------------------------------
+
+void
+Journal::Begin()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    while (commitPending) {			// wait for the commit
+	beginWaiters++;
+	beginReady->P();
+    }
+    if (depth == 0 && numOps == 0) {		// first in the transaction
+	txnStart = stats->totalTicks;
+	ScheduleDeadline(commitInterval);
+    }
+    depth++;
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+void
+Journal::End()
+{
+    ASSERT(depth > 0);
+    depth--;
+    numOps++;
+    if (txn->count >= JournalCommitSectors(numLogSectors)
+		|| stats->totalTicks - txnStart >= commitInterval)
+	commitPending = TRUE;
+    if (depth == 0 && commitPending) {
+	if (syncWaiting)
+	    opsDrained->V();
+	else
+	    Commit();
+    }
+}
+
+//----------------------------------------------------------------------
+// Journal::SetCommitInterval
+// 	Commit the current transaction once it is "ticks" old.  An
+//	interval of 0 commits after every operation.
+//----------------------------------------------------------------------
+
+void
+Journal::SetCommitInterval(int ticks)
+{
+    commitInterval = ticks;
+}
+
+//----------------------------------------------------------------------
+// Journal::ScheduleDeadline
+// 	Arrange for CommitWhenDue to look at the current transaction in
+//	"ticks" ticks, unless it is going to already.  With an interval
+//	of 0, every operation commits itself, so there is no need.
+//	Called with interrupts off.
+//----------------------------------------------------------------------
+
+void
+Journal::ScheduleDeadline(int ticks)
+{
+    if (deadlinePending || ticks <= 0)
+	return;
+    interrupt->Schedule(JournalDeadline, (int) this, ticks, DiskInt);
+    deadlinePending = TRUE;		// not TimerInt: Idle ignores those
+}
+
+//----------------------------------------------------------------------
+// Journal::DeadlinePassed
+// 	Interrupt handler: the deadline set by ScheduleDeadline is here.
+//	Committing means waiting for the disk, which an interrupt handler
+//	can't do, so wake up CommitWhenDue to do it.
+//----------------------------------------------------------------------
+
+void
+Journal::DeadlinePassed()
+{
+    deadlinePending = FALSE;
+    deadline->V();
+}
+
+//----------------------------------------------------------------------
+// Journal::CommitWhenDue
+// 	A thread of its own, which commits a transaction that is old
+//	enough, if no operation has ended since to commit it.  If
+//	operations are still running, it holds off new ones, and the
+//	last of them to End commits.  If the transaction it woke up for
+//	has been committed already, and a newer one started, it checks
+//	again once that one is due.
+//----------------------------------------------------------------------
+
+void
+Journal::CommitWhenDue()
+{
+    IntStatus oldLevel;
+    int age;
+
+    for (;;) {
+	deadline->P();
+	oldLevel = interrupt->SetLevel(IntOff);
+	age = stats->totalTicks - txnStart;
+	if (!active || commitPending || (depth == 0 && numOps == 0)) {
+	    // nothing to commit, or someone is committing it
+	} else if (age < commitInterval) {
+	    ScheduleDeadline(commitInterval - age);	// a newer one
+	} else {
+	    commitPending = TRUE;		// hold off new operations
+	    if (depth == 0) {
+		(void) interrupt->SetLevel(oldLevel);
+		DEBUG('f', "Transaction is %d ticks old; committing\n", age);
+		Commit();
+		continue;
+	    }
+	}
+	(void) interrupt->SetLevel(oldLevel);
+    }
+}
+
+//----------------------------------------------------------------------
+// Journal::Sync
+// 	Commit the current transaction, and write everything in the log
+//	back home, so that the disk is up to date without the log.  If
+//	operations are running, wait for them to finish first.
+//----------------------------------------------------------------------
+
+void
+Journal::Sync()
+{
+    commitPending = TRUE;
+    if (depth > 0) {
+	syncWaiting = TRUE;
+	opsDrained->P();
+	syncWaiting = FALSE;
+    }
+    Commit();
+    commitMutex->P();
+    if (logged->count > 0 || logEnd > 1)	// unless the log is empty
+	Checkpoint();
+    commitMutex->V();
+}
+
+//----------------------------------------------------------------------
+// Journal::Commit
+// 	Write the current transaction to the log, as one disk request.
+//	It is split into chunks of at most DescriptorEntries sectors,
+//	each behind its own descriptor.  If the log doesn't have room,
+//	checkpoint first, to empty it.
+//
+//	Once the transaction is laid out, its sectors move into the set
+//	waiting for the next checkpoint, and a new transaction starts.
+//	Operations waiting in Begin go ahead into the new transaction
+//	while we wait for the disk.
+//
+//	Only called when no operations are running.  One commit (or
+//	checkpoint) at a time: if the previous commit is still writing
+//	the log, wait for it.
+//----------------------------------------------------------------------
+
+void
+Journal::Commit()
+{
+    int numChunks, need, chunk, i, j, n;
+    int *where = NULL;
+    char *records = NULL, **bufs = NULL;
+    JournalDescriptor *d;
+    IntStatus oldLevel;
+
+    ASSERT(depth == 0);
+    commitPending = TRUE;		// hold off new operations
+    commitMutex->P();
+    need = txn->count + divRoundUp(txn->count, DescriptorEntries);
+    ASSERT(need < numLogSectors);
+    if (logEnd + need > numLogSectors)
+	Checkpoint();
+
+    oldLevel = interrupt->SetLevel(IntOff);	// lay it out all at once
+    numChunks = divRoundUp(txn->count, DescriptorEntries);
+    need = txn->count + numChunks;
+    ASSERT(logEnd + need <= numLogSectors);
+    if (need > 0) {
+	records = new char[need * SectorSize];
+	where = new int[need];
+	bufs = new char *[need];
+    }
+    for (i = 0; i < need; i++) {
+	where[i] = logSectors[logEnd + i];
+	bufs[i] = &records[i * SectorSize];
+    }
+    for (chunk = 0, i = 0, j = 0; chunk < numChunks; chunk++) {
+	n = min(DescriptorEntries, txn->count - i);
+	d = (JournalDescriptor *) bufs[j];
+	bzero((char *) d, SectorSize);
+	d->magic = JournalMagic;
+	d->seq = nextSeq;
+	d->count = n;
+	d->last = (chunk == numChunks - 1);
+	bcopy(&txn->sectors[i], d->sectors, n * sizeof(int));
+	bcopy(&txn->data[i * SectorSize], bufs[j + 1], n * SectorSize);
+	d->checksum = Checksum(d->sectors, &bufs[j + 1], n);
+	i += n;
+	j += n + 1;
+    }
+    for (i = 0; i < txn->count; i++)
+	logged->Put(txn->sectors[i], &txn->data[i * SectorSize]);
+    if (need > 0) {
+	DEBUG('f', "Committing transaction %d: %d sectors, %d operations\n",
+	    nextSeq, txn->count, numOps);
+	stats->numJournalCommits++;
+	stats->numJournalSectors += txn->count;
+	logEnd += need;
+	nextSeq++;
+    }
+    txn->Clear();
+    numOps = 0;
+    commitPending = FALSE;		// let waiting operations go
+    while (beginWaiters > 0) {
+	beginWaiters--;
+	beginReady->V();
+    }
+    (void) interrupt->SetLevel(oldLevel);
+
+    if (need > 0) {
+	synchDisk->WriteSectors(where, bufs, need);
+	delete [] records;
+	delete [] where;
+	delete [] bufs;
+    }
+    commitMutex->V();
+}
+
+//----------------------------------------------------------------------
+// Journal::Checkpoint
+// 	Write every committed sector back to its home, as one request,
+//	and then empty the log.  The sectors only leave memory once they
+//	are on disk; a crash before the log is emptied just means they
+//	are written home again at the next mount.
+//----------------------------------------------------------------------
+
+void
+Journal::Checkpoint()
+{
+    char **bufs;
+
+    if (logged->count > 0) {
+	DEBUG('f', "Checkpointing %d sectors\n", logged->count);
+	bufs = new char *[logged->count];
+	for (int i = 0; i < logged->count; i++)
+	    bufs[i] = &logged->data[i * SectorSize];
+	synchDisk->WriteSectors(logged->sectors, bufs, logged->count);
+	delete [] bufs;
+	stats->numCheckpoints++;
+    }
+    WriteHeader();
+    logged->Clear();
+    logEnd = 1;
+}
+
+//----------------------------------------------------------------------
+// Journal::WriteHeader
+// 	Empty the log: the next transaction to be redone is nextSeq, and
+//	it starts right after the header.  Older transactions still in
+//	the log are ignored, because their sequence numbers are too small.
+//----------------------------------------------------------------------
+
+void
+Journal::WriteHeader()
+{
+    int header[SectorSize / sizeof(int)];
+
+    bzero((char *) header, SectorSize);
+    header[0] = JournalMagic;
+    header[1] = nextSeq;
+    synchDisk->WriteSector(logSectors[0], (char *) header);
+}
+
+//----------------------------------------------------------------------
+// Journal::Replay
+// 	Redo the transactions in the log, in order, starting with the
+//	sequence number in the header.  Stop at the first chunk that is
+//	missing, out of sequence, or fails its checksum; a transaction
+//	whose chunks didn't all make it to the log is thrown away.
+//	Then write the redone sectors home, and empty the log.
+//----------------------------------------------------------------------
+
+void
+Journal::Replay()
+{
+    int header[SectorSize / sizeof(int)];
+    JournalDescriptor *d = new JournalDescriptor;
+    JournalBlocks *pending = new JournalBlocks;
+    char *chunk = new char[DescriptorEntries * SectorSize];
+    char *bufs[DescriptorEntries];
+    int pos = 1, seq, i;
+
+    synchDisk->ReadSector(logSectors[0], (char *) header);
+    ASSERT(header[0] == JournalMagic);	// else the disk needs formatting
+    seq = header[1];
+    for (i = 0; i < DescriptorEntries; i++)
+	bufs[i] = &chunk[i * SectorSize];
+
+    while (pos < numLogSectors) {
+	synchDisk->ReadSector(logSectors[pos], (char *) d);
+	if (d->magic != JournalMagic || d->seq != seq || d->count <= 0
+		|| d->count > DescriptorEntries
+		|| pos + 1 + d->count > numLogSectors)
+	    break;
+	synchDisk->ReadSectors(&logSectors[pos + 1], bufs, d->count);
+	if (Checksum(d->sectors, bufs, d->count) != d->checksum)
+	    break;
+	for (i = 0; i < d->count; i++)
+	    pending->Put(d->sectors[i], bufs[i]);
+	pos += 1 + d->count;
+	if (d->last) {				// transaction is complete
+	    DEBUG('f', "Redoing transaction %d: %d sectors\n", seq,
+		pending->count);
+	    for (i = 0; i < pending->count; i++)
+		logged->Put(pending->sectors[i],
+				&pending->data[i * SectorSize]);
+	    pending->Clear();
+	    stats->numJournalReplays++;
+	    seq++;
+	}
+    }
+
+    // Skip a sequence number, in case a chunk of the transaction the
+    // crash cut short is still lying around in the log.
+    nextSeq = seq + 1;
+    Checkpoint();			// even with nothing redone: the
+					// header has to say nextSeq
+    delete d;
+    delete pending;
+    delete [] chunk;
+}
+
+//----------------------------------------------------------------------
+// Journal::Find
+// 	Return the latest contents of "sector", if the journal has them
+//	-- the current transaction first, then what is waiting for the
+//	next checkpoint.  Return NULL if the disk is up to date.
+//----------------------------------------------------------------------
+
+char *
+Journal::Find(int sector)
+{
+    char *p = txn->Find(sector);
+
+    if (p == NULL)
+	p = logged->Find(sector);
+    return p;
+}
+
+//----------------------------------------------------------------------
+// Journal::ReadSectors
+// 	Read "count" sectors, seeing the changes in the journal that
+//	have not been written home yet.  Sectors the journal has are
+//	copied from memory; if any others are wanted, read the lot as
+//	one request and then patch in the journal's copies.
+//----------------------------------------------------------------------
+
+void
+Journal::ReadSectors(int *sectors, char **data, int count)
+{
+    int i, missing = 0;
+
+    if (!active || (txn->count == 0 && logged->count == 0)) {
+	synchDisk->ReadSectors(sectors, data, count);
+	return;
+    }
+    for (i = 0; i < count; i++)
+	if (Find(sectors[i]) == NULL)
+	    missing++;
+    if (missing > 0)
+	synchDisk->ReadSectors(sectors, data, count);
+    if (missing < count)
+	for (i = 0; i < count; i++) {
+	    char *p = Find(sectors[i]);
+
+	    if (p != NULL)
+		bcopy(p, data[i], SectorSize);
+	}
+}
+
+void
+Journal::ReadSector(int sector, char *data)
+{
+    ReadSectors(&sector, &data, 1);
+}
+
+//----------------------------------------------------------------------
+// Journal::WriteSectors
+// 	Write "count" sectors.  Metadata goes into the current
+//	transaction.  File data goes straight to the disk, as one
+//	request, except for any sectors still in the journal as
+//	metadata; those have to join the transaction, so that the log
+//	never overwrites them after the data.
+//
+//	"metadata" -- do these sectors belong to a file header, a
+//		directory or the bitmap?
+//----------------------------------------------------------------------
+
+void
+Journal::WriteSectors(int *sectors, char **data, int count, bool metadata)
+{
+    int i, held = 0, numDirect = 0;
+    int *directSectors;
+    char **directData;
+
+    if (!active) {
+	synchDisk->WriteSectors(sectors, data, count);
+	return;
+    }
+    if (!metadata)
+	for (i = 0; i < count; i++)
+	    if (Find(sectors[i]) != NULL)
+		held++;
+    if (!metadata && held == 0) {
+	synchDisk->WriteSectors(sectors, data, count);
+	return;
+    }
+    if (metadata) {
+	for (i = 0; i < count; i++)
+	    txn->Put(sectors[i], data[i]);
+	return;
+    }
+    directSectors = new int[count - held];	// the rest, as one request
+    directData = new char *[count - held];
+    for (i = 0; i < count; i++) {
+	if (Find(sectors[i]) != NULL)
+	    txn->Put(sectors[i], data[i]);
+	else {
+	    directSectors[numDirect] = sectors[i];
+	    directData[numDirect++] = data[i];
+	}
+    }
+    if (numDirect > 0)
+	synchDisk->WriteSectors(directSectors, directData, numDirect);
+    delete [] directSectors;
+    delete [] directData;
+}
+
+void
+Journal::WriteSector(int sector, char *data)
+{
+    WriteSectors(&sector, &data, 1, TRUE);
+}
@@ -0,0 +1,197 @@
+// journal.h
+//	Data structures for a write-ahead journal of file system metadata.
+//
+//	Creating or removing a file changes several sectors -- the file
+//	header, the directory, the bitmap of free sectors -- and if Nachos
+//	stops part way through writing them, the disk is left in a state
+//	no one intended.  To avoid this, every change to the metadata is
+//	first written to a log on disk; only once a whole group of
+//	changes is safely in the log are they copied to where they
+//	belong.  After a crash, the changes in the log are simply copied
+//	again, so the disk always reflects either all of a group of
+//	changes or none of them.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "disk.h"
+#include "filehdr.h"
+#include "synch.h"
+
+// The log is kept in a normal Nachos file.  Its first sector is a
+// header, giving the sequence number of the first transaction in the
+// log that has not been copied to its home sectors yet; the rest of
+// the file holds transactions, one after the other.
+#define JournalMagic		0x4a524e4c	// "JRNL"
+
+// The log is sized when the disk is formatted.  One operation logs at
+// most the sectors of the bitmap it changes, and JournalOpSectors
+// others: a file header, the indirect sectors of the largest file,
+// and the headers and directory sectors around it.  Three quarters of
+// the log hold such an operation, with room for its descriptors; the
+// rest holds the transaction it joins (cf. JournalCommitSectors).
+// The log is never smaller than JournalMinSectors.
+//
+// A disk fits the file system if the log fits in a file, and takes
+// no more than half the disk.
+#define JournalMinSectors	64
+#define JournalOpSectors	(NumIndirect + 8)
+#define JournalMaxOp(numSectors) \
+	(divRoundUp(numSectors, BitsInSector) + JournalOpSectors)
+#define JournalSectorsFor(numSectors) \
+	max(JournalMinSectors, 4 * JournalMaxOp(numSectors) / 3 \
+		+ JournalMaxOp(numSectors) / 64 + 8)
+#define JournalFits(numSectors) \
+	((numSectors) > 0 && JournalSectorsFor(numSectors) <= MaxFileSectors \
+		&& 2 * JournalSectorsFor(numSectors) <= (numSectors))
+
+// A transaction is committed once it is JournalCommitInterval ticks
+// old, so that all the operations in that interval, from however many
+// threads, share one write to the log; a directory or bitmap sector
+// they all change is logged once.  That is also as long as a finished
+// operation waits to be committed: if no other operation comes along
+// to commit it, a thread of the journal's own does.  A transaction is
+// also committed once it has JournalCommitSectors sectors in it, so
+// that any one more operation will still fit in the log.
+#define JournalCommitInterval	50000
+#define JournalCommitSectors(logSectors)	((logSectors) / 4)
+
+// On disk, a transaction is a sequence of chunks, each a descriptor
+// sector listing the home sector of each of the "count" sectors that
+// follow it.  The checksum covers those sectors, so that a chunk the
+// crash only partly wrote is noticed.  The last chunk of a transaction
+// has "last" set; a transaction missing any chunk is not redone.
+#define DescriptorEntries	((int) ((SectorSize - 5 * sizeof(int)) \
+					/ sizeof(int)))
+
+class JournalDescriptor {
+  public:
+    int magic;				// JournalMagic
+    int seq;				// Transaction this chunk belongs to
+    int count;				// Sectors in the chunk
+    int last;				// Last chunk of the transaction?
+    unsigned int checksum;		// Of the sectors in the chunk
+    int sectors[DescriptorEntries];	// Home sector of each
+};
+
+// A set of disk sectors, and what they should contain.  Internal to
+// the journal; kept public so the Journal can get at it directly.
+
+class JournalBlocks {
+  public:
+    JournalBlocks();			// Initialize an empty set
+    ~JournalBlocks();
+
+    char *Find(int sector);		// Contents of "sector", or NULL
+    void Put(int sector, char *data);	// Add "sector", or replace its
+					//  contents
+    void Clear();			// Empty the set
+
+    int count;				// Sectors in the set
+    int *sectors;			// Their sector numbers
+    char *data;				// Their contents, SectorSize each
+
+  private:
+    int size;				// Room in the arrays above
+};
+
+// The following class defines the journal.  Until it is opened, it
+// passes every read and write straight through to the disk, so that
+// the file system can be formatted.
+//
+// Every operation on the file system that changes metadata is
+// bracketed by Begin and End.  Metadata written in between goes into
+// the current transaction, in memory, rather than to the disk.  Reads
+// see the latest contents of every sector, whether it is on disk, in
+// the log, or only in memory.
+//
+// Commit writes the current transaction to the log; once it is there,
+// the operations in it survive a crash.  The sectors stay in memory
+// until the log fills up, when Checkpoint writes all of them back to
+// their homes, and empties the log.
+//
+// Operations from different threads can run at once, and share a
+// transaction.  When the transaction is due to be committed, new
+// operations wait in Begin until the ones already running have
+// finished; the last of those commits, and the waiting operations go
+// on into the next transaction while the log is being written.
+//
+// We assume the caller keeps operations from interfering with each
+// other's changes to the same sectors.
+
+class Journal {
+  public:
+    Journal();				// Initialize, passing I/O through
+    ~Journal();
+
+    void Open(int hdrSector, bool format);
+					// Start logging in the file whose
+					//  header is at "hdrSector"; unless
+					//  "format", first redo any
+					//  transactions left in the log
+    void Close();			// Sync, and pass I/O through again
+
+    void Begin();			// Start a file system operation
+    void End();				// Finish it, and maybe commit
+
+    void Sync();			// Commit, and then checkpoint
+
+    void SetCommitInterval(int ticks);	// Change how often to commit
+
+    void DeadlinePassed();		// Called by the interrupt handler
+					//  when a transaction is due
+    void CommitWhenDue();		// Body of the thread that commits
+					//  transactions nobody else does
+
+    void ReadSectors(int *sectors, char **data, int count);
+    void ReadSector(int sector, char *data);
+					// Read sectors, as they would be
+					//  after all the logged changes
+    void WriteSectors(int *sectors, char **data, int count, bool metadata);
+					// Write sectors; metadata is logged,
+					//  while file data goes to the disk
+					//  (unless the sector was metadata
+					//  not yet written back)
+    void WriteSector(int sector, char *data);
+					// Write one sector of metadata
+
+  private:
+    bool active;			// Logging, or passing I/O through?
+    int numLogSectors;			// Size of the log
+    int *logSectors;			// Disk sector of each log sector
+    int logEnd;				// Next free sector in the log
+    int nextSeq;			// Sequence # of the next transaction
+    int depth;				// Operations between Begin and End
+    int numOps;				// Operations in the transaction
+    JournalBlocks *txn;			// The current transaction
+    JournalBlocks *logged;		// Committed, not yet written back
+
+    int commitInterval;			// Ticks between commits
+    int txnStart;			// When the transaction started
+    bool commitPending;			// Waiting for operations to finish,
+					//  so we can commit?
+    Semaphore *beginReady;		// Signalled when the commit has
+    int beginWaiters;			//  started; # waiting in Begin
+    Semaphore *opsDrained;		// Signalled when the last operation
+    bool syncWaiting;			//  ends, if Sync is waiting for it
+    Semaphore *commitMutex;		// One commit or checkpoint at a time
+    bool deadlinePending;		// Deadline interrupt scheduled?
+    Semaphore *deadline;		// V'ed when it goes off
+    bool committerStarted;		// CommitWhenDue thread forked yet?
+
+    char *Find(int sector);		// Latest contents of "sector",
+					//  if it isn't what's on disk
+    void Commit();			// Log the current transaction
+    void ScheduleDeadline(int ticks);	// Wake up CommitWhenDue then
+    void Checkpoint();			// Write the logged sectors home
+    void WriteHeader();			// Start the log over at nextSeq
+    void Replay();			// Redo the transactions in the log
+};
+
+#endif // JOURNAL_H
@@ -5,7 +5,8 @@
 //	the OpenFile data structure).
 //
 //	Also as in UNIX, for convenience, we keep the file header in
-//	memory while the file is open.
+//	memory while the file is open.  The header comes from the
+//	FileHeaderTable, so every OpenFile on a file shares one copy.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -22,16 +23,20 @@
 //----------------------------------------------------------------------
 // OpenFile::OpenFile
 // 	Open a Nachos file for reading and writing.  Bring the file header
-//	into memory while the file is open.
+//	into memory while the file is open (if it isn't there already).
 //
 //	"sector" -- the location on disk of the file header for this file
 //----------------------------------------------------------------------
 
 OpenFile::OpenFile(int sector)
 { 
-    hdr = new FileHeader;
-    hdr->FetchFrom(sector);
+    hdr = fileHeaderTable->Acquire(sector);
+    hdrSector = sector;
     seekPosition = 0;
+    readAheadNext = 0;
+    readAheadWindow = 0;
+    readAheadEnd = 0;
+    metadata = FALSE;
 }
 
 //----------------------------------------------------------------------
@@ -41,7 +46,7 @@ OpenFile::OpenFile(int sector)
 
 OpenFile::~OpenFile()
 {
-    delete hdr;
+    fileHeaderTable->Release(hdr);
 }
 
 //----------------------------------------------------------------------
@@ -64,7 +69,8 @@ OpenFile::Seek(int position)
 //	Return the number of bytes actually written or read, and as a
 //	side effect, increment the current position within the file.
 //
-//	Implemented using the more primitive ReadAt/WriteAt.
+//	Implemented using the more primitive ReadAt/WriteAt.  Read also
+//	starts reading ahead, if the file is being read sequentially.
 //
 //	"into" -- the buffer to contain the data to be read from disk 
 //	"from" -- the buffer containing the data to be written to disk 
@@ -75,6 +81,8 @@ int
 OpenFile::Read(char *into, int numBytes)
 {
    int result = ReadAt(into, numBytes, seekPosition);
+   if (result > 0)
+       ReadAhead(seekPosition, result);
    seekPosition += result;
    return result;
 }
@@ -87,6 +95,49 @@ OpenFile::Write(char *into, int numBytes)
    return result;
 }
 
+//----------------------------------------------------------------------
+// OpenFile::ReadAhead
+// 	Called after Read has returned "numBytes" bytes from "position".
+//	If this Read picked up where the last one left off, the file is
+//	being read sequentially, so ask the disk to start reading the
+//	next sectors of the file into its cache before we need them.
+//
+//	We keep the read-ahead at least half a window in front of the
+//	reader, and double the window each time we extend it.  A Read
+//	anywhere else turns read-ahead off until the pattern starts again.
+//----------------------------------------------------------------------
+
+void
+OpenFile::ReadAhead(int position, int numBytes)
+{
+    int sectors[MaxReadAhead];
+    int current = divRoundDown(position + numBytes - 1, SectorSize);
+    int numFileSectors = divRoundUp(hdr->FileLength(), SectorSize);
+    int first, last, i;
+
+    if (position != readAheadNext) {		// random access
+	readAheadWindow = 0;
+	readAheadEnd = current + 1;
+    } else if (readAheadWindow == 0)		// sequential again
+	readAheadWindow = MinReadAhead;
+    readAheadNext = position + numBytes;
+
+    if (readAheadWindow == 0
+		|| readAheadEnd - current > readAheadWindow / 2)
+	return;					// nothing to do yet
+    first = max(readAheadEnd, current + 1);
+    last = min(current + readAheadWindow, numFileSectors - 1);
+    if (first > last)
+	return;					// at end of file
+    hdr->Lock()->AcquireShared();
+    for (i = first; i <= last; i++)
+	sectors[i - first] = hdr->ByteToSector(i * SectorSize);
+    hdr->Lock()->ReleaseShared();
+    synchDisk->Prefetch(sectors, last - first + 1);
+    readAheadEnd = last + 1;
+    readAheadWindow = min(2 * readAheadWindow, MaxReadAhead);
+}
+
 //----------------------------------------------------------------------
 // OpenFile::ReadAt/WriteAt
 // 	Read/write a portion of a file, starting at "position".
@@ -106,6 +157,26 @@ OpenFile::Write(char *into, int numBytes)
 //	   in the data that will be modified, and write back all the full
 //	   or partial sectors that are part of the request.
 //
+//	Either way, the sectors go to the disk in scatter/gather requests,
+//	so that sectors laid out next to each other on disk are streamed
+//	rather than paying a full disk latency each.  Sectors the request
+//	covers completely are transferred directly to or from the caller's
+//	buffer; only a partial first or last sector is staged, through
+//	sector buffers on the stack, so no buffer is allocated per call.
+//	(Not through buffers in the OpenFile: with the header only held
+//	shared, two threads could be using the same OpenFile at once.)
+//
+//	The file header is held shared throughout, so that other threads
+//	can read the file, and write whole sectors of it, at the same
+//	time, but it can't grow under us.  A WriteAt that changes only
+//	part of a sector holds the header exclusive instead: otherwise
+//	two threads changing different bytes of the same sector could
+//	both read it, and the second to write it back would undo the
+//	first one's change.
+//
+//	The data of an inline file is in the header itself, so there is
+//	no disk I/O to read it; writing it is left to WriteInline.
+//
 //	"into" -- the buffer to contain the data to be read from disk 
 //	"from" -- the buffer containing the data to be written to disk 
 //	"numBytes" -- the number of bytes to transfer
@@ -116,75 +187,238 @@ OpenFile::Write(char *into, int numBytes)
 int
 OpenFile::ReadAt(char *into, int numBytes, int position)
 {
-    int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    char *buf;
+    int fileLength;
+    int offset, count;
+    bool firstPartial, lastPartial;
+    char firstBuf[SectorSize], lastBuf[SectorSize];
 
-    if ((numBytes <= 0) || (position >= fileLength))
+    hdr->Lock()->AcquireShared();
+    fileLength = hdr->FileLength();
+    if ((numBytes <= 0) || (position >= fileLength)) {
+	hdr->Lock()->ReleaseShared();
     	return 0; 				// check request
+    }
     if ((position + numBytes) > fileLength)		
 	numBytes = fileLength - position;
     DEBUG('f', "Reading %d bytes at %d, from file of length %d.\n", 	
 			numBytes, position, fileLength);
 
-    firstSector = divRoundDown(position, SectorSize);
-    lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
+    if (hdr->IsInline()) {
+	bcopy(&hdr->InlineData()[position], into, numBytes);
+	hdr->Lock()->ReleaseShared();
+	return numBytes;
+    }
+    firstPartial = (position % SectorSize != 0) || (numBytes < SectorSize);
+    lastPartial = ((position + numBytes) % SectorSize != 0)
+		&& (divRoundDown(position, SectorSize)
+			!= divRoundDown(position + numBytes - 1, SectorSize));
 
-    // read in all the full and partial sectors that we need
-    buf = new char[numSectors * SectorSize];
-    for (i = firstSector; i <= lastSector; i++)	
-        synchDisk->ReadSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
+// read full sectors straight into "into", partial ones into our buffers
+    TransferSectors(into, numBytes, position, firstPartial ? firstBuf : NULL,
+					lastPartial ? lastBuf : NULL, FALSE);
 
-    // copy the part we want
-    bcopy(&buf[position - (firstSector * SectorSize)], into, numBytes);
-    delete [] buf;
+// copy the part we want out of the partial sectors
+    if (firstPartial) {
+	offset = position % SectorSize;
+	count = min(numBytes, SectorSize - offset);
+	bcopy(&firstBuf[offset], into, count);
+    }
+    if (lastPartial) {
+	count = (position + numBytes) % SectorSize;
+	bcopy(lastBuf, &into[numBytes - count], count);
+    }
+    hdr->Lock()->ReleaseShared();
     return numBytes;
 }
 
 int
 OpenFile::WriteAt(char *from, int numBytes, int position)
 {
-    int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    bool firstAligned, lastAligned;
-    char *buf;
+    int fileLength;
+    int firstSector, lastSector, offset, count, numPartial = 0;
+    int sectors[2];
+    char *bufs[2];
+    bool firstPartial, lastPartial;
+    char firstBuf[SectorSize], lastBuf[SectorSize];
+    bool exclusive = (position % SectorSize != 0)
+			|| ((position + numBytes) % SectorSize != 0);
 
-    if ((numBytes <= 0) || (position >= fileLength))
-	return 0;				// check request
-    if ((position + numBytes) > fileLength)
-	numBytes = fileLength - position;
+    for (;;) {
+	LockHeader(exclusive);
+	fileLength = hdr->FileLength();
+	if ((numBytes <= 0) || (position >= fileLength)) {
+	    UnlockHeader(exclusive);
+	    return 0;				// check request
+	}
+	if (hdr->IsInline()) {			// rechecked, under the lock
+	    UnlockHeader(exclusive);
+	    return WriteInline(from, numBytes, position);
+	}
+	if ((position + numBytes) > fileLength)
+	    numBytes = fileLength - position;
+	if (exclusive || (position + numBytes) % SectorSize == 0)
+	    break;
+	UnlockHeader(exclusive);		// now ends part way through a
+	exclusive = TRUE;			//  sector; start over
+    }
     DEBUG('f', "Writing %d bytes at %d, from file of length %d.\n", 	
 			numBytes, position, fileLength);
 
     firstSector = divRoundDown(position, SectorSize);
     lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
+    firstPartial = (position % SectorSize != 0) || (numBytes < SectorSize);
+    lastPartial = ((position + numBytes) % SectorSize != 0)
+				&& (firstSector != lastSector);
 
-    buf = new char[numSectors * SectorSize];
+// read in first and last sector, if they are to be partially modified
+    if (firstPartial) {
+	sectors[numPartial] = hdr->ByteToSector(firstSector * SectorSize);
+	bufs[numPartial++] = firstBuf;
+    }
+    if (lastPartial) {
+	sectors[numPartial] = hdr->ByteToSector(lastSector * SectorSize);
+	bufs[numPartial++] = lastBuf;
+    }
+    if (numPartial > 0)
+	journal->ReadSectors(sectors, bufs, numPartial);
 
-    firstAligned = (position == (firstSector * SectorSize));
-    lastAligned = ((position + numBytes) == ((lastSector + 1) * SectorSize));
+// copy in the bytes we want to change in the partial sectors
+    if (firstPartial) {
+	offset = position % SectorSize;
+	count = min(numBytes, SectorSize - offset);
+	bcopy(from, &firstBuf[offset], count);
+    }
+    if (lastPartial) {
+	count = (position + numBytes) % SectorSize;
+	bcopy(&from[numBytes - count], lastBuf, count);
+    }
 
-// read in first and last sector, if they are to be partially modified
-    if (!firstAligned)
-        ReadAt(buf, SectorSize, firstSector * SectorSize);	
-    if (!lastAligned && ((firstSector != lastSector) || firstAligned))
-        ReadAt(&buf[(lastSector - firstSector) * SectorSize], 
-				SectorSize, lastSector * SectorSize);	
-
-// copy in the bytes we want to change 
-    bcopy(from, &buf[position - (firstSector * SectorSize)], numBytes);
-
-// write modified sectors back
-    for (i = firstSector; i <= lastSector; i++)	
-        synchDisk->WriteSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
-    delete [] buf;
+// write modified sectors back; full sectors go straight from "from"
+    TransferSectors(from, numBytes, position, firstPartial ? firstBuf : NULL,
+					lastPartial ? lastBuf : NULL, TRUE);
+    UnlockHeader(exclusive);
     return numBytes;
 }
 
+//----------------------------------------------------------------------
+// OpenFile::WriteInline
+// 	Do a WriteAt to a file whose data is inline, in its header.
+//	Writing the data means writing the header, which is metadata,
+//	so it is a journaled operation of its own, with the header held
+//	exclusive.  WriteAt can't hold the header while it waits in
+//	Begin, so everything it checked is checked again: if the file
+//	has grown out of its header meanwhile, it is written the usual
+//	way instead.
+//----------------------------------------------------------------------
+
+int
+OpenFile::WriteInline(char *from, int numBytes, int position)
+{
+    int fileLength;
+
+    journal->Begin();
+    hdr->Lock()->AcquireExclusive();
+    if (!hdr->IsInline()) {
+	hdr->Lock()->ReleaseExclusive();
+	journal->End();
+	return WriteAt(from, numBytes, position);
+    }
+    fileLength = hdr->FileLength();
+    if (position >= fileLength) {
+	hdr->Lock()->ReleaseExclusive();
+	journal->End();
+	return 0;
+    }
+    if ((position + numBytes) > fileLength)
+	numBytes = fileLength - position;
+    DEBUG('f', "Writing %d bytes at %d, inline in file of length %d.\n",
+			numBytes, position, fileLength);
+    bcopy(from, &hdr->InlineData()[position], numBytes);
+    hdr->WriteBack(hdrSector);
+    hdr->Lock()->ReleaseExclusive();
+    journal->End();
+    return numBytes;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::TransferSectors
+// 	Read or write every sector touched by the "numBytes" bytes at
+//	"position".  A sector the request covers completely is transferred
+//	directly to or from the matching part of "buf"; the first and
+//	last sectors, if only part of them is wanted, use "firstBuf" and
+//	"lastBuf" instead (NULL if the sector is wanted whole).
+//
+//	The sectors go to the disk TransferChunk at a time, so that the
+//	lists of sectors and buffers can live on the stack.  They go by
+//	way of the journal, which logs writes to metadata files, and lets
+//	reads see logged changes that are not on disk yet.
+//----------------------------------------------------------------------
+
+void
+OpenFile::TransferSectors(char *buf, int numBytes, int position,
+		char *firstBuf, char *lastBuf, bool writing)
+{
+    int sectors[TransferChunk];
+    char *bufs[TransferChunk];
+    int firstSector = divRoundDown(position, SectorSize);
+    int lastSector = divRoundDown(position + numBytes - 1, SectorSize);
+    int i, n = 0;
+
+    for (i = firstSector; i <= lastSector; i++) {
+	sectors[n] = hdr->ByteToSector(i * SectorSize);
+	if (i == firstSector && firstBuf != NULL)
+	    bufs[n] = firstBuf;
+	else if (i == lastSector && lastBuf != NULL)
+	    bufs[n] = lastBuf;
+	else
+	    bufs[n] = &buf[i * SectorSize - position];
+	n++;
+	if (n == TransferChunk || i == lastSector) {
+	    if (writing)
+		journal->WriteSectors(sectors, bufs, n, metadata);
+	    else
+		journal->ReadSectors(sectors, bufs, n);
+	    n = 0;
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// OpenFile::LockHeader/UnlockHeader
+// 	Acquire or release the file header's lock, shared or exclusive.
+//----------------------------------------------------------------------
+
+void
+OpenFile::LockHeader(bool exclusive)
+{
+    if (exclusive)
+	hdr->Lock()->AcquireExclusive();
+    else
+	hdr->Lock()->AcquireShared();
+}
+
+void
+OpenFile::UnlockHeader(bool exclusive)
+{
+    if (exclusive)
+	hdr->Lock()->ReleaseExclusive();
+    else
+	hdr->Lock()->ReleaseShared();
+}
+
+//----------------------------------------------------------------------
+// OpenFile::SetMetadata
+// 	Mark the file as holding file system metadata -- a directory, or
+//	the bitmap of free sectors -- so that writes to it are logged in
+//	the journal, rather than going straight to disk.
+//----------------------------------------------------------------------
+
+void
+OpenFile::SetMetadata()
+{
+    metadata = TRUE;
+}
+
 //----------------------------------------------------------------------
 // OpenFile::Length
 // 	Return the number of bytes in the file.
@@ -195,3 +429,31 @@ OpenFile::Length()
 { 
     return hdr->FileLength(); 
 }
+
+//----------------------------------------------------------------------
+// OpenFile::Extend
+// 	Grow the file to "newLength" bytes, allocating the new sectors
+//	out of "freeMap", and write the file header back to disk.
+//	The caller is responsible for writing "freeMap" back.
+//
+//	Return FALSE, leaving the file unchanged, if there is not enough
+//	space on disk.
+//
+//	The header is held exclusive, so no ReadAt or WriteAt sees it
+//	half changed.
+//----------------------------------------------------------------------
+
+bool
+OpenFile::Extend(BitMap *freeMap, int newLength)
+{
+    bool success = TRUE;
+
+    hdr->Lock()->AcquireExclusive();
+    if (newLength > hdr->FileLength()) {
+	success = hdr->Extend(freeMap, newLength);
+	if (success)
+	    hdr->WriteBack(hdrSector);
+    }
+    hdr->Lock()->ReleaseExclusive();
+    return success;
+}
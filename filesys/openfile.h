@@ -52,6 +52,7 @@ class OpenFile {
 		}
 
     int Length() { Lseek(file, 0, 2); return Tell(file); }
+    int Position() { return currentOffset; }
     
   private:
     int file;
@@ -59,7 +60,20 @@ class OpenFile {
 };
 
 #else // FILESYS
+#include "disk.h"
+
 class FileHeader;
+class BitMap;
+
+// Read-ahead window, in sectors, for sequential Reads.  The window
+// starts at MinReadAhead and doubles up to MaxReadAhead for as long as
+// the file is being read sequentially.
+#define MinReadAhead	4
+#define MaxReadAhead	16
+
+// Most sectors ReadAt/WriteAt hand the disk in a single request (a
+// track, on a disk of the default geometry).
+#define TransferChunk	32
 
 class OpenFile {
   public:
@@ -69,6 +83,8 @@ class OpenFile {
 
     void Seek(int position); 		// Set the position from which to 
 					// start reading/writing -- UNIX lseek
+    int Position() { return seekPosition; }
+					// Where the next Read/Write starts
 
     int Read(char *into, int numBytes); // Read/write bytes from the file,
 					// starting at the implicit position.
@@ -85,10 +101,39 @@ class OpenFile {
 					// file (this interface is simpler 
 					// than the UNIX idiom -- lseek to 
 					// end of file, tell, lseek back 
+
+    bool Extend(BitMap *freeMap, int newLength);
+					// Grow the file to "newLength" bytes,
+					// and write its header back to disk
     
+    void SetMetadata();			// Log writes to this file in the
+					// journal
+
   private:
     FileHeader *hdr;			// Header for this file 
+    int hdrSector;			// Disk sector holding the header
     int seekPosition;			// Current position within the file
+    bool metadata;			// Directory or bitmap, whose
+					//  writes are journaled?
+
+    int readAheadNext;			// Where a sequential Read would
+					//  start next
+    int readAheadWindow;		// Sectors to read ahead, 0 if the
+					//  file isn't being read sequentially
+    int readAheadEnd;			// First sector not yet read ahead
+    void ReadAhead(int position, int numBytes);
+					// Called after each Read
+
+    void TransferSectors(char *buf, int numBytes, int position,
+		char *firstBuf, char *lastBuf, bool writing);
+					// Move the sectors of a ReadAt or
+					//  WriteAt, staging partial first
+					//  and last sectors in the buffers
+    int WriteInline(char *from, int numBytes, int position);
+					// WriteAt, for a file whose data
+					//  is in its header
+    void LockHeader(bool exclusive);	// Acquire the header's lock,
+    void UnlockHeader(bool exclusive);	//  shared or exclusive
 };
 
 #endif // FILESYS
@@ -5,10 +5,14 @@
 //	the disk providing a synchronous interface (requests wait until
 //	the request completes).
 //
-//	Use a semaphore to synchronize the interrupt handlers with the
-//	pending requests.  And, because the physical disk can only
-//	handle one operation at a time, use a lock to enforce mutual
-//	exclusion.
+//	Requests are queued, since the physical disk can only handle
+//	one operation at a time; the interrupt handler starts the next
+//	request in the queue, chosen by the disk scheduling policy.  Each
+//	request has its own semaphore, so the interrupt handler can wake
+//	up exactly the thread waiting for it.
+//
+//	Recently used sectors are kept in a write-through buffer cache,
+//	which read-ahead also fills in the background.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -16,6 +20,7 @@
 
 #include "copyright.h"
 #include "synchdisk.h"
+#include "system.h"
 
 //----------------------------------------------------------------------
 // DiskRequestDone
@@ -36,15 +41,31 @@ DiskRequestDone (int arg)
 // 	Initialize the synchronous interface to the physical disk, in turn
 //	initializing the physical disk.
 //
-//	"name" -- UNIX file name to be used as storage for the disk data
-//	   (usually, "DISK")
+//	"names" -- UNIX file names to be used as storage for the disk data
+//	   (usually, just "DISK")
+//	"count" -- how many disks, one per file
+//	"level" -- with more than one, whether to stripe or mirror them
+//	"backing" -- how the disks should keep their data in those files
+//	"sectorsPerTrack", "numTracks" -- geometry, if the disk is new
 //----------------------------------------------------------------------
 
-SynchDisk::SynchDisk(char* name)
+SynchDisk::SynchDisk(char** names, int count, RaidLevel level,
+		DiskBacking backing, int sectorsPerTrack, int numTracks)
 {
-    semaphore = new Semaphore("synch disk", 0);
-    lock = new Lock("synch disk lock");
-    disk = new Disk(name, DiskRequestDone, (int) this);
+    queue = active = NULL;
+    numActive = 0;
+    policy = DiskCLOOK;
+    headTrack = 0;
+    sweepUp = TRUE;
+    trace = NULL;
+    numSubmitted = 0;
+    for (int i = 0; i < NumCacheSectors; i++)
+	cache[i].valid = cache[i].busy = FALSE;
+    cacheClock = 0;
+    cacheReady = new Semaphore("disk cache", 0);
+    cacheWaiters = 0;
+    device = new BlockDevice(names, count, level, DiskRequestDone,
+	(int) this, backing, sectorsPerTrack, numTracks);
 }
 
 //----------------------------------------------------------------------
@@ -55,9 +76,8 @@ SynchDisk::SynchDisk(char* name)
 
 SynchDisk::~SynchDisk()
 {
-    delete disk;
-    delete lock;
-    delete semaphore;
+    delete device;
+    delete cacheReady;
 }
 
 //----------------------------------------------------------------------
@@ -65,6 +85,11 @@ SynchDisk::~SynchDisk()
 // 	Read the contents of a disk sector into a buffer.  Return only
 //	after the data has been read.
 //
+//	If the sector is in the buffer cache, it is copied from there;
+//	otherwise it is read from disk, but not added to the cache, so
+//	that reads of one sector at a time (file headers, or random
+//	reads) don't push out what ReadSectors and read-ahead put there.
+//
 //	"sectorNumber" -- the disk sector to read
 //	"data" -- the buffer to hold the contents of the disk sector
 //----------------------------------------------------------------------
@@ -72,10 +97,24 @@ SynchDisk::~SynchDisk()
 void
 SynchDisk::ReadSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->ReadRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    CacheEntry *e;
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    while (AnyBusy(&sectorNumber, 1))
+	WaitForCache();
+    e = FindCached(sectorNumber);
+    if (e != NULL && e->valid) {		// hit
+	bcopy(e->data, data, SectorSize);
+	e->lastUse = ++cacheClock;
+	if (e->prefetched) {
+	    stats->numPrefetchHits++;
+	    e->prefetched = FALSE;
+	}
+	(void) interrupt->SetLevel(oldLevel);
+	return;
+    }
+    (void) interrupt->SetLevel(oldLevel);
+    Wait(Submit(&sectorNumber, &data, 1, FALSE));
 }
 
 //----------------------------------------------------------------------
@@ -83,6 +122,9 @@ SynchDisk::ReadSector(int sectorNumber, char* data)
 // 	Write the contents of a buffer into a disk sector.  Return only
 //	after the data has been written.
 //
+//	Like any write, it goes through the buffer cache, so that the
+//	cache never holds what was there before.
+//
 //	"sectorNumber" -- the disk sector to be written
 //	"data" -- the new contents of the disk sector
 //----------------------------------------------------------------------
@@ -90,20 +132,490 @@ SynchDisk::ReadSector(int sectorNumber, char* data)
 void
 SynchDisk::WriteSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->WriteRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    WriteSectors(&sectorNumber, &data, 1);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ReadSectors
+// 	Read a list of disk sectors, each into its own buffer.  Return
+//	only after all the data has been read.
+//
+//	Sectors in the buffer cache are copied from there; the rest are
+//	read from disk as a single disk request, and added to the cache.
+//	If some of the sectors are still being read in (by read-ahead, or
+//	by another thread), we wait for them first, so that we never
+//	claim a cache entry while waiting on someone else's.
+//
+//	"sectors" -- the disk sectors to read
+//	"data" -- data[i] is the buffer to hold the contents of sectors[i]
+//	"count" -- the number of sectors to read
+//----------------------------------------------------------------------
+
+void
+SynchDisk::ReadSectors(int *sectors, char **data, int count)
+{
+    int missSectors[MaxCachedRequest];
+    char *missData[MaxCachedRequest];
+    CacheEntry *missEntries[MaxCachedRequest];
+    int missIndex[MaxCachedRequest];
+    int i, numMisses = 0;
+    CacheEntry *e;
+    IntStatus oldLevel;
+
+    if (count > MaxCachedRequest) {		// too big; go around the cache
+	Wait(Submit(sectors, data, count, FALSE));
+	return;
+    }
+
+    oldLevel = interrupt->SetLevel(IntOff);
+    while (AnyBusy(sectors, count))
+	WaitForCache();
+    for (i = 0; i < count; i++) {
+	e = FindCached(sectors[i]);
+	if (e != NULL && e->valid) {		// hit
+	    bcopy(e->data, data[i], SectorSize);
+	    e->lastUse = ++cacheClock;
+	    if (e->prefetched) {
+		stats->numPrefetchHits++;
+		e->prefetched = FALSE;
+	    }
+	    continue;
+	}
+	e = (e == NULL) ? AllocEntry(sectors[i]) : NULL;
+	missSectors[numMisses] = sectors[i];
+	missData[numMisses] = (e != NULL) ? e->data : data[i];
+	missEntries[numMisses] = e;		// NULL: not cached
+	missIndex[numMisses++] = i;
+    }
+
+    if (numMisses > 0) {
+	Wait(Submit(missSectors, missData, numMisses, FALSE));
+	for (i = 0; i < numMisses; i++) {
+	    if ((e = missEntries[i]) == NULL)
+		continue;
+	    bcopy(e->data, data[missIndex[i]], SectorSize);
+	    e->valid = TRUE;
+	    e->busy = FALSE;
+	}
+	while (cacheWaiters > 0) {		// wake anyone waiting on them
+	    cacheWaiters--;
+	    cacheReady->V();
+	}
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WriteSectors
+// 	Write a list of buffers to disk sectors, as a single disk request.
+//	Return only after all the data has been written.
+//
+//	The new contents also go into the buffer cache, so that a later
+//	read (or a read-ahead queued behind this write) can't pick up
+//	what was there before.
+//
+//	"sectors" -- the disk sectors to be written
+//	"data" -- data[i] holds the new contents of sectors[i]
+//	"count" -- the number of sectors to write
+//----------------------------------------------------------------------
+
+void
+SynchDisk::WriteSectors(int *sectors, char **data, int count)
+{
+    CacheEntry *e;
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    while (AnyBusy(sectors, count))
+	WaitForCache();
+    for (int i = 0; i < count; i++) {
+	e = FindCached(sectors[i]);
+	if (e == NULL && count <= MaxCachedRequest)
+	    e = AllocEntry(sectors[i]);
+	if (e != NULL) {
+	    bcopy(data[i], e->data, SectorSize);
+	    e->valid = TRUE;
+	    e->busy = FALSE;
+	    e->lastUse = ++cacheClock;
+	}
+    }
+    (void) interrupt->SetLevel(oldLevel);
+
+    Wait(Submit(sectors, data, count, TRUE));
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Prefetch
+// 	Start reading a list of sectors into the buffer cache, and return
+//	without waiting.  Sectors already in the cache are skipped, and
+//	we stop early if the cache has no room.
+//
+//	"sectors" -- the disk sectors to read ahead
+//	"count" -- the number of sectors
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Prefetch(int *sectors, int count)
+{
+    int *fetchSectors = new int[count];
+    char **fetchData = new char *[count];
+    int n = 0;
+    CacheEntry *e;
+    DiskRequest *request;
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    for (int i = 0; i < count; i++) {
+	if (FindCached(sectors[i]) != NULL)
+	    continue;
+	if ((e = AllocEntry(sectors[i])) == NULL)
+	    break;				// cache is full of busy entries
+	e->prefetched = TRUE;
+	fetchSectors[n] = sectors[i];
+	fetchData[n++] = e->data;
+    }
+    if (n == 0) {
+	delete [] fetchSectors;
+	delete [] fetchData;
+    } else {
+	DEBUG('d', "Reading ahead %d sectors from %d\n", n, fetchSectors[0]);
+	stats->numPrefetchSectors += n;
+	request = Submit(fetchSectors, fetchData, n, FALSE);
+	request->prefetch = TRUE;	// can't finish until interrupts
+    }					//  are back on
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::FinishPrefetch
+// 	Called from the interrupt handler when a read-ahead request
+//	finishes: the sectors are now valid, and anyone waiting for them
+//	can go ahead.  Nobody Waits on the request, so free it here.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::FinishPrefetch(DiskRequest *request)
+{
+    CacheEntry *e;
+
+    for (int i = 0; i < request->count; i++) {
+	e = FindCached(request->sectors[i]);
+	ASSERT(e != NULL && e->busy);
+	e->valid = TRUE;
+	e->busy = FALSE;
+    }
+    while (cacheWaiters > 0) {
+	cacheWaiters--;
+	cacheReady->V();
+    }
+    delete [] request->sectors;
+    delete [] request->data;
+    delete request->done;
+    delete request;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::FindCached
+// 	Return the cache entry for "sector", whether it is valid or still
+//	being read in, or NULL if it isn't in the cache.  Called with
+//	interrupts off.
+//----------------------------------------------------------------------
+
+CacheEntry *
+SynchDisk::FindCached(int sector)
+{
+    for (int i = 0; i < NumCacheSectors; i++)
+	if ((cache[i].valid || cache[i].busy) && cache[i].sector == sector)
+	    return &cache[i];
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::AllocEntry
+// 	Take a cache entry for "sector", replacing the least recently used
+//	sector that isn't being read in.  The entry comes back marked
+//	busy.  Return NULL if every entry is busy.  Called with interrupts
+//	off.
+//----------------------------------------------------------------------
+
+CacheEntry *
+SynchDisk::AllocEntry(int sector)
+{
+    CacheEntry *e, *victim = NULL;
+
+    for (int i = 0; i < NumCacheSectors; i++) {
+	e = &cache[i];
+	if (e->busy)
+	    continue;
+	if (!e->valid) {
+	    victim = e;
+	    break;
+	}
+	if (victim == NULL || e->lastUse < victim->lastUse)
+	    victim = e;
+    }
+    if (victim == NULL)
+	return NULL;
+    victim->sector = sector;
+    victim->valid = FALSE;
+    victim->busy = TRUE;
+    victim->prefetched = FALSE;
+    victim->lastUse = ++cacheClock;
+    return victim;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::AnyBusy
+// 	Return TRUE if any of "sectors" is in the cache, but still being
+//	read in.  Called with interrupts off.
+//----------------------------------------------------------------------
+
+bool
+SynchDisk::AnyBusy(int *sectors, int count)
+{
+    CacheEntry *e;
+
+    for (int i = 0; i < count; i++) {
+	e = FindCached(sectors[i]);
+	if (e != NULL && e->busy)
+	    return TRUE;
+    }
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WaitForCache
+// 	Wait until some busy cache entry has been read in.  Called with
+//	interrupts off; the caller has to look again at whatever it was
+//	waiting for.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::WaitForCache()
+{
+    cacheWaiters++;
+    cacheReady->P();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::FlushCache
+// 	Throw away everything in the buffer cache (except sectors still
+//	being read in), so later reads have to go to the disk.  Since the
+//	cache is write-through, nothing is lost.  For measurements.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::FlushCache()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    for (int i = 0; i < NumCacheSectors; i++)
+	if (!cache[i].busy)
+	    cache[i].valid = FALSE;
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Submit
+// 	Queue up a request to read/write a list of disk sectors, starting
+//	it right away if the disk is idle, and return without waiting for
+//	it to finish.  The caller must pass the result to Wait, and must
+//	not touch "sectors" or "data" until then.
+//
+//	"sectors" -- the disk sectors to read/write
+//	"data" -- data[i] is the buffer for sectors[i]
+//	"count" -- the number of sectors
+//	"writing" -- TRUE to write, FALSE to read
+//----------------------------------------------------------------------
+
+DiskRequest *
+SynchDisk::Submit(int *sectors, char **data, int count, bool writing)
+{
+    DiskRequest *request = new DiskRequest;
+    DiskRequest **link;
+    IntStatus oldLevel;
+
+    request->sectors = sectors;
+    request->data = data;
+    request->count = count;
+    request->writing = writing;
+    request->track = sectors[0] / device->SectorsPerTrack();
+    request->done = new Semaphore("disk request", 0);
+    request->prefetch = FALSE;
+    request->arrived = stats->totalTicks;
+    request->next = NULL;
+
+    oldLevel = interrupt->SetLevel(IntOff);	// queue is shared with
+						// the interrupt handler
+    request->number = numSubmitted++;
+    for (link = &queue; *link != NULL; link = &(*link)->next)
+	;
+    *link = request;
+    StartNext();
+    (void) interrupt->SetLevel(oldLevel);
+    return request;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Wait
+// 	Wait for a request returned by Submit to finish, then
+//	de-allocate it.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Wait(DiskRequest *request)
+{
+    request->done->P();			// wait for interrupt
+    delete request->done;
+    delete request;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::SetPolicy
+// 	Change the order in which queued requests are sent to the disk.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::SetPolicy(DiskPolicy newPolicy)
+{
+    policy = newPolicy;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::SetModel
+// 	Change how the disk drive behaves; see DiskModel.  Only while no
+//	requests are outstanding.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::SetModel(DiskModel *model)
+{
+    ASSERT(numActive == 0 && queue == NULL);
+    device->SetModel(model);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::PickNext
+// 	Remove the request the scheduling policy says should go next
+//	from the queue, and return it.  Among requests that are equally
+//	good, the one that arrived first wins.  Called with interrupts off,
+//	and only if the queue is not empty.
+//----------------------------------------------------------------------
+
+DiskRequest *
+SynchDisk::PickNext()
+{
+    DiskRequest **link, **best = NULL;
+    DiskRequest *request;
+    int dist, bestDist = 0;
+
+    switch (policy) {
+      case DiskFCFS:
+	best = &queue;
+	break;
+
+      case DiskSSTF:
+	for (link = &queue; *link != NULL; link = &(*link)->next) {
+	    dist = abs((*link)->track - headTrack);
+	    if (best == NULL || dist < bestDist) {
+		best = link;
+		bestDist = dist;
+	    }
+	}
+	break;
+
+      case DiskLOOK:
+	for (int pass = 0; best == NULL; pass++) {
+	    ASSERT(pass < 2);
+	    for (link = &queue; *link != NULL; link = &(*link)->next) {
+		dist = sweepUp ? (*link)->track - headTrack
+			       : headTrack - (*link)->track;
+		if (dist >= 0 && (best == NULL || dist < bestDist)) {
+		    best = link;
+		    bestDist = dist;
+		}
+	    }
+	    if (best == NULL)		// nothing ahead; turn around
+		sweepUp = !sweepUp;
+	}
+	break;
+
+      case DiskCLOOK:
+	for (link = &queue; *link != NULL; link = &(*link)->next) {
+	    dist = (*link)->track - headTrack;
+	    if (dist < 0)		// behind us: after everything ahead
+		dist += device->NumTracks();
+	    if (best == NULL || dist < bestDist) {
+		best = link;
+		bestDist = dist;
+	    }
+	}
+	break;
+    }
+
+    request = *best;
+    *best = request->next;
+    return request;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::StartNext
+// 	While the disk will take more requests and there are requests
+//	waiting, send the next one to the disk.  Called with interrupts
+//	off.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::StartNext()
+{
+    DiskRequest *request;
+
+    while (numActive < device->QueueDepth() && queue != NULL) {
+	request = PickNext();
+	request->next = active;
+	active = request;
+	numActive++;
+	headTrack = request->sectors[request->count - 1]
+					/ device->SectorsPerTrack();
+	DEBUG('d', "Starting request for %d sectors at track %d\n",
+	      request->count, request->track);
+	if (request->writing)
+	    device->WritevRequest(request->sectors, request->data,
+		request->count);
+	else
+	    device->ReadvRequest(request->sectors, request->data,
+		request->count);
+    }
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::RequestDone
-// 	Disk interrupt handler.  Wake up any thread waiting for the disk
-//	request to finish.
+// 	Disk interrupt handler.  Find the request the disk has finished,
+//	record it in the trace, if there is one, wake up the thread
+//	waiting for it (or finish off a read-ahead), and start on the
+//	next one.
 //----------------------------------------------------------------------
 
 void
 SynchDisk::RequestDone()
 { 
-    semaphore->V();
+    int *done = device->LastDone();
+    DiskRequest **link, *request;
+
+    for (link = &active; *link != NULL; link = &(*link)->next)
+	if ((*link)->sectors == done)
+	    break;
+    request = *link;
+    ASSERT(request != NULL);
+    *link = request->next;
+    numActive--;
+    if (trace != NULL)
+	trace->Record(request->number, request->arrived,
+	    stats->totalTicks - request->arrived,
+	    request->prefetch ? TracePrefetch
+			      : (request->writing ? TraceWrite : TraceRead),
+	    request->sectors, request->count);
+    if (request->prefetch)
+	FinishPrefetch(request);
+    else
+	request->done->V();
+    StartNext();
 }
@@ -11,9 +11,56 @@
 #ifndef SYNCHDISK_H
 #define SYNCHDISK_H
 
-#include "disk.h"
+#include "blockdev.h"
+#include "disktrace.h"
 #include "synch.h"
 
+// Disk scheduling policies: the order in which SynchDisk hands queued
+// requests to the disk.  Distances are measured in tracks, from the
+// track the disk head was left on by the previous request.
+enum DiskPolicy { DiskFCFS,		// in order of arrival
+		  DiskSSTF,		// shortest seek first
+		  DiskLOOK,		// elevator: sweep out and back,
+					//  turning at the last track waiting
+		  DiskCLOOK };		// sweep out, then jump back to the
+					//  lowest track waiting
+
+// A request queued for the disk.  The sector list and buffers belong to
+// the caller, and must stay put until the request is done.
+
+class DiskRequest {
+  public:
+    int *sectors;			// Sectors to read or write
+    char **data;			// Buffer for each sector
+    int count;				// Number of sectors
+    bool writing;			// Write, rather than read?
+    int track;				// Track of the first sector
+    Semaphore *done;			// V'ed when the request completes
+    bool prefetch;			// Read-ahead: no one waits for it
+    int number;				// How many were queued before it
+    int arrived;			// When it was queued
+    DiskRequest *next;			// Next request in the queue
+};
+
+// SynchDisk keeps the most recently used sectors in a buffer cache.
+// Writes go through to the disk right away, so the cache never holds
+// anything the disk does not.  Requests for more than
+// MaxCachedRequest sectors bypass the cache when reading, so that one
+// big transfer does not flush everything else; so does ReadSector,
+// unless the sector is already there.
+#define NumCacheSectors		64
+#define MaxCachedRequest	(NumCacheSectors / 4)
+
+class CacheEntry {
+  public:
+    int sector;				// Which sector this holds
+    bool valid;				// Holds the contents of "sector"?
+    bool busy;				// Being read in from disk?
+    bool prefetched;			// Read ahead, and not yet used?
+    int lastUse;			// For LRU replacement
+    char data[SectorSize];		// The contents of the sector
+};
+
 // The following class defines a "synchronous" disk abstraction.
 // As with other I/O devices, the raw physical disk is an asynchronous device --
 // requests to read or write portions of the disk return immediately,
@@ -24,10 +71,25 @@
 // This class provides the abstraction that for any individual thread
 // making a request, it waits around until the operation finishes before
 // returning.
+//
+// Underneath, requests from all threads go into a queue; whenever the
+// disk will take another request, the next one is picked according to
+// the scheduling policy.  A thread that does not want to wait right
+// away can use Submit, and later Wait for the request to finish.
+//
+// Reads are served from the buffer cache when possible.  Prefetch
+// starts reading sectors into the cache in the background, for
+// callers that expect to want them soon.
+//
+// What SynchDisk sees as the disk may be several disks, striped or
+// mirrored; see blockdev.h.
 class SynchDisk {
   public:
-    SynchDisk(char* name);    		// Initialize a synchronous disk,
-					// by initializing the raw Disk.
+    SynchDisk(char** names, int count, RaidLevel level,
+		DiskBacking backing, int sectorsPerTrack, int numTracks);
+					// Initialize a synchronous disk,
+					// by initializing the BlockDevice
+					// made of the raw Disks.
     ~SynchDisk();			// De-allocate the synch disk data
     
     void ReadSector(int sectorNumber, char* data);
@@ -38,16 +100,72 @@ class SynchDisk {
 					// then wait until the request is done.
     void WriteSector(int sectorNumber, char* data);
     
+    void ReadSectors(int *sectors, char **data, int count);
+    					// Read/write several disk sectors
+					// with a single disk request.
+    void WriteSectors(int *sectors, char **data, int count);
+
+    DiskRequest *Submit(int *sectors, char **data, int count, bool writing);
+					// Queue a request, and return
+					// without waiting for it
+    void Wait(DiskRequest *request);	// Wait for a request from Submit
+					// to finish, and de-allocate it
+
+    void SetPolicy(DiskPolicy policy);	// Change the scheduling policy
+    void SetModel(DiskModel *model);	// Change how the drive behaves
+    void SetTrace(DiskTrace *newTrace) { trace = newTrace; }
+					// Record each request in "newTrace"
+					// as it finishes; NULL to stop
+
+    void Prefetch(int *sectors, int count);
+					// Start reading sectors into the
+					// cache, without waiting
+    void FlushCache();			// Empty the buffer cache
+
+    void CrashAfter(int numWrites) { device->CrashAfter(numWrites); }
+					// Simulate a crash; see disk.h
+    int EstimateTime(int *sectors, int count)
+	{ return device->EstimateTime(sectors, count); }
+					// Time to read the sectors; see
+					// blockdev.h
+
+    int SectorsPerTrack() { return device->SectorsPerTrack(); }
+    int NumTracks() { return device->NumTracks(); }
+    int NumSectors() { return device->NumSectors(); }
+					// Geometry of the device
+    BlockDevice *Device() { return device; }
+
     void RequestDone();			// Called by the disk device interrupt
 					// handler, to signal that the
 					// current disk operation is complete.
 
   private:
-    Disk *disk;		  		// Raw disk device
-    Semaphore *semaphore; 		// To synchronize requesting thread 
-					// with the interrupt handler
-    Lock *lock;		  		// Only one read/write request
-					// can be sent to the disk at a time
+    BlockDevice *device;		// Raw disk device, or several
+    DiskRequest *queue;			// Requests waiting for the disk,
+					// in order of arrival
+    DiskRequest *active;		// Requests the disk is working on
+    int numActive;			// ... how many (see DiskModel)
+    DiskPolicy policy;			// How to pick the next request
+    int headTrack;			// Where the last request left the head
+    bool sweepUp;			// LOOK: moving toward higher tracks?
+    DiskTrace *trace;			// Where requests are recorded, or NULL
+    int numSubmitted;			// Requests queued so far
+
+    CacheEntry cache[NumCacheSectors];	// The buffer cache
+    int cacheClock;			// Counts cache lookups, for LRU
+    Semaphore *cacheReady;		// Signalled when busy entries
+    int cacheWaiters;			//  finish reading; # waiting
+
+    DiskRequest *PickNext();		// Take the next request off the queue
+    void StartNext();			// Send the next request to the disk
+
+    CacheEntry *FindCached(int sector);	// Look for a sector in the cache
+    CacheEntry *AllocEntry(int sector);	// Make room for a sector
+    bool AnyBusy(int *sectors, int count);
+					// Is any of them being read in?
+    void WaitForCache();		// Wait for a busy entry to finish
+    void FinishPrefetch(DiskRequest *request);
+					// Read-ahead is done
 };
 
 #endif // SYNCHDISK_H
@@ -7,6 +7,10 @@
 //	delay), to signal that a byte has arrived and/or that a written
 //	byte has departed.
 //
+//	Rather than poll the keyboard every ConsoleTime, the console has
+//	the interrupt simulation watch it (see Interrupt::WatchInput),
+//	whenever there is room for the next character.
+//
 //  DO NOT CHANGE -- part of the machine emulation
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
@@ -53,10 +57,12 @@ Console::Console(char *readFile, char *writeFile, VoidFunctionPtr readAvail,
     readHandler = readAvail;
     handlerArg = callArg;
     putBusy = FALSE;
+    putCount = 0;
     incoming = EOF;
 
-    // start polling for incoming packets
-    interrupt->Schedule(ConsoleReadPoll, (int)this, ConsoleTime, ConsoleReadInt);
+    // start watching for incoming characters
+    interrupt->WatchInput(readFileNo, ConsoleReadPoll, (int)this,
+			ConsoleTime, ConsoleReadInt);
 }
 
 //----------------------------------------------------------------------
@@ -66,6 +72,7 @@ Console::Console(char *readFile, char *writeFile, VoidFunctionPtr readAvail,
 
 Console::~Console()
 {
+    interrupt->IgnoreInput(readFileNo);
     if (readFileNo != 0)
 	Close(readFileNo);
     if (writeFileNo != 1)
@@ -74,13 +81,13 @@ Console::~Console()
 
 //----------------------------------------------------------------------
 // Console::CheckCharAvail()
-// 	Periodically called to check if a character is available for
-//	input from the simulated keyboard (eg, has it been typed?).
+// 	Called once a character is available for input from the
+//	simulated keyboard (eg, it has been typed).
 //
-//	Only read it in if there is buffer space for it (if the previous
-//	character has been grabbed out of the buffer by the Nachos kernel).
-//	Invoke the "read" interrupt handler, once the character has been 
-//	put into the buffer. 
+//	We are only told when there is buffer space for it (when the
+//	previous character has been grabbed out of the buffer by the
+//	Nachos kernel).  Invoke the "read" interrupt handler, once the
+//	character has been put into the buffer.
 //----------------------------------------------------------------------
 
 void
@@ -88,16 +95,12 @@ Console::CheckCharAvail()
 {
     char c;
 
-    // schedule the next time to poll for a packet
-    interrupt->Schedule(ConsoleReadPoll, (int)this, ConsoleTime, 
-			ConsoleReadInt);
-
-    // do nothing if character is already buffered, or none to be read
-    if ((incoming != EOF) || !PollFile(readFileNo))
-	return;	  
+    ASSERT(incoming == EOF);
 
-    // otherwise, read character and tell user about it
-    Read(readFileNo, &c, sizeof(char));
+    // read character and tell user about it; at the end of the input
+    // file, there is never anything more to read, so stop watching
+    if (ReadPartial(readFileNo, &c, sizeof(char)) != sizeof(char))
+	return;
     incoming = c ;
     stats->numConsoleCharsRead++;
     (*readHandler)(handlerArg);	
@@ -106,22 +109,24 @@ Console::CheckCharAvail()
 //----------------------------------------------------------------------
 // Console::WriteDone()
 // 	Internal routine called when it is time to invoke the interrupt
-//	handler to tell the Nachos kernel that the output character has
-//	completed.
+//	handler to tell the Nachos kernel that the output character (or
+//	characters) has completed.
 //----------------------------------------------------------------------
 
 void
 Console::WriteDone()
 {
     putBusy = FALSE;
-    stats->numConsoleCharsWritten++;
+    stats->numConsoleCharsWritten += putCount;
+    stats->numConsoleWriteRequests++;
     (*writeHandler)(handlerArg);
 }
 
 //----------------------------------------------------------------------
 // Console::GetChar()
 // 	Read a character from the input buffer, if there is any there.
-//	Either return the character, or EOF if none buffered.
+//	Either return the character, or EOF if none buffered.  Taking
+//	one makes room for the next, so start watching for it.
 //----------------------------------------------------------------------
 
 char
@@ -130,6 +135,9 @@ Console::GetChar()
    char ch = incoming;
 
    incoming = EOF;
+   if (ch != EOF)
+	interrupt->WatchInput(readFileNo, ConsoleReadPoll, (int)this,
+			ConsoleTime, ConsoleReadInt);
    return ch;
 }
 
@@ -145,6 +153,25 @@ Console::PutChar(char ch)
     ASSERT(putBusy == FALSE);
     WriteFile(writeFileNo, &ch, sizeof(char));
     putBusy = TRUE;
+    putCount = 1;
     interrupt->Schedule(ConsoleWriteDone, (int)this, ConsoleTime,
 					ConsoleWriteInt);
 }
+
+//----------------------------------------------------------------------
+// Console::PutChars()
+// 	Write "count" characters to the simulated display, all at once,
+//	and schedule a single interrupt for when the last of them has
+//	gone out.
+//----------------------------------------------------------------------
+
+void
+Console::PutChars(char *data, int count)
+{
+    ASSERT(putBusy == FALSE && count > 0);
+    WriteFile(writeFileNo, data, count);
+    putBusy = TRUE;
+    putCount = count;
+    interrupt->Schedule(ConsoleWriteDone, (int)this,
+		ConsoleTime + (count - 1) * ConsoleCharTime, ConsoleWriteInt);
+}
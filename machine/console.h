@@ -34,6 +34,11 @@
 // is called when a character has arrived, ready to be read in.
 // The interrupt handler "writeDone" is called when an output character 
 // has been "put", so that the next character can be written.
+//
+// PutChars sends a whole buffer of characters as a single request, as
+// a serial port with a transmit FIFO (or DMA) would: it costs one
+// interrupt, and ConsoleTime plus ConsoleCharTime for each character,
+// rather than ConsoleTime and an interrupt for each of them.
 
 class Console {
   public:
@@ -46,6 +51,10 @@ class Console {
     void PutChar(char ch);	// Write "ch" to the console display, 
 				// and return immediately.  "writeHandler" 
 				// is called when the I/O completes. 
+    void PutChars(char *data, int count);
+				// Write "count" characters as one request;
+				// "writeHandler" is called once they are
+				// all out.
 
     char GetChar();	   	// Poll the console input.  If a char is 
 				// available, return it.  Otherwise, return EOF.
@@ -67,6 +76,7 @@ class Console {
 					// interrupt handlers
     bool putBusy;    			// Is a PutChar operation in progress?
 					// If so, you can't do another one!
+    int putCount;			// Characters it is sending
     char incoming;    			// Contains the character to be read,
 					// if there is one available. 
 					// Otherwise contains EOF.
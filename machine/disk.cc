@@ -17,14 +17,6 @@
 #include "disk.h"
 #include "system.h"
 
-// We put this at the front of the UNIX file representing the
-// disk, to make it less likely we will accidentally treat a useful file 
-// as a disk (which would probably trash the file's contents).
-#define MagicNumber 	0x456789ab
-#define MagicSize 	sizeof(int)
-
-#define DiskSize 	(MagicSize + (NumSectors * SectorSize))
-
 // dummy procedure because we can't take a pointer of a member function
 static void DiskDone(int arg) { ((Disk *)arg)->HandleInterrupt(); }
 
@@ -38,11 +30,17 @@ static void DiskDone(int arg) { ((Disk *)arg)->HandleInterrupt(); }
 //	"callWhenDone" -- interrupt handler to be called when disk read/write
 //	   request completes
 //	"callArg" -- argument to pass the interrupt handler
+//	"diskBacking" -- whether to map the UNIX file into memory, and
+//	   if so, whether to msync each write
+//	"newSectorsPerTrack", "newNumTracks" -- the geometry to give the
+//	   disk if it has to be created; otherwise the file's label says
 //----------------------------------------------------------------------
 
-Disk::Disk(char* name, VoidFunctionPtr callWhenDone, int callArg)
+Disk::Disk(char* name, VoidFunctionPtr callWhenDone, int callArg,
+		DiskBacking diskBacking, int newSectorsPerTrack,
+		int newNumTracks)
 {
-    int magicNum;
+    DiskLabel label;
     int tmp = 0;
 
     DEBUG('d', "Initializing the disk, 0x%x 0x%x\n", callWhenDone, callArg);
@@ -50,21 +48,56 @@ Disk::Disk(char* name, VoidFunctionPtr callWhenDone, int callArg)
     handlerArg = callArg;
     lastSector = 0;
     bufferInit = 0;
+    writesLeft = -1;
     
     fileno = OpenForReadWrite(name, FALSE);
     if (fileno >= 0) {		 	// file exists, check magic number 
-	Read(fileno, (char *) &magicNum, MagicSize);
-	ASSERT(magicNum == MagicNumber);
+	Read(fileno, (char *) &label.magic, MagicSize);
+	if (label.magic == OldMagicNumber) {
+	    label.sectorsPerTrack = DefaultSectorsPerTrack;
+	    label.numTracks = DefaultNumTracks;
+	    dataOffset = MagicSize;
+	} else {
+	    ASSERT(label.magic == MagicNumber);
+	    Read(fileno, (char *) &label.sectorsPerTrack,
+		sizeof(DiskLabel) - MagicSize);
+	    dataOffset = sizeof(DiskLabel);
+	}
     } else {				// file doesn't exist, create it
+	ASSERT(newSectorsPerTrack > 0 && newNumTracks > 0);
         fileno = OpenForWrite(name);
-	magicNum = MagicNumber;  
-	WriteFile(fileno, (char *) &magicNum, MagicSize); // write magic number
-
-	// need to write at end of file, so that reads will not return EOF
-        Lseek(fileno, DiskSize - sizeof(int), 0);	
+	label.magic = MagicNumber;
+	label.sectorsPerTrack = newSectorsPerTrack;
+	label.numTracks = newNumTracks;
+	WriteFile(fileno, (char *) &label, sizeof(DiskLabel));
+	dataOffset = sizeof(DiskLabel);
+    }
+    sectorsPerTrack = label.sectorsPerTrack;
+    numTracks = label.numTracks;
+    numSectors = sectorsPerTrack * numTracks;
+    DEBUG('d', "Disk %s: %d tracks of %d sectors\n", name, numTracks,
+	sectorsPerTrack);
+
+    // need to write at end of file, so that reads will not return EOF
+    // (and so that all of it can be mapped)
+    Lseek(fileno, 0, 2);
+    if (Tell(fileno) < FileSize()) {
+        Lseek(fileno, FileSize() - sizeof(int), 0);
 	WriteFile(fileno, (char *)&tmp, sizeof(int));  
     }
-    active = FALSE;
+    backing = diskBacking;
+    image = NULL;
+    if (backing != DiskFile)
+	image = MapFile(fileno, FileSize());
+    outstanding = 0;
+    waiting = running = NULL;
+    lastDone = NULL;
+    platterBusy = FALSE;
+    platterFree = 0;
+    dirty = NULL;
+    numDirty = 0;
+    readingAhead = FALSE;
+    aheadFirst = aheadCount = 0;
 }
 
 //----------------------------------------------------------------------
@@ -75,7 +108,10 @@ Disk::Disk(char* name, VoidFunctionPtr callWhenDone, int callArg)
 
 Disk::~Disk()
 {
+    if (image != NULL)
+	UnmapFile(image, FileSize());
     Close(fileno);
+    delete [] dirty;
 }
 
 //----------------------------------------------------------------------
@@ -115,60 +151,399 @@ PrintSector (bool writing, int sector, char *data)
 void
 Disk::ReadRequest(int sectorNumber, char* data)
 {
-    int ticks = ComputeLatency(sectorNumber, FALSE);
-
-    ASSERT(!active);				// only one request at a time
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
-    
-    DEBUG('d', "Reading from sector %d\n", sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    Read(fileno, data, SectorSize);
-    if (DebugIsEnabled('d'))
-	PrintSector(FALSE, sectorNumber, data);
-    
-    active = TRUE;
-    UpdateLast(sectorNumber);
-    stats->numDiskReads++;
-    interrupt->Schedule(DiskDone, (int) this, ticks, DiskInt);
+    Transfer(&sectorNumber, &data, 1, FALSE);
 }
 
 void
 Disk::WriteRequest(int sectorNumber, char* data)
 {
-    int ticks = ComputeLatency(sectorNumber, TRUE);
+    Transfer(&sectorNumber, &data, 1, TRUE);
+}
 
-    ASSERT(!active);
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+//----------------------------------------------------------------------
+// Disk::ReadvRequest/WritevRequest
+// 	Simulate a request to read/write a list of disk sectors, as
+//	a single request with a single interrupt when it completes.
+//
+//	"sectors" -- the disk sectors to read/write, in order
+//	"data" -- data[i] holds the bytes for sectors[i]
+//	"count" -- number of sectors in the request
+//----------------------------------------------------------------------
     
-    DEBUG('d', "Writing to sector %d\n", sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    WriteFile(fileno, data, SectorSize);
-    if (DebugIsEnabled('d'))
-	PrintSector(TRUE, sectorNumber, data);
+void
+Disk::ReadvRequest(int *sectors, char **data, int count)
+{
+    Transfer(sectors, data, count, FALSE);
+}
+
+void
+Disk::WritevRequest(int *sectors, char **data, int count)
+{
+    Transfer(sectors, data, count, TRUE);
+}
+
+//----------------------------------------------------------------------
+// Disk::SetModel
+// 	Change how the drive behaves: the size of its write cache,
+//	whether it reads ahead, and how many requests it takes at once.
+//	Only while the drive is idle, with nothing in its cache.
+//----------------------------------------------------------------------
+
+void
+Disk::SetModel(DiskModel *newModel)
+{
+    ASSERT(outstanding == 0 && numDirty == 0);
+    ASSERT(newModel->cacheSectors >= 0 && newModel->queueDepth >= 1);
+    model = *newModel;
+    delete [] dirty;
+    dirty = NULL;
+    if (model.cacheSectors > 0)
+	dirty = new int[model.cacheSectors];
+    readingAhead = FALSE;
+    aheadCount = 0;
+}
+
+//----------------------------------------------------------------------
+// Disk::Transfer
+// 	Do the work of a read or write request: move each sector
+//	to/from the UNIX file, and work out when the disk would be
+//	done with the request.
+//
+//	The data moves right away, whatever the drive is doing.  If the
+//	request can be done from the drive's memory -- a write, with
+//	room in the write cache, or a read of sectors all there -- it
+//	completes without waiting for the platter.  Otherwise it starts
+//	on the platter now, or waits its turn there if the platter is
+//	busy with another request.
+//
+//	If the file is mapped, each sector is copied instead, and with
+//	DiskMappedSync, the sectors written are synced to the file
+//	before we return.
+//----------------------------------------------------------------------
+
+void
+Disk::Transfer(int *sectors, char **data, int count, bool writing)
+{
+    int i, where, room, now = stats->totalTicks;
+    int low = numSectors, high = -1;	// range of sectors written
+    DiskCommand *command, **link;
+    bool cached = TRUE;
+
+    ASSERT(outstanding < model.queueDepth);	// too many requests
+    ASSERT(count > 0);
+
+    for (i = 0; i < count; i++) {
+	ASSERT((sectors[i] >= 0) && (sectors[i] < numSectors));
+	if (writing)
+	    DEBUG('d', "Writing to sector %d\n", sectors[i]);
+	else
+	    DEBUG('d', "Reading from sector %d\n", sectors[i]);
+	where = SectorOffset(sectors[i]);
+	if (image == NULL
+		&& ((i == 0) || (sectors[i] != sectors[i - 1] + 1)))
+	    Lseek(fileno, where, 0);
+	if (writing) {
+	    if (writesLeft == 0)
+		DEBUG('d', "Crashed, sector %d not written\n", sectors[i]);
+	    else if (image != NULL) {
+		bcopy(data[i], &image[where], SectorSize);
+		low = min(low, sectors[i]);
+		high = max(high, sectors[i]);
+	    } else
+		WriteFile(fileno, data[i], SectorSize);
+	    if (writesLeft > 0)
+		writesLeft--;
+	    stats->numDiskWrites++;
+	} else {
+	    if (image != NULL)
+		bcopy(&image[where], data[i], SectorSize);
+	    else
+		Read(fileno, data[i], SectorSize);
+	    stats->numDiskReads++;
+	}
+	if (DebugIsEnabled('d'))
+	    PrintSector(writing, sectors[i], data[i]);
+    }
+    if (backing == DiskMappedSync && high >= low)
+	SyncFile(&image[SectorOffset(low)],
+		SectorSize * (high - low + 1));
     
-    active = TRUE;
-    UpdateLast(sectorNumber);
-    stats->numDiskWrites++;
-    interrupt->Schedule(DiskDone, (int) this, ticks, DiskInt);
+    command = new DiskCommand;
+    command->sectors = sectors;
+    command->count = count;
+    command->writing = writing;
+    command->made = now;
+    command->next = NULL;
+    outstanding++;
+
+    CatchUp(now);
+    if (writing) {
+	room = model.cacheSectors - numDirty;
+	for (i = 0; i < count; i++)
+	    if (!Dirty(sectors[i]))
+		room--;
+	cached = (model.cacheSectors > 0) && (room >= 0);
+    } else
+	for (i = 0; i < count && cached; i++)
+	    cached = Cached(sectors[i]);
+
+    if (cached) {			// all in the drive's memory
+	if (writing)
+	    for (i = 0; i < count; i++)
+		if (!Dirty(sectors[i]))
+		    dirty[numDirty++] = sectors[i];
+	if (writing)
+	    stats->numDiskCachedWrites += count;
+	else
+	    stats->numDiskCacheHits += count;
+	command->platter = FALSE;
+	command->done = now + count * DiskCacheTime;
+	Finish(command);
+    } else if (!platterBusy)
+	Start(command, max(now, platterFree));
+    else {
+	for (link = &waiting; *link != NULL; link = &(*link)->next)
+	    ;
+	*link = command;
+    }
+}
+
+//----------------------------------------------------------------------
+// Disk::Start
+// 	Start a request on the platter at time "when", adding up how
+//	long it takes, and schedule its interrupt.
+//
+//	Each sector's latency is computed from where the head will be
+//	once the sectors in front of it are done, so a sector that follows
+//	right behind the previous one costs only its transfer time.
+//	Sectors already in the drive's memory cost DiskCacheTime.  A
+//	write that does not fit in the write cache first waits for
+//	enough of the cache to be written to the platter; one bigger
+//	than the whole cache goes straight to the platter, and any of
+//	its sectors in the cache are dropped from there.
+//----------------------------------------------------------------------
+
+void
+Disk::Start(DiskCommand *command, int when)
+{
+    int i, j, sector;
+
+    command->platter = TRUE;
+    platterBusy = TRUE;
+    readingAhead = FALSE;
+    if (command->writing && model.cacheSectors > 0
+		&& command->count > model.cacheSectors)
+	for (i = 0; i < command->count; i++)
+	    for (j = 0; j < numDirty; j++)
+		if (dirty[j] == command->sectors[i])
+		    dirty[j--] = dirty[--numDirty];
+
+    if (command->writing && command->count <= model.cacheSectors) {
+	while (numDirty + command->count > model.cacheSectors)
+	    when = Destage(when);	// may take some of ours, too
+	for (i = 0; i < command->count; i++)
+	    if (!Dirty(command->sectors[i]))
+		dirty[numDirty++] = command->sectors[i];
+	when += command->count * DiskCacheTime;
+	stats->numDiskCachedWrites += command->count;
+    } else {
+	for (i = 0; i < command->count; i++) {
+	    sector = command->sectors[i];
+	    if (!command->writing && Cached(sector)) {
+		when += DiskCacheTime;
+		stats->numDiskCacheHits++;
+		continue;
+	    }
+	    if (!command->writing && InTrackBuffer(sector, when))
+		stats->numTrackBufferHits++;
+	    int latency = Latency(sector, command->writing, when);
+
+	    UpdateLast(sector, when);
+	    when += latency;
+	}
+	if (!command->writing && model.readAhead) {
+	    readingAhead = TRUE;	// once the interrupt is taken
+	    aheadFirst = command->sectors[command->count - 1] + 1;
+	    aheadCount = 0;
+	}
+    }
+    platterFree = when;
+    command->done = when;
+    Finish(command);
+}
+
+//----------------------------------------------------------------------
+// Disk::Finish
+// 	Schedule the interrupt for a request, once we know when it will
+//	be done.  Requests are kept in the order their interrupts will
+//	come, so HandleInterrupt knows which one has finished.
+//----------------------------------------------------------------------
+
+void
+Disk::Finish(DiskCommand *command)
+{
+    DiskCommand **link;
+
+    for (link = &running; *link != NULL && (*link)->done <= command->done;
+						link = &(*link)->next)
+	;
+    command->next = *link;
+    *link = command;
+    interrupt->Schedule(DiskDone, (int) this,
+	command->done - stats->totalTicks, DiskInt);
+}
+
+//----------------------------------------------------------------------
+// Disk::CatchUp
+// 	Work out what the drive did with the platter while it had no
+//	request to work on, up until "now": first reading ahead, after
+//	a read, and then writing the write cache to the platter.  A
+//	sector being read ahead when a request comes in is abandoned;
+//	one being written from the cache is finished first, so the
+//	platter may not be free until a little after "now".
+//----------------------------------------------------------------------
+
+void
+Disk::CatchUp(int now)
+{
+    int when = platterFree, sector, latency;
+
+    if (platterBusy || when >= now)
+	return;
+    while (readingAhead) {
+	sector = aheadFirst + aheadCount;
+	if (aheadCount == sectorsPerTrack || sector >= numSectors) {
+	    readingAhead = FALSE;	// read a track's worth; stop
+	    break;
+	}
+	latency = Latency(sector, FALSE, when);
+	if (when + latency > now)
+	    break;
+	UpdateLast(sector, when);
+	when += latency;
+	aheadCount++;
+    }
+    if (!readingAhead)
+	while (numDirty > 0 && when < now)
+	    when = Destage(when);
+    platterFree = when;
+}
+
+//----------------------------------------------------------------------
+// Disk::Destage
+// 	Write one sector from the write cache to the platter, starting
+//	at time "when": whichever can be got to soonest.  Return when it
+//	is done.
+//----------------------------------------------------------------------
+
+int
+Disk::Destage(int when)
+{
+    int i, best = 0, latency, bestLatency = 0;
+
+    ASSERT(numDirty > 0);
+    for (i = 0; i < numDirty; i++) {
+	latency = Latency(dirty[i], TRUE, when);
+	if (i == 0 || latency < bestLatency) {
+	    best = i;
+	    bestLatency = latency;
+	}
+    }
+    DEBUG('d', "Writing cached sector %d to the platter\n", dirty[best]);
+    UpdateLast(dirty[best], when);
+    dirty[best] = dirty[--numDirty];
+    stats->numDiskDestages++;
+    return when + bestLatency;
+}
+
+//----------------------------------------------------------------------
+// Disk::Dirty/Cached
+// 	Return TRUE if "sector" is in the write cache, or in the drive's
+//	memory at all: the write cache, or the sectors read ahead.
+//----------------------------------------------------------------------
+
+bool
+Disk::Dirty(int sector)
+{
+    for (int i = 0; i < numDirty; i++)
+	if (dirty[i] == sector)
+	    return TRUE;
+    return FALSE;
+}
+
+bool
+Disk::Cached(int sector)
+{
+    return Dirty(sector)
+	|| ((sector >= aheadFirst) && (sector < aheadFirst + aheadCount));
+}
+
+//----------------------------------------------------------------------
+// Disk::CrashAfter
+// 	Simulate the power failing part way through whatever the disk
+//	is doing: once "numWrites" more sectors have been written, every
+//	later write is silently thrown away.  The requests still take as
+//	long as usual, and still complete.  Used to test how well the file
+//	system recovers from a crash.
+//
+//	"numWrites" -- sectors to write before the crash, or -1 to
+//		write everything from now on
+//----------------------------------------------------------------------
+
+void
+Disk::CrashAfter(int numWrites)
+{
+    writesLeft = numWrites;
 }
 
 //----------------------------------------------------------------------
 // Disk::HandleInterrupt()
 // 	Called when it is time to invoke the disk interrupt handler,
-//	to tell the Nachos kernel that the disk request is done.
+//	to tell the Nachos kernel that the disk request is done.  If the
+//	request was using the platter, start on whichever waiting
+//	request the head can get to soonest.
 //----------------------------------------------------------------------
 
 void
 Disk::HandleInterrupt ()
 { 
-    active = FALSE;
+    DiskCommand *command = running, **link, **best;
+    int latency, bestLatency = 0;
+
+    ASSERT(command != NULL && command->done == stats->totalTicks);
+    running = command->next;
+    outstanding--;
+    stats->RecordDiskLatency(command->writing,
+	stats->totalTicks - command->made);
+
+    if (command->platter) {		// start on the next request
+	platterBusy = FALSE;
+	best = NULL;
+	for (link = &waiting; *link != NULL; link = &(*link)->next) {
+	    latency = Latency((*link)->sectors[0], (*link)->writing,
+		stats->totalTicks);
+	    if (best == NULL || latency < bestLatency) {
+		best = link;
+		bestLatency = latency;
+	    }
+	}
+	if (best != NULL) {
+	    DiskCommand *next = *best;
+
+	    *best = next->next;
+	    Start(next, stats->totalTicks);
+	}
+    }
+
+    lastDone = command->sectors;
+    delete command;
     (*handler)(handlerArg);
 }
 
 //----------------------------------------------------------------------
 // Disk::TimeToSeek()
-//	Returns how long it will take to position the disk head over the correct
-//	track on the disk.  Since when we finish seeking, we are likely
+//	Returns how long it will take, starting at time "when", to position
+//	the disk head over the correct track on the disk.  Since when we finish seeking, we are likely
 //	to be in the middle of a sector that is rotating past the head,
 //	we also return how long until the head is at the next sector boundary.
 //	
@@ -177,13 +552,13 @@ Disk::HandleInterrupt ()
 //----------------------------------------------------------------------
 
 int
-Disk::TimeToSeek(int newSector, int *rotation) 
+Disk::TimeToSeek(int newSector, int *rotation, int when)
 {
-    int newTrack = newSector / SectorsPerTrack;
-    int oldTrack = lastSector / SectorsPerTrack;
+    int newTrack = newSector / sectorsPerTrack;
+    int oldTrack = lastSector / sectorsPerTrack;
     int seek = abs(newTrack - oldTrack) * SeekTime;
 				// how long will seek take?
-    int over = (stats->totalTicks + seek) % RotationTime; 
+    int over = (when + seek) % RotationTime;
 				// will we be in the middle of a sector when
 				// we finish the seek?
 
@@ -202,10 +577,10 @@ Disk::TimeToSeek(int newSector, int *rotation)
 int 
 Disk::ModuloDiff(int to, int from)
 {
-    int toOffset = to % SectorsPerTrack;
-    int fromOffset = from % SectorsPerTrack;
+    int toOffset = to % sectorsPerTrack;
+    int fromOffset = from % sectorsPerTrack;
 
-    return ((toOffset - fromOffset) + SectorsPerTrack) % SectorsPerTrack;
+    return ((toOffset - fromOffset) + sectorsPerTrack) % sectorsPerTrack;
 }
 
 //----------------------------------------------------------------------
@@ -231,20 +606,59 @@ Disk::ModuloDiff(int to, int from)
 
 int
 Disk::ComputeLatency(int newSector, bool writing)
+{
+    return Latency(newSector, writing, stats->totalTicks);
+}
+
+//----------------------------------------------------------------------
+// Disk::EstimateTime()
+// 	Return how long it would take to read "sectors", in order, as a
+//	single request, if the head had just arrived over the first of
+//	them.  Starting there, rather than wherever the disk happens to
+//	be, leaves out the rotational delay every layout pays alike.
+//	Nothing is read, and the disk is left as it was; used to judge
+//	how well a file is laid out.
+//----------------------------------------------------------------------
+
+int
+Disk::EstimateTime(int *sectors, int count)
+{
+    int savedLast = lastSector, savedInit = bufferInit;
+    int start = (sectors[0] % sectorsPerTrack) * RotationTime;
+    int when = start;
+
+    lastSector = sectors[0];
+    bufferInit = start;
+    for (int i = 0; i < count; i++) {
+	int latency = Latency(sectors[i], FALSE, when);
+
+	UpdateLast(sectors[i], when);
+	when += latency;
+    }
+    lastSector = savedLast;
+    bufferInit = savedInit;
+    return when - start;
+}
+
+//----------------------------------------------------------------------
+// Disk::Latency()
+// 	Return how long it will take to read/write a disk sector, if
+//	we start at time "when" (which may be later than now, if the
+//	sector is part of a longer request).  See ComputeLatency.
+//----------------------------------------------------------------------
+
+int
+Disk::Latency(int newSector, bool writing, int when)
 {
     int rotation;
-    int seek = TimeToSeek(newSector, &rotation);
-    int timeAfter = stats->totalTicks + seek + rotation;
+    int seek = TimeToSeek(newSector, &rotation, when);
+    int timeAfter = when + seek + rotation;
 
-#ifndef NOTRACKBUF	// turn this on if you don't want the track buffer stuff
     // check if track buffer applies
-    if ((writing == FALSE) && (seek == 0) 
-		&& (((timeAfter - bufferInit) / RotationTime) 
-	     		> ModuloDiff(newSector, bufferInit / RotationTime))) {
+    if ((writing == FALSE) && InTrackBuffer(newSector, when)) {
         DEBUG('d', "Request latency = %d\n", RotationTime);
 	return RotationTime; // time to transfer sector from the track buffer
     }
-#endif
 
     rotation += ModuloDiff(newSector, timeAfter / RotationTime) * RotationTime;
 
@@ -252,20 +666,42 @@ Disk::ComputeLatency(int newSector, bool writing)
     return(seek + rotation + RotationTime);
 }
 
+//----------------------------------------------------------------------
+// Disk::InTrackBuffer
+// 	Return TRUE if "newSector" will be in the track buffer at time
+//	"when": it is on the track the head is over, and has gone by
+//	since the head got there.
+//----------------------------------------------------------------------
+
+bool
+Disk::InTrackBuffer(int newSector, int when)
+{
+#ifndef NOTRACKBUF	// turn this on if you don't want the track buffer stuff
+    int rotation;
+    int seek = TimeToSeek(newSector, &rotation, when);
+    int timeAfter = when + seek + rotation;
+
+    return (seek == 0) && (((timeAfter - bufferInit) / RotationTime)
+	     		> ModuloDiff(newSector, bufferInit / RotationTime));
+#else
+    return FALSE;
+#endif
+}
+
 //----------------------------------------------------------------------
 // Disk::UpdateLast
-//   	Keep track of the most recently requested sector.  So we can know
-//	what is in the track buffer.
+//   	Keep track of the most recently requested sector, whose transfer
+//	starts at time "when".  So we can know what is in the track buffer.
 //----------------------------------------------------------------------
 
 void
-Disk::UpdateLast(int newSector)
+Disk::UpdateLast(int newSector, int when)
 {
     int rotate;
-    int seek = TimeToSeek(newSector, &rotate);
+    int seek = TimeToSeek(newSector, &rotate, when);
     
     if (seek != 0)
-	bufferInit = stats->totalTicks + seek + rotate;
+	bufferInit = when + seek + rotate;
     lastSector = newSector;
     DEBUG('d', "Updating last sector = %d, %d\n", lastSector, bufferInit);
 }
@@ -26,13 +26,21 @@
 // sector has the same number of bytes of storage).  
 //
 // Addressing is by sector number -- each sector on the disk is given
-// a unique number: track * SectorsPerTrack + offset within a track.
+// a unique number: track * SectorsPerTrack() + offset within a track.
+//
+// The number of tracks, and of sectors per track, can be chosen
+// when the disk is made, and are kept in the UNIX file with the data.
+// The sector size is fixed: a sector holds one page of memory, and
+// the file system lays its structures out in sectors.
 //
 // As with other I/O devices, the raw physical disk is an asynchronous device --
 // requests to read or write portions of the disk return immediately,
 // and an interrupt is invoked later to signal that the operation completed.
 //
 // The physical disk is in fact simulated via operations on a UNIX file.
+// Normally each request reads or writes the file; the file can instead
+// be mapped into memory once, so that each sector is just copied (see
+// DiskBacking below).  Either way the simulated timing is the same.
 //
 // To make life a little more realistic, the simulated time for
 // each operation reflects a "track buffer" -- RAM to store the contents
@@ -45,17 +53,100 @@
 // disks these days now come with a track buffer.
 //
 // The track buffer simulation can be disabled by compiling with -DNOTRACKBUF
+//
+// A single request may also name a list of sectors, each with its own
+// buffer in memory (scatter/gather).  The disk works through the list
+// in order without interrupting the CPU in between, so a run of
+// consecutive sectors streams off the track at one sector per
+// RotationTime, and only one interrupt is taken for the whole request.
+//
+// The drive can also be made to behave more like a modern one (see
+// DiskModel below):
+//
+//   - With a write cache, a write completes as soon as its sectors are
+//     in the drive's memory; the drive writes them to the platter when
+//     it has nothing else to do, nearest sector first, or when it
+//     needs room for another write.  The cache is taken to survive
+//     a crash.
+//   - With read-ahead, once a read is done the drive goes on reading
+//     the sectors after it, up to a track's worth, until the next
+//     request comes in.
+//   - With command queueing, the drive accepts several requests at
+//     once, and does them in whatever order gets to each soonest.
+//     Each request gets its own interrupt.  The data moves in the
+//     order the requests were made; only the timing is reordered.
+//
+// Reads from the drive's memory take DiskCacheTime per sector.  How
+// long each request took, from when it was made to its interrupt, is
+// kept in a histogram (see stats.h).
 
 #define SectorSize 		128	// number of bytes per disk sector
-#define SectorsPerTrack 	32	// number of sectors per disk track 
-#define NumTracks 		32	// number of tracks per disk
-#define NumSectors 		(SectorsPerTrack * NumTracks)
-					// total # of sectors per disk
+#define DefaultSectorsPerTrack 	32	// geometry of a new disk, unless
+#define DefaultNumTracks	32	//  asked for otherwise
+
+// The UNIX file holding the disk starts with a DiskLabel, followed by
+// the contents of each sector in order.  The magic number at the front
+// makes it less likely we will accidentally treat a useful file as a
+// disk (which would probably trash the file's contents).  Disks made
+// before the geometry was recorded start with just OldMagicNumber, and
+// have the default geometry.
+#define MagicNumber 		0x456789ac
+#define OldMagicNumber 		0x456789ab
+#define MagicSize 		sizeof(int)
+
+class DiskLabel {
+  public:
+    int magic;				// MagicNumber
+    int sectorsPerTrack;		// Geometry of the disk
+    int numTracks;
+};
+
+// How the disk keeps its contents in the UNIX file.
+enum DiskBacking {
+    DiskFile,			// Lseek, then read or write, per request
+    DiskMapped,			// Map the file, and copy sectors in and
+				//  out; UNIX writes the file back when it
+				//  likes, and when Nachos exits
+    DiskMappedSync		// Map the file, and msync every write
+				//  request, so that it is in the file
+				//  before the request completes
+};
+
+// How the drive behaves, beyond the mechanics of the platter.  The
+// default is the plain disk described above.
+
+class DiskModel {
+  public:
+    DiskModel() { cacheSectors = 0; readAhead = FALSE; queueDepth = 1; }
+
+    int cacheSectors;			// Size of the write cache, in sectors;
+					//  0 to write through to the platter
+    bool readAhead;			// Read on after each read, while idle?
+    int queueDepth;			// Most requests accepted at once
+};
+
+// A request the drive has accepted.  Internal to the Disk.
+
+class DiskCommand {
+  public:
+    int *sectors;			// Sectors to read or write
+    int count;
+    bool writing;
+    int made;				// When the request was made
+    int done;				// When it completes, once started
+    bool platter;			// Does it use the platter, or only
+					//  the drive's memory?
+    DiskCommand *next;
+};
 
 class Disk {
   public:
-    Disk(char* name, VoidFunctionPtr callWhenDone, int callArg);
-    					// Create a simulated disk.  
+    Disk(char* name, VoidFunctionPtr callWhenDone, int callArg,
+		DiskBacking diskBacking, int newSectorsPerTrack,
+		int newNumTracks);
+    					// Create a simulated disk, with
+					// the new geometry if the file
+					// doesn't exist yet.
 					// Invoke (*callWhenDone)(callArg) 
 					// every time a request completes.
     ~Disk();				// Deallocate the disk.
@@ -64,9 +155,27 @@ class Disk {
     					// Read/write an single disk sector.
 					// These routines send a request to 
     					// the disk and return immediately.
-    					// Only one request allowed at a time!
+    					// Only QueueDepth() requests at a time!
     void WriteRequest(int sectorNumber, char* data);
 
+    void ReadvRequest(int *sectors, char **data, int count);
+    					// Read/write "count" disk sectors,
+					// sectors[i] to/from data[i], as
+					// one request.
+    void WritevRequest(int *sectors, char **data, int count);
+
+    void SetModel(DiskModel *newModel);	// Change how the drive behaves;
+					// only while it is idle
+    int QueueDepth() { return model.queueDepth; }
+					// Requests allowed at a time
+    int *LastDone() { return lastDone; }
+					// The sector list of the request
+					// whose interrupt is being handled
+
+    void CrashAfter(int numWrites);	// Throw away every write after the
+					// next "numWrites" sectors, as if the
+					// power failed; -1 to stop
+
     void HandleInterrupt();		// Interrupt handler, invoked when
 					// disk request finishes.
 
@@ -74,20 +183,67 @@ class Disk {
     					// Return how long a request to 
 					// newSector will take: 
 					// (seek + rotational delay + transfer)
+    int EstimateTime(int *sectors, int count);
+					// How long one request to read these
+					// sectors would take, with the head
+					// starting over the first of them
+
+    int SectorsPerTrack() { return sectorsPerTrack; }
+    int NumTracks() { return numTracks; }
+    int NumSectors() { return numSectors; }
+    int SectorOffset(int sector)	// Where "sector" is in the file
+	{ return dataOffset + sector * SectorSize; }
+    int FileSize() { return SectorOffset(numSectors); }
 
   private:
     int fileno;				// UNIX file number for simulated disk 
+    DiskBacking backing;		// How requests get to the file
+    char *image;			// The file in memory, if mapped
+    int sectorsPerTrack;		// Geometry, from the DiskLabel
+    int numTracks;
+    int numSectors;			// sectorsPerTrack * numTracks
+    int dataOffset;			// Where sector 0 is in the file
     VoidFunctionPtr handler;		// Interrupt handler, to be invoked 
 					// when any disk request finishes
     int handlerArg;			// Argument to interrupt handler 
-    bool active;     			// Is a disk operation in progress?
     int lastSector;			// The previous disk request 
     int bufferInit;			// When the track buffer started 
 					// being loaded
+    int writesLeft;			// Sectors to write before the
+					// simulated crash, -1 if none
+
+    DiskModel model;			// How the drive behaves
+    int outstanding;			// Requests accepted, not yet done
+    DiskCommand *waiting;		// Waiting for the platter
+    DiskCommand *running;		// Started, in order of completion
+    int *lastDone;			// Sectors of the last one to finish
+    bool platterBusy;			// Is a request using the platter?
+    int platterFree;			// When it finishes what it is doing
+    int *dirty;				// Sectors in the write cache, not
+    int numDirty;			//  yet on the platter
+    bool readingAhead;			// Reading on after a read?
+    int aheadFirst;			// Sectors [aheadFirst, aheadFirst +
+    int aheadCount;			//  aheadCount) have been read ahead
 
-    int TimeToSeek(int newSector, int *rotate); // time to get to the new track
+    void Transfer(int *sectors, char **data, int count, bool writing);
+					// Do a read or write request
+    void Start(DiskCommand *command, int when);
+					// Put the request on the platter
+    void Finish(DiskCommand *command);	// Schedule its interrupt
+    void CatchUp(int now);		// Do what the drive did while idle
+    int Destage(int when);		// Write one cached sector to the
+					// platter, and return when it's done
+    bool Dirty(int sector);		// Is it in the write cache?
+    bool Cached(int sector);		// Is it in the drive's memory?
+    bool InTrackBuffer(int newSector, int when);
+					// Is it in the track buffer?
+    int Latency(int newSector, bool writing, int when);
+					// ComputeLatency, for a request
+					// starting at time "when"
+    int TimeToSeek(int newSector, int *rotate, int when);
+					// time to get to the new track
     int ModuloDiff(int to, int from);        // # sectors between to and from
-    void UpdateLast(int newSector);
+    void UpdateLast(int newSector, int when);
 };
 
 #endif // DISK_H
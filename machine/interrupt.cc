@@ -14,6 +14,16 @@
 //		a user instruction is executed
 //		there is nothing in the ready queue
 //
+//	Input from outside -- typing at the console, packets from other
+//	Nachos -- is not polled for by each device.  Instead, the devices
+//	ask us to watch their UNIX files, and we check them all at once,
+//	every HostInputTicks while the machine is busy.  When it is idle
+//	with nothing else to wait for, we wait for input in the host, not
+//	spinning, and then jump the clock forward to it.  Nor, while
+//	idle, do we go back to the scheduler for every timer interrupt:
+//	we run them one after the other, until the next interrupt that
+//	matters (see SkipTimer).
+//
 //  DO NOT CHANGE -- part of the machine emulation
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
@@ -28,7 +38,8 @@
 
 static char *intLevelNames[] = { "off", "on"};
 static char *intTypeNames[] = { "timer", "disk", "console write", 
-			"console read", "network send", "network recv"};
+			"console read", "elevator", "network send",
+			"network recv"};
 
 //----------------------------------------------------------------------
 // PendingInterrupt::PendingInterrupt
@@ -64,6 +75,8 @@ Interrupt::Interrupt()
     inHandler = FALSE;
     yieldOnReturn = FALSE;
     status = SystemMode;
+    numInputs = 0;
+    nextInputCheck = 0;
 }
 
 //----------------------------------------------------------------------
@@ -166,6 +179,10 @@ Interrupt::OneTick()
     ChangeLevel(IntOn, IntOff);		// first, turn off interrupts
 					// (interrupt handlers run with
 					// interrupts disabled)
+    if (numInputs > 0 && stats->totalTicks >= nextInputCheck) {
+	nextInputCheck = stats->totalTicks + HostInputTicks;
+	CheckInput(FALSE);		// any input from outside?
+    }
     while (CheckIfDue(FALSE))		// check for pending interrupts
 	;
     ChangeLevel(IntOff, IntOn);		// re-enable interrupts
@@ -204,6 +221,11 @@ Interrupt::YieldOnReturn()
 //	on the ready queue, the only thing to do is to advance 
 //	simulated time until the next scheduled hardware interrupt.
 //
+//	If nothing is scheduled, but a device is waiting for input from
+//	outside, wait (in the host) for the input to arrive; its interrupt
+//	is then the next one.  Timer interrupts that come first are run
+//	right here, without returning to the scheduler each time.
+//
 //	If there are no pending interrupts, stop.  There's nothing
 //	more for us to do.
 //----------------------------------------------------------------------
@@ -212,6 +234,8 @@ Interrupt::Idle()
 {
     DEBUG('i', "Machine idling; checking for interrupts.\n");
     status = IdleMode;
+    CheckInput(NothingPending());
+    SkipTimer();
     if (CheckIfDue(TRUE)) {		// check for any pending interrupts
     	while (CheckIfDue(FALSE))	// check for any other pending 
 	    ;				// interrupts
@@ -224,8 +248,9 @@ Interrupt::Idle()
 
     // if there are no pending interrupts, and nothing is on the ready
     // queue, it is time to stop.   If the console or the network is 
-    // operating, there are *always* pending interrupts, so this code
-    // is not reached.  Instead, the halt must be invoked by the user program.
+    // waiting for input, we wait with it, so this code is not reached
+    // (unless the console input reaches the end of its file).  Instead,
+    // the halt must be invoked by the user program.
 
     DEBUG('i', "Machine idle.  No interrupts to do.\n");
     printf("No threads ready or runnable, and no pending interrupts.\n");
@@ -335,6 +360,133 @@ Interrupt::CheckIfDue(bool advanceClock)
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// Interrupt::WatchInput
+// 	Arrange for an interrupt to occur as soon as there is input to
+//	read on the UNIX file "fd".  Only once: the device calls this
+//	again when it is ready for the next input.
+//
+//	NOTE: like Schedule, this is only called by the hardware device
+//	simulators.
+//
+//	"handler", "arg", "type" -- as for Schedule
+//	"delay" -- how long after the input is seen the interrupt occurs
+//----------------------------------------------------------------------
+
+void
+Interrupt::WatchInput(int fd, VoidFunctionPtr handler, int arg, int delay,
+			IntType type)
+{
+    HostInput *input = &inputs[numInputs++];
+
+    ASSERT(numInputs <= MaxHostInputs && delay > 0);
+    input->fd = fd;
+    input->handler = handler;
+    input->arg = arg;
+    input->delay = delay;
+    input->type = type;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::IgnoreInput
+// 	Stop watching "fd" for input, if we are; the device is going away.
+//----------------------------------------------------------------------
+
+void
+Interrupt::IgnoreInput(int fd)
+{
+    for (int i = 0; i < numInputs; i++)
+	if (inputs[i].fd == fd)
+	    inputs[i--] = inputs[--numInputs];
+}
+
+//----------------------------------------------------------------------
+// Interrupt::CheckInput
+// 	Check every watched file for input, with a single call to the
+//	host, and schedule the interrupt for each one that has some.  It
+//	is not watched again until its device asks.
+//
+//	"wait" -- if TRUE, and none of them has input yet, wait until one
+//		does
+//----------------------------------------------------------------------
+
+void
+Interrupt::CheckInput(bool wait)
+{
+    int fds[MaxHostInputs];
+    bool ready[MaxHostInputs];
+    int i, n = numInputs, millis;
+
+    if (n == 0)
+	return;
+    for (i = 0; i < n; i++)
+	fds[i] = inputs[i].fd;
+    millis = HostMilliseconds();
+    i = PollFiles(fds, ready, n, wait);
+    if (wait)
+	stats->hostIdleMillis += HostMilliseconds() - millis;
+    if (i == 0)
+	return;
+
+    for (i = n - 1; i >= 0; i--)		// from the end, since
+	if (ready[i]) {				//  we move the last one
+	    DEBUG('i', "Input on file %d\n", inputs[i].fd);
+	    Schedule(inputs[i].handler, inputs[i].arg, inputs[i].delay,
+		inputs[i].type);
+	    inputs[i] = inputs[--numInputs];
+	}
+}
+
+//----------------------------------------------------------------------
+// Interrupt::NothingPending
+// 	Return TRUE if no interrupt is scheduled, except perhaps the
+//	timer's, which doesn't count: on its own, it would just go on
+//	forever.
+//----------------------------------------------------------------------
+
+bool
+Interrupt::NothingPending()
+{
+    PendingInterrupt *first = (PendingInterrupt *)pending->SortedFirst(NULL);
+
+    return (first == NULL)
+	|| ((first->type == TimerInt) && (pending->NumInList() == 1));
+}
+
+//----------------------------------------------------------------------
+// Interrupt::SkipTimer
+// 	Called when the machine is idle.  So long as the next interrupt
+//	is the timer's, and something else is due after it, run the
+//	timer's interrupt now, advancing the clock to it.  With no thread
+//	to run, a time slice ending changes nothing, so there is no need
+//	to go back to the scheduler and idle again between them; we stop
+//	if one does make a thread ready to run, all the same.
+//
+//	The timer's handler still runs each time, so that it takes the
+//	same random time slices as it would have.
+//----------------------------------------------------------------------
+
+void
+Interrupt::SkipTimer()
+{
+    PendingInterrupt *first;
+
+    for (;;) {
+	first = (PendingInterrupt *)pending->SortedFirst(NULL);
+	if (first == NULL || first->type != TimerInt || NothingPending()
+		|| !scheduler->IsEmpty())
+	    return;
+	CheckIfDue(TRUE);
+	yieldOnReturn = FALSE;		// nothing to yield to
+	status = IdleMode;
+	stats->numIdleSkips++;
+	if (numInputs > 0 && stats->totalTicks >= nextInputCheck) {
+	    nextInputCheck = stats->totalTicks + HostInputTicks;
+	    CheckInput(FALSE);		// as often as when busy
+	}
+    }
+}
+
 //----------------------------------------------------------------------
 // PrintPending
 // 	Print information about an interrupt that is scheduled to occur.
@@ -69,6 +69,22 @@ class PendingInterrupt {
     IntType type;		// for debugging
 };
 
+// A UNIX file (or socket) that a device is waiting for input on.
+// Rather than the device polling it, the interrupt simulation checks
+// all of them at once, and schedules the device's interrupt once
+// there is something to read.  Internal to the Interrupt.
+
+class HostInput {
+  public:
+    int fd;			// The UNIX file to watch
+    VoidFunctionPtr handler;	// The interrupt to schedule once it has
+    int arg;			//  input
+    int delay;			// ... this long after the input is seen
+    IntType type;
+};
+
+#define MaxHostInputs	8	// files that can be watched at once
+
 // The following class defines the data structures for the simulation
 // of hardware interrupts.  We record whether interrupts are enabled
 // or disabled, and any hardware interrupts that are scheduled to occur
@@ -112,6 +128,13 @@ class Interrupt {
     
     void OneTick();       		// Advance simulated time
 
+    void WatchInput(int fd, VoidFunctionPtr handler, int arg, int delay,
+	IntType type);			// Schedule "handler", once, as soon
+					// as there is input on "fd"; the
+					// device calls this again when it
+					// is ready for more
+    void IgnoreInput(int fd);		// Stop watching "fd"
+
   private:
     IntStatus level;		// are interrupts enabled or disabled?
     List *pending;		// the list of interrupts scheduled
@@ -120,6 +143,9 @@ class Interrupt {
     bool yieldOnReturn; 	// TRUE if we are to context switch
 				// on return from the interrupt handler
     MachineStatus status;	// idle, kernel mode, user mode
+    HostInput inputs[MaxHostInputs]; // files being watched for input
+    int numInputs;
+    int nextInputCheck;		// when a busy machine next checks them
 
     // these functions are internal to the interrupt simulation code
 
@@ -128,6 +154,15 @@ class Interrupt {
 
     void ChangeLevel(IntStatus old, 	// SetLevel, without advancing the
 	IntStatus now);  		// simulated time
+
+    void CheckInput(bool wait);		// Schedule the interrupts for the
+					// watched files that have input;
+					// if "wait", wait until one does
+    bool NothingPending();		// Is nothing scheduled to happen,
+					// except maybe the timer?
+    void SkipTimer();			// While idle, run the timer's
+					// interrupts until something else
+					// is next
 };
 
 #endif // INTERRRUPT_H
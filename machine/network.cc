@@ -2,6 +2,10 @@
 //	Routines to simulate a network interface, using UNIX sockets
 //	to deliver packets between multiple invocations of nachos.
 //
+//	Rather than poll the socket every NetworkTime, the network has
+//	the interrupt simulation watch it (see Interrupt::WatchInput),
+//	whenever there is room in the receive ring for the next packet.
+//
 //  DO NOT CHANGE -- part of the machine emulation
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
@@ -24,82 +28,125 @@ static void NetworkSendDone(int arg)
 //   addr is used to generate the socket name
 //   reliability says whether we drop packets to emulate unreliable links
 //   readAvail, writeDone, callArg -- analogous to console
+//   newRingSize is how many packets each way can be in the device at once
 Network::Network(NetworkAddress addr, double reliability,
-	VoidFunctionPtr readAvail, VoidFunctionPtr writeDone, int callArg)
+	VoidFunctionPtr readAvail, VoidFunctionPtr writeDone, int callArg,
+	int newRingSize)
 {
     ident = addr;
     if (reliability < 0) chanceToWork = 0;
     else if (reliability > 1) chanceToWork = 1;
     else chanceToWork = reliability;
+    ASSERT(newRingSize > 0 && newRingSize <= MaxNetworkRing);
+    ringSize = newRingSize;
 
     // set up the stuff to emulate asynchronous interrupts
     writeHandler = writeDone;
     readHandler = readAvail;
     handlerArg = callArg;
-    sendBusy = FALSE;
-    inHdr.length = 0;
+    sendHead = sendCount = numSendsDone = 0;
+    wireFree = 0;
+    sendInterrupt = FALSE;
+    inHead = inCount = 0;
     
     sock = OpenSocket();
     sprintf(sockName, "SOCKET_%d", (int)addr);
     AssignNameToSocket(sockName, sock);		 // Bind socket to a filename 
 						 // in the current directory.
 
-    // start polling for incoming packets
-    interrupt->Schedule(NetworkReadPoll, (int)this, NetworkTime, NetworkRecvInt);
+    // start watching for incoming packets
+    interrupt->WatchInput(sock, NetworkReadPoll, (int)this, NetworkTime,
+			NetworkRecvInt);
+    watching = TRUE;
 }
 
 Network::~Network()
 {
+    interrupt->IgnoreInput(sock);
     CloseSocket(sock);
     DeAssignNameToSocket(sockName);
 }
 
-// if a packet is already buffered, we simply delay reading 
-// the incoming packet.  In real life, the incoming 
-// packet might be dropped if we can't read it in time.
+// called once a packet has arrived.  We are only told when there is
+// room in the receive ring; we take in every packet that is waiting,
+// until the ring is full, and tell the post office about them all at
+// once.  Any left over are delayed until there is room.  In real life,
+// they might be dropped if we can't read them in time.
 void
 Network::CheckPktAvail()
 {
-    // schedule the next time to poll for a packet
-    interrupt->Schedule(NetworkReadPoll, (int)this, NetworkTime, NetworkRecvInt);
-
-    if (inHdr.length != 0) 	// do nothing if packet is already buffered
-	return;		
-    if (!PollSocket(sock)) 	// do nothing if no packet to be read
-	return;
-
-    // otherwise, read packet in
-    char *buffer = new char[MaxWireSize];
-    ReadFromSocket(sock, buffer, MaxWireSize);
-
-    // divide packet into header and data
-    inHdr = *(PacketHeader *)buffer;
-    ASSERT((inHdr.to == ident) && (inHdr.length <= MaxPacketSize));
-    bcopy(buffer + sizeof(PacketHeader), inbox, inHdr.length);
-    delete []buffer ;
-
-    DEBUG('n', "Network received packet from %d, length %d...\n",
-	  				(int) inHdr.from, inHdr.length);
-    stats->numPacketsRecvd++;
+    int size, slot;
+
+    ASSERT(inCount < ringSize);
+    watching = FALSE;
+    do {
+	// read the packet in, header and data straight into the ring
+	slot = (inHead + inCount) % ringSize;
+	size = ReadvFromSocket(sock, (char *) &inHdr[slot],
+			sizeof(PacketHeader), inbox[slot], MaxPacketSize);
+	ASSERT((inHdr[slot].to == ident)
+		&& (inHdr[slot].length <= MaxPacketSize)
+		&& (size == (int) (sizeof(PacketHeader)
+					+ inHdr[slot].length)));
+	inCount++;
+
+	DEBUG('n', "Network received packet from %d, length %d...\n",
+	  		(int) inHdr[slot].from, inHdr[slot].length);
+	stats->numPacketsRecvd++;
+	stats->numNetworkBytesRecvd += size;
+    } while (inCount < ringSize && PollSocket(sock));
+    stats->numNetworkInterrupts++;
+
+    if (inCount < ringSize) {		// room for more
+	interrupt->WatchInput(sock, NetworkReadPoll, (int)this, NetworkTime,
+			NetworkRecvInt);
+	watching = TRUE;
+    }
 
-    // tell post office that the packet has arrived
+    // tell post office that the packets have arrived
     (*readHandler)(handlerArg);	
 }
 
-// notify user that another packet can be sent
+// take the packets that have gone out on the wire off the send ring,
+// and notify user that that many more packets can be sent
 void
 Network::SendDone()
 {
-    sendBusy = FALSE;
-    stats->numPacketsSent++;
+    sendInterrupt = FALSE;
+    numSendsDone = 0;
+    while (sendCount > 0 && sendDone[sendHead] <= stats->totalTicks) {
+	sendHead = (sendHead + 1) % ringSize;
+	sendCount--;
+	numSendsDone++;
+    }
+    stats->numPacketsSent += numSendsDone;
+    stats->numNetworkInterrupts++;
+    if (sendCount > 0)
+	ScheduleSendDone();
     (*writeHandler)(handlerArg);
 }
 
-// send a packet by concatenating hdr and data, and schedule
+// schedule the interrupt for when half a ring of the packets now being
+// sent are done, or all of them if there are fewer
+void
+Network::ScheduleSendDone()
+{
+    int batch = min(sendCount, max(ringSize / 2, 1));
+    int when = sendDone[(sendHead + batch - 1) % ringSize];
+
+    interrupt->Schedule(NetworkSendDone, (int)this, when - stats->totalTicks,
+			NetworkSendInt);
+    sendInterrupt = TRUE;
+}
+
+// send a packet made of hdr and data, and schedule
 // an interrupt to tell the user when the next packet can be sent 
 //
-// Note we always pad out a packet to MaxWireSize before putting it into
-// the socket, because it's simpler at the receive end.
+// The header and data go into the socket as they are, without being
+// copied together first, and the packet is only as long as they are:
+// the receiving end learns its size from the socket.  The packet takes
+// its turn on the wire after the others in the send ring; it goes into
+// the socket right away, since they are sent in order anyway.
 void
 Network::Send(PacketHeader hdr, char* data)
 {
@@ -107,33 +154,44 @@ Network::Send(PacketHeader hdr, char* data)
 
     sprintf(toName, "SOCKET_%d", (int)hdr.to);
     
-    ASSERT((sendBusy == FALSE) && (hdr.length > 0) 
+    ASSERT((sendCount < ringSize) && (hdr.length > 0)
 		&& (hdr.length <= MaxPacketSize) && (hdr.from == ident));
     DEBUG('n', "Sending to addr %d, %d bytes... ", hdr.to, hdr.length);
 
-    interrupt->Schedule(NetworkSendDone, (int)this, NetworkTime, NetworkSendInt);
+    wireFree = max(wireFree, stats->totalTicks) + NetworkTime;
+    sendDone[(sendHead + sendCount++) % ringSize] = wireFree;
+    if (!sendInterrupt)
+	ScheduleSendDone();
 
     if (Random() % 100 >= chanceToWork * 100) { // emulate a lost packet
 	DEBUG('n', "oops, lost it!\n");
 	return;
     }
 
-    // concatenate hdr and data into a single buffer, and send it out
-    char *buffer = new char[MaxWireSize];
-    *(PacketHeader *)buffer = hdr;
-    bcopy(data, buffer + sizeof(PacketHeader), hdr.length);
-    SendToSocket(sock, buffer, MaxWireSize, toName);
-    delete []buffer;
+    // send out hdr and data together, as a single packet
+    SendvToSocket(sock, (char *) &hdr, sizeof(PacketHeader), data,
+			hdr.length, toName);
+    stats->numNetworkBytesSent += sizeof(PacketHeader) + hdr.length;
 }
 
-// read a packet, if one is buffered
+// read a packet, if one is in the receive ring
 PacketHeader
 Network::Receive(char* data)
 {
-    PacketHeader hdr = inHdr;
+    PacketHeader hdr;
 
-    inHdr.length = 0;
-    if (hdr.length != 0)
-    	bcopy(inbox, data, hdr.length);
+    if (inCount == 0) {
+	hdr.length = 0;
+	return hdr;
+    }
+    hdr = inHdr[inHead];
+    bcopy(inbox[inHead], data, hdr.length);
+    inHead = (inHead + 1) % ringSize;
+    inCount--;
+    if (!watching) {			// room for the next one
+	interrupt->WatchInput(sock, NetworkReadPoll, (int)this, NetworkTime,
+			NetworkRecvInt);
+	watching = TRUE;
+    }
     return hdr;
 }
@@ -1,7 +1,9 @@
 // network.h 
 //	Data structures to emulate a physical network connection.
 //	The network provides the abstraction of ordered, unreliable,
-//	fixed-size packet delivery to other machines on the network.
+//	packet delivery to other machines on the network.  Packets can
+//	be any size up to MaxWireSize, and only take up as much of the
+//	wire as they need.
 //
 //	You may note that the interface to the network is similar to 
 //	the console device -- both are full duplex channels.
@@ -43,42 +45,64 @@ class PacketHeader {
 
 
 // The following class defines a physical network device.  The network
-// is capable of delivering fixed sized packets, in order but unreliably, 
-// to other machines connected to the network.
+// is capable of delivering packets of up to MaxPacketSize bytes, in order
+// but unreliably, to other machines connected to the network.
 //
 // The "reliability" of the network can be specified to the constructor.
 // This number, between 0 and 1, is the chance that the network will lose 
 // a packet.  Note that you can change the seed for the random number 
 // generator, by changing the arguments to RandomInit() in Initialize().
 // The random number generator is used to choose which packets to drop.
+//
+// Like a real network interface, the device has a ring of "ringSize"
+// descriptors for packets being sent, and another for packets
+// received, so several packets can be in flight at once.  Packets
+// being sent go out on the wire one after another, each taking
+// NetworkTime; rather than an interrupt for each, there is one when
+// half a ring of them (or all of them, if fewer) are done.  Likewise
+// every packet waiting when the receive interrupt happens is taken
+// into the receive ring at once, up to its size, for a single
+// interrupt.  A ring size of 1 is the original device: one packet each
+// way at a time, and an interrupt for every one.
+
+#define MaxNetworkRing	64	// largest ring of descriptors
 
 class Network {
   public:
     Network(NetworkAddress addr, double reliability,
-  	  VoidFunctionPtr readAvail, VoidFunctionPtr writeDone, int callArg);
+  	  VoidFunctionPtr readAvail, VoidFunctionPtr writeDone, int callArg,
+	  int newRingSize);
 				// Allocate and initialize network driver
     ~Network();			// De-allocate the network driver data
     
     void Send(PacketHeader hdr, char* data);
     				// Send the packet data to a remote machine,
 				// specified by "hdr".  Returns immediately.
-    				// "writeHandler" is invoked once the next 
-				// packet can be sent.  Note that writeHandler 
+				// Only "ringSize" packets may be in flight:
+    				// "writeHandler" is invoked once one or
+				// more of them are done (see NumSendsDone),
+				// so more can be sent.  Note that writeHandler
 				// is called whether or not the packet is 
 				// dropped, and note that the "from" field of 
 				// the PacketHeader is filled in automatically 
 				// by Send().
+    int NumSendsDone() { return numSendsDone; }
+				// How many packets were done, when
+				// writeHandler was last invoked
 
     PacketHeader Receive(char* data);
     				// Poll the network for incoming messages.  
 				// If there is a packet waiting, copy the 
 				// packet into "data" and return the header.
 				// If no packet is waiting, return a header 
-				// with length 0.
+				// with length 0.  "readHandler" is invoked
+				// once for however many packets arrive
+				// together, so call this until it does
+				// return length 0.
 
     void SendDone();		// Interrupt handler, called when message is 
 				// sent
-    void CheckPktAvail();	// Check if there is an incoming packet
+    void CheckPktAvail();	// Take in the incoming packets
 
   private:
     NetworkAddress ident;	// This machine's network address
@@ -91,11 +115,22 @@ class Network {
 				// 	arrived.
     int handlerArg;		// Argument to be passed to interrupt handler
 				//   (pointer to post office)
-    bool sendBusy;		// Packet is being sent.
-    bool packetAvail;		// Packet has arrived, can be pulled off of
-				//   network
-    PacketHeader inHdr;		// Information about arrived packet
-    char inbox[MaxPacketSize];  // Data for arrived packet
+    int ringSize;		// Descriptors in each ring
+
+    int sendDone[MaxNetworkRing]; // Send ring: when each packet being
+    int sendHead;		//   sent will be done, from the oldest
+    int sendCount;		//   one at sendHead
+    int wireFree;		// When the wire is done with all of them
+    bool sendInterrupt;		// Is the next SendDone scheduled?
+    int numSendsDone;		// Packets done at the last SendDone
+
+    PacketHeader inHdr[MaxNetworkRing]; // Receive ring: information about
+    char inbox[MaxNetworkRing][MaxPacketSize]; // arrived packets, and their
+    int inHead;			//   data, read straight from the socket;
+    int inCount;		//   the oldest is at inHead
+    bool watching;		// Waiting to hear of more packets?
+
+    void ScheduleSendDone();	// Schedule the next send interrupt
 };
 
 #endif // NETWORK_H
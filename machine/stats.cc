@@ -19,9 +19,83 @@
 Statistics::Statistics()
 {
     totalTicks = idleTicks = systemTicks = userTicks = 0;
+    startMillis = HostMilliseconds();
+    hostIdleMillis = numIdleSkips = 0;
     numDiskReads = numDiskWrites = 0;
+    numTrackBufferHits = numDiskCacheHits = 0;
+    numDiskCachedWrites = numDiskDestages = 0;
+    for (int i = 0; i < NumLatencyBuckets; i++)
+	diskReadLatency[i] = diskWriteLatency[i] = 0;
+    numPrefetchSectors = numPrefetchHits = 0;
+    numJournalCommits = numJournalSectors = 0;
+    numCheckpoints = numJournalReplays = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
+    numConsoleWriteRequests = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numNetworkBytesSent = numNetworkBytesRecvd = 0;
+    numNetworkInterrupts = 0;
+    numUserBytesRead = numUserBytesWritten = 0;
+    userIOTicks = userIOMillis = 0;
+}
+
+//----------------------------------------------------------------------
+// Statistics::RecordDiskLatency
+// 	Count a disk request that took "ticks", in the read or write
+//	histogram.
+//----------------------------------------------------------------------
+
+void
+Statistics::RecordDiskLatency(bool writing, int ticks)
+{
+    int bucket = LatencyBucket(ticks);
+
+    if (writing)
+	diskWriteLatency[bucket]++;
+    else
+	diskReadLatency[bucket]++;
+}
+
+//----------------------------------------------------------------------
+// Statistics::LatencyBucket
+// 	Return which bucket of a latency histogram counts a request
+//	that took "ticks".
+//----------------------------------------------------------------------
+
+int
+Statistics::LatencyBucket(int ticks)
+{
+    int bucket = 0;
+
+    while (bucket < NumLatencyBuckets - 1
+		&& ticks >= (LatencyBucketBase << bucket))
+	bucket++;
+    return bucket;
+}
+
+//----------------------------------------------------------------------
+// Statistics::PrintLatency
+// 	Print the buckets of a disk latency histogram that counted any
+//	requests, each as the limit of the bucket and its count.
+//----------------------------------------------------------------------
+
+void
+Statistics::PrintLatency(char *what, int *buckets)
+{
+    int i, total = 0;
+
+    for (i = 0; i < NumLatencyBuckets; i++)
+	total += buckets[i];
+    if (total == 0)
+	return;
+    printf("Disk %s latency:", what);
+    for (i = 0; i < NumLatencyBuckets; i++)
+	if (buckets[i] > 0) {
+	    if (i == NumLatencyBuckets - 1)
+		printf(" >=%d %d", LatencyBucketBase << (i - 1), buckets[i]);
+	    else
+		printf(" <%d %d", LatencyBucketBase << i, buckets[i]);
+	}
+    printf("\n");
 }
 
 //----------------------------------------------------------------------
@@ -33,12 +107,40 @@ Statistics::Statistics()
 void
 Statistics::Print()
 {
+    int millis = HostMilliseconds() - startMillis;
+
     printf("Ticks: total %d, idle %d, system %d, user %d\n", totalTicks, 
 	idleTicks, systemTicks, userTicks);
+    printf("Idle: simulated %d%% of %d ticks, host %d%% of %d ms, "
+	"timer interrupts skipped %d\n",
+	(totalTicks == 0) ? 0 : (int) ((100.0 * idleTicks) / totalTicks),
+	totalTicks, (millis == 0) ? 0 : (100 * hostIdleMillis) / millis,
+	millis, numIdleSkips);
     printf("Disk I/O: reads %d, writes %d\n", numDiskReads, numDiskWrites);
-    printf("Console I/O: reads %d, writes %d\n", numConsoleCharsRead, 
-	numConsoleCharsWritten);
+    if (numDiskReads + numDiskWrites > 0)
+	printf("Disk buffers: track buffer hits %d, cache hits %d, "
+	    "writes cached %d, destaged %d\n", numTrackBufferHits,
+	    numDiskCacheHits, numDiskCachedWrites, numDiskDestages);
+    PrintLatency("read", diskReadLatency);
+    PrintLatency("write", diskWriteLatency);
+    printf("Read-ahead: sectors %d, hits %d (%d%%)\n", numPrefetchSectors,
+	numPrefetchHits, (numPrefetchSectors == 0) ? 0
+	: (100 * numPrefetchHits) / numPrefetchSectors);
+    printf("Journal: commits %d, sectors logged %d, checkpoints %d, "
+	"replayed %d\n", numJournalCommits, numJournalSectors,
+	numCheckpoints, numJournalReplays);
+    printf("Console I/O: reads %d, writes %d in %d requests\n",
+	numConsoleCharsRead, numConsoleCharsWritten, numConsoleWriteRequests);
     printf("Paging: faults %d\n", numPageFaults);
-    printf("Network I/O: packets received %d, sent %d\n", numPacketsRecvd, 
-	numPacketsSent);
+    if (numUserBytesRead + numUserBytesWritten > 0)
+	printf("User file I/O: read %d, written %d bytes in %d ticks "
+	    "(%.3f bytes/tick), %d ms (%d KB/s)\n", numUserBytesRead,
+	    numUserBytesWritten, userIOTicks,
+	    (double) (numUserBytesRead + numUserBytesWritten)
+					/ max(userIOTicks, 1),
+	    userIOMillis, (numUserBytesRead + numUserBytesWritten)
+					/ max(userIOMillis, 1));
+    printf("Network I/O: packets received %d (%d bytes), sent %d (%d bytes), "
+	"interrupts %d\n", numPacketsRecvd, numNetworkBytesRecvd,
+	numPacketsSent, numNetworkBytesSent, numNetworkInterrupts);
 }
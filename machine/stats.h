@@ -18,6 +18,15 @@
 // many user instructions executed, etc.
 //
 // The fields in this class are public to make it easier to update.
+//
+// How long each disk request took, from when it was made to its
+// interrupt, is counted in a histogram: bucket 0 counts requests that
+// took under LatencyBucketBase ticks, and each bucket after that
+// covers twice the time of the one before; the last bucket also
+// counts anything longer.
+
+#define NumLatencyBuckets	12
+#define LatencyBucketBase	256
 
 class Statistics {
   public:
@@ -27,17 +36,48 @@ class Statistics {
     int userTicks;       	// Time spent executing user code
 				// (this is also equal to # of
 				// user instructions executed)
+    int startMillis;		// Real time Nachos started, in ms
+    int hostIdleMillis;		// Real time spent waiting, with nothing
+				// to do, for input from outside
+    int numIdleSkips;		// Timer interrupts passed over while idle
 
     int numDiskReads;		// number of disk read requests
     int numDiskWrites;		// number of disk write requests
+    int numTrackBufferHits;	// sectors read from the track buffer
+    int numDiskCacheHits;	// sectors read from the drive's memory
+    int numDiskCachedWrites;	// sectors written to the drive's cache
+    int numDiskDestages;	// ... and later from there to the platter
+    int diskReadLatency[NumLatencyBuckets];
+    int diskWriteLatency[NumLatencyBuckets];
+				// histograms of disk request times
+    int numPrefetchSectors;	// number of sectors read ahead
+    int numPrefetchHits;	// number of those later asked for
+    int numJournalCommits;	// number of file system transactions logged
+    int numJournalSectors;	// number of sectors logged by them
+    int numCheckpoints;		// number of times the log was emptied
+    int numJournalReplays;	// number of transactions redone at mount
     int numConsoleCharsRead;	// number of characters read from the keyboard
     int numConsoleCharsWritten; // number of characters written to the display
+    int numConsoleWriteRequests; // ... in how many requests to the display
     int numPageFaults;		// number of virtual memory page faults
+    int numUserBytesRead;	// bytes user programs read from files
+    int numUserBytesWritten;	// bytes user programs wrote to files
+    int userIOTicks;		// time spent in Read and Write system calls
+    int userIOMillis;		// ... and the real time it took, in ms
     int numPacketsSent;		// number of packets sent over the network
     int numPacketsRecvd;	// number of packets received over the network
+    int numNetworkBytesSent;	// bytes they took on the wire, counting
+    int numNetworkBytesRecvd;	//  packet headers
+    int numNetworkInterrupts;	// send and receive interrupts for them
 
     Statistics(); 		// initialize everything to zero
 
+    void RecordDiskLatency(bool writing, int ticks);
+				// count a disk request in its histogram
+    int LatencyBucket(int ticks);
+				// which bucket counts "ticks"
+    void PrintLatency(char *what, int *buckets);
+				// print such a histogram
     void Print();		// print collected statistics
 };
 
@@ -53,8 +93,14 @@ class Statistics {
 #define SystemTick 	10 	// advance each time interrupts are enabled
 #define RotationTime 	500 	// time disk takes to rotate one sector
 #define SeekTime 	500    	// time disk takes to seek past one track
+#define DiskCacheTime	50	// time to move a sector between memory
+				// and the disk drive's own memory
 #define ConsoleTime 	100	// time to read or write one character
+#define ConsoleCharTime	10	// time for each further character of a
+				// multi-character write
 #define NetworkTime 	100   	// time to send or receive one packet
+#define HostInputTicks	100	// how often a busy machine checks for
+				// input from outside
 #define TimerTicks 	100    	// (average) time between timer interrupts
 
 #endif // STATS_H
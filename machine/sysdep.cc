@@ -34,7 +34,10 @@ extern "C" {
 #include <sys/socket.h>
 #include <sys/file.h>
 #include <sys/un.h>
+#include <sys/uio.h>
 #include <sys/mman.h>
+#include <poll.h>
+#include <errno.h>
 #ifdef HOST_i386
 #include <unistd.h>
 #include <sys/time.h>
@@ -143,6 +146,44 @@ PollFile(int fd)
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// PollFiles
+// 	Check the open files (or sockets) "fds" to see if any of them have
+//	characters that can be read immediately, all with one call to
+//	UNIX.  Set "ready" for those that do, and return how many.
+//
+//	Unlike PollFile, this never delays on its own account: if there
+//	is nothing for Nachos to do but wait for input, the caller says
+//	so with "wait", and we block until there is some.  Other Nachos
+//	get the host CPU in the meantime, without our having to spin.
+//
+//	"fds", "count" -- the files to be polled
+//	"ready" -- set to whether each one has characters to be read
+//	"wait" -- if TRUE, wait until at least one of them has
+//----------------------------------------------------------------------
+
+int
+PollFiles(int *fds, bool *ready, int count, bool wait)
+{
+    struct pollfd polls[32];
+    int i, retVal;
+
+    ASSERT(count <= 32);
+    for (i = 0; i < count; i++) {
+	polls[i].fd = fds[i];
+	polls[i].events = POLLIN;
+	polls[i].revents = 0;
+    }
+    do {
+	retVal = poll(polls, count, wait ? -1 : 0);
+    } while (retVal < 0 && errno == EINTR);
+    ASSERT(retVal >= 0);
+
+    for (i = 0; i < count; i++)		// end of file counts as input
+	ready[i] = (polls[i].revents & (POLLIN | POLLHUP | POLLERR)) != 0;
+    return retVal;
+}
+
 //----------------------------------------------------------------------
 // OpenForWrite
 // 	Open a file for writing.  Create it if it doesn't exist; truncate it 
@@ -254,6 +295,49 @@ Close(int fd)
     ASSERT(retVal >= 0); 
 }
 
+//----------------------------------------------------------------------
+// MapFile
+// 	Map the first "nBytes" of an open file into memory, shared, so
+//	that writing the memory writes the file.  Abort on error.
+//----------------------------------------------------------------------
+
+char *
+MapFile(int fd, int nBytes)
+{
+    char *p = (char *) mmap(NULL, nBytes, PROT_READ | PROT_WRITE,
+				MAP_SHARED, fd, 0);
+
+    ASSERT(p != (char *) MAP_FAILED);
+    return p;
+}
+
+//----------------------------------------------------------------------
+// SyncFile
+// 	Wait until the "nBytes" bytes at "p", in memory from MapFile,
+//	are safely in the file.  "p" need not be at a page boundary.
+//----------------------------------------------------------------------
+
+void
+SyncFile(char *p, int nBytes)
+{
+    long pageSize = sysconf(_SC_PAGESIZE);
+    char *start = (char *) ((unsigned long) p & ~(pageSize - 1));
+
+    (void) msync(start, nBytes + (p - start), MS_SYNC);
+}
+
+//----------------------------------------------------------------------
+// UnmapFile
+// 	Write back and unmap memory from MapFile.
+//----------------------------------------------------------------------
+
+void
+UnmapFile(char *p, int nBytes)
+{
+    (void) msync(p, nBytes, MS_SYNC);
+    (void) munmap(p, nBytes);
+}
+
 //----------------------------------------------------------------------
 // Unlink
 // 	Delete a file.
@@ -390,6 +474,67 @@ SendToSocket(int sockID, char *buffer, int packetSize, char *toName)
     ASSERT(retVal == packetSize);
 }
 
+//----------------------------------------------------------------------
+// SendvToSocket
+// 	Transmit a packet to another Nachos' IPC port, gathering it from
+//	"header" and "data", so that the caller needn't copy them into one
+//	buffer.  The packet is only as long as the two together.  Abort on
+//	error.
+//----------------------------------------------------------------------
+
+void
+SendvToSocket(int sockID, char *header, int headerSize, char *data,
+		int dataSize, char *toName)
+{
+    struct sockaddr_un uName;
+    struct iovec parts[2];
+    struct msghdr msg;
+    int retVal;
+
+    InitSocketName(&uName, toName);
+    parts[0].iov_base = header;
+    parts[0].iov_len = headerSize;
+    parts[1].iov_base = data;
+    parts[1].iov_len = dataSize;
+    memset((char *) &msg, 0, sizeof(msg));
+    msg.msg_name = (char *) &uName;
+    msg.msg_namelen = sizeof(uName);
+    msg.msg_iov = parts;
+    msg.msg_iovlen = 2;
+    retVal = sendmsg(sockID, &msg, 0);
+    ASSERT(retVal == headerSize + dataSize);
+}
+
+//----------------------------------------------------------------------
+// ReadvFromSocket
+// 	Read a packet off the IPC port, scattering its first "headerSize"
+//	bytes into "header" and the rest (up to "maxDataSize") into
+//	"data".  Return the size of the packet.  Abort on error, or if the
+//	packet is shorter than a header.
+//----------------------------------------------------------------------
+
+int
+ReadvFromSocket(int sockID, char *header, int headerSize, char *data,
+		int maxDataSize)
+{
+    struct iovec parts[2];
+    struct msghdr msg;
+    int retVal;
+
+    parts[0].iov_base = header;
+    parts[0].iov_len = headerSize;
+    parts[1].iov_base = data;
+    parts[1].iov_len = maxDataSize;
+    memset((char *) &msg, 0, sizeof(msg));
+    msg.msg_iov = parts;
+    msg.msg_iovlen = 2;
+    retVal = recvmsg(sockID, &msg, 0);
+    if (retVal < headerSize)
+        perror("in recvmsg");
+    ASSERT(retVal >= headerSize);
+    return retVal;
+}
+
 
 //----------------------------------------------------------------------
 // CallOnUserAbort
@@ -416,6 +561,21 @@ Delay(int seconds)
     (void) sleep((unsigned) seconds);
 }
 
+//----------------------------------------------------------------------
+// HostMilliseconds
+// 	Return the time of day on the host, in milliseconds, modulo
+//	a day or so; only differences between two calls mean anything.
+//----------------------------------------------------------------------
+
+int
+HostMilliseconds()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (tv.tv_sec % 1000000) * 1000 + tv.tv_usec / 1000;
+}
+
 //----------------------------------------------------------------------
 // Abort
 // 	Quit and drop core.
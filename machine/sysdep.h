@@ -17,6 +17,11 @@
 // If no characters in the file, return without waiting.
 extern bool PollFile(int fd);
 
+// Check several files at once; set "ready" for those with characters to
+// be read, and return how many there are.  If none, either return right
+// away, or if "wait", wait for one.
+extern int PollFiles(int *fds, bool *ready, int count, bool wait);
+
 // File operations: open/read/write/lseek/close, and check for error
 // For simulating the disk and the console devices.
 extern int OpenForWrite(char *name);
@@ -29,6 +34,12 @@ extern int Tell(int fd);
 extern void Close(int fd);
 extern bool Unlink(char *name);
 
+// Map an open file into memory, so that changes to the memory go to
+// the file
+extern char *MapFile(int fd, int nBytes);
+extern void SyncFile(char *p, int nBytes);
+extern void UnmapFile(char *p, int nBytes);
+
 // Interprocess communication operations, for simulating the network
 extern int OpenSocket();
 extern void CloseSocket(int sockID);
@@ -38,11 +49,23 @@ extern bool PollSocket(int sockID);
 extern void ReadFromSocket(int sockID, char *buffer, int packetSize);
 extern void SendToSocket(int sockID, char *buffer, int packetSize,char *toName);
 
+// Scatter/gather versions: send a packet made of a header and data,
+// without first copying them together, and read one back into separate
+// header and data buffers.  Packets can be any size; reading returns
+// the size of the one read.
+extern void SendvToSocket(int sockID, char *header, int headerSize,
+			  char *data, int dataSize, char *toName);
+extern int ReadvFromSocket(int sockID, char *header, int headerSize,
+			   char *data, int maxDataSize);
+
 // Process control: abort, exit, and sleep
 extern void Abort();
 extern void Exit(int exitCode);
 extern void Delay(int seconds);
 
+// Real (not simulated) time, for measuring how fast Nachos runs
+extern int HostMilliseconds();
+
 // Initialize system so that cleanUp routine is called when user hits ctl-C
 extern void CallOnUserAbort(VoidNoArgFunctionPtr cleanUp);
 
@@ -2,15 +2,16 @@
 //	Test out message delivery between two "Nachos" machines,
 //	using the Post Office to coordinate delivery.
 //
-//	Two caveats:
-//	  1. Two copies of Nachos must be running, with machine ID's 0 and 1:
+//	Two copies of Nachos must be running, with machine ID's 0 and 1:
 //		./nachos -m 0 -o 1 &
 //		./nachos -m 1 -o 0 &
 //
-//	  2. You need an implementation of condition variables,
-//	     which is *not* provided as part of the baseline threads 
-//	     implementation.  The Post Office won't work without
-//	     a correct implementation of condition variables.
+//	(The Post Office no longer needs condition variables, which are
+//	*not* provided as part of the baseline threads implementation.)
+//
+//	Add "-nring <packets>" to both to give the network deeper send
+//	and receive rings, and see how much faster a burst of messages
+//	gets through.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -23,12 +24,58 @@
 #include "post.h"
 #include "interrupt.h"
 
+#define BurstSize	200	// messages sent back to back by BurstTest
+
+//----------------------------------------------------------------------
+// BurstTest
+// 	Time a burst of messages from the machine with the lower ID
+//	("myAddr" is ours) to the other one, in mail box #2.  The
+//	receiver acknowledges the whole burst with one message, in mail
+//	box #3; the sender prints how long it took, from the first
+//	message sent to the ack.
+//----------------------------------------------------------------------
+
+static void
+BurstTest(NetworkAddress myAddr, NetworkAddress farAddr)
+{
+    PacketHeader outPktHdr, inPktHdr;
+    MailHeader outMailHdr, inMailHdr;
+    char buffer[MaxMailSize];
+    int i, ticks, millis;
+
+    outPktHdr.to = farAddr;
+    outMailHdr.from = 3;
+    outMailHdr.length = MaxMailSize;
+    bzero(buffer, MaxMailSize);
+    if (myAddr > farAddr) {	// we receive
+	for (i = 0; i < BurstSize; i++)
+	    postOffice->Receive(2, &inPktHdr, &inMailHdr, buffer);
+	outMailHdr.to = 3;
+	postOffice->Send(outPktHdr, outMailHdr, buffer);
+	return;
+    }
+
+    ticks = stats->totalTicks;
+    millis = HostMilliseconds();
+    outMailHdr.to = 2;
+    for (i = 0; i < BurstSize; i++)
+	postOffice->Send(outPktHdr, outMailHdr, buffer);
+    postOffice->Receive(3, &inPktHdr, &inMailHdr, buffer);
+    ticks = stats->totalTicks - ticks;
+    millis = HostMilliseconds() - millis;
+    printf("Burst of %d messages: %d ticks (%d messages per 1000), %d ms\n",
+	BurstSize, ticks, (ticks == 0) ? 0 : BurstSize * 1000 / ticks,
+	millis);
+    fflush(stdout);
+}
+
 // Test out message delivery, by doing the following:
 //	1. send a message to the machine with ID "farAddr", at mail box #0
 //	2. wait for the other machine's message to arrive (in our mailbox #0)
 //	3. send an acknowledgment for the other machine's message
 //	4. wait for an acknowledgement from the other machine to our 
 //	    original message
+//	5. time a burst of messages (BurstTest)
 
 void
 MailTest(int farAddr)
@@ -67,6 +114,8 @@ MailTest(int farAddr)
     printf("Got \"%s\" from %d, box %d\n",buffer,inPktHdr.from,inMailHdr.from);
     fflush(stdout);
 
+    BurstTest(postOffice->Address(), farAddr);
+
     // Then we're done!
     interrupt->Halt();
 }
@@ -45,13 +45,15 @@ Mail::Mail(PacketHeader pktH, MailHeader mailH, char *msgData)
 //      Initialize a single mail box within the post office, so that it
 //	can receive incoming messages.
 //
-//	Just initialize a list of messages, representing the mailbox.
+//	Just initialize a list of messages, representing the mailbox,
+//	and a count of them to wait on.
 //----------------------------------------------------------------------
 
 
 MailBox::MailBox()
 { 
-    messages = new SynchList(); 
+    messages = new List();
+    numMessages = new Semaphore("mailbox", 0);
 }
 
 //----------------------------------------------------------------------
@@ -64,7 +66,10 @@ MailBox::MailBox()
 
 MailBox::~MailBox()
 { 
+    while (!messages->IsEmpty())
+	delete (Mail *) messages->Remove();
     delete messages; 
+    delete numMessages;
 }
 
 //----------------------------------------------------------------------
@@ -89,7 +94,7 @@ PrintHeader(PacketHeader pktHdr, MailHeader mailHdr)
 //	arrival, wake them up!
 //
 //	We need to reconstruct the Mail message (by concatenating the headers
-//	to the data), to simplify queueing the message on the SynchList.
+//	to the data), to simplify queueing the message on the List.
 //
 //	"pktHdr" -- source, destination machine ID's
 //	"mailHdr" -- source, destination mailbox ID's
@@ -102,7 +107,7 @@ MailBox::Put(PacketHeader pktHdr, MailHeader mailHdr, char *data)
     Mail *mail = new Mail(pktHdr, mailHdr, data); 
 
     messages->Append((void *)mail);	// put on the end of the list of 
-					// arrived messages, and wake up 
+    numMessages->V();			// arrived messages, and wake up
 					// any waiters
 }
 
@@ -122,8 +127,11 @@ void
 MailBox::Get(PacketHeader *pktHdr, MailHeader *mailHdr, char *data) 
 { 
     DEBUG('n', "Waiting for mail in mailbox\n");
-    Mail *mail = (Mail *) messages->Remove();	// remove message from list;
-						// will wait if list is empty
+    Mail *mail;
+
+    numMessages->P();				// wait if list is empty
+    mail = (Mail *) messages->Remove();		// remove message from list
+    ASSERT(mail != NULL);
 
     *pktHdr = mail->pktHdr;
     *mailHdr = mail->mailHdr;
@@ -171,14 +179,15 @@ static void WriteDone(int arg)
 //	  drops any packets; reliability = 0 means the network never
 //	  delivers any packets)
 //	"nBoxes" is the number of mail boxes in this Post Office
+//	"ringSize" is how many packets the network device holds each way
 //----------------------------------------------------------------------
 
-PostOffice::PostOffice(NetworkAddress addr, double reliability, int nBoxes)
+PostOffice::PostOffice(NetworkAddress addr, double reliability, int nBoxes,
+			int ringSize)
 {
 // First, initialize the synchronization with the interrupt handlers
     messageAvailable = new Semaphore("message available", 0);
-    messageSent = new Semaphore("message sent", 0);
-    sendLock = new Lock("message send lock");
+    sendRoom = new Semaphore("send room", ringSize);
 
 // Second, initialize the mailboxes
     netAddr = addr; 
@@ -186,7 +195,8 @@ PostOffice::PostOffice(NetworkAddress addr, double reliability, int nBoxes)
     boxes = new MailBox[nBoxes];
 
 // Third, initialize the network; tell it which interrupt handlers to call
-    network = new Network(addr, reliability, ReadAvail, WriteDone, (int) this);
+    network = new Network(addr, reliability, ReadAvail, WriteDone, (int) this,
+			ringSize);
 
 
 // Finally, create a thread whose sole job is to wait for incoming messages,
@@ -206,8 +216,7 @@ PostOffice::~PostOffice()
     delete network;
     delete [] boxes;
     delete messageAvailable;
-    delete messageSent;
-    delete sendLock;
+    delete sendRoom;
 }
 
 //----------------------------------------------------------------------
@@ -216,6 +225,9 @@ PostOffice::~PostOffice()
 //
 //      Incoming messages have had the PacketHeader stripped off,
 //	but the MailHeader is still tacked on the front of the data.
+//
+//	The network interrupts once for however many packets arrived
+//	together, so each time, take them all.
 //----------------------------------------------------------------------
 
 void
@@ -226,22 +238,23 @@ PostOffice::PostalDelivery()
     char *buffer = new char[MaxPacketSize];
 
     for (;;) {
-        // first, wait for a message
+        // first, wait for messages
         messageAvailable->P();	
-        pktHdr = network->Receive(buffer);
-
-        mailHdr = *(MailHeader *)buffer;
-        if (DebugIsEnabled('n')) {
-	    printf("Putting mail into mailbox: ");
-	    PrintHeader(pktHdr, mailHdr);
-        }
-
-	// check that arriving message is legal!
-	ASSERT(0 <= mailHdr.to && mailHdr.to < numBoxes);
-	ASSERT(mailHdr.length <= MaxMailSize);
-
-	// put into mailbox
-        boxes[mailHdr.to].Put(pktHdr, mailHdr, buffer + sizeof(MailHeader));
+        while ((pktHdr = network->Receive(buffer)).length != 0) {
+	    mailHdr = *(MailHeader *)buffer;
+	    if (DebugIsEnabled('n')) {
+		printf("Putting mail into mailbox: ");
+		PrintHeader(pktHdr, mailHdr);
+	    }
+
+	    // check that arriving message is legal!
+	    ASSERT(0 <= mailHdr.to && mailHdr.to < numBoxes);
+	    ASSERT(mailHdr.length <= MaxMailSize);
+
+	    // put into mailbox
+	    boxes[mailHdr.to].Put(pktHdr, mailHdr,
+				buffer + sizeof(MailHeader));
+	}
     }
 }
 
@@ -279,15 +292,12 @@ PostOffice::Send(PacketHeader pktHdr, MailHeader mailHdr, char* data)
     bcopy(&mailHdr, buffer, sizeof(MailHeader));
     bcopy(data, buffer + sizeof(MailHeader), mailHdr.length);
 
-    sendLock->Acquire();   		// only one message can be sent
-					// to the network at any one time
+    sendRoom->P();			// wait for room in the network's
+					// send ring
     network->Send(pktHdr, buffer);
-    messageSent->P();			// wait for interrupt to tell us
-					// ok to send the next message
-    sendLock->Release();
 
-    delete [] buffer;			// we've sent the message, so
-					// we can delete our buffer
+    delete [] buffer;			// the network has copied the
+					// message, so we can delete our buffer
 }
 
 //----------------------------------------------------------------------
@@ -330,8 +340,9 @@ PostOffice::IncomingPacket()
 
 //----------------------------------------------------------------------
 // PostOffice::PacketSent
-// 	Interrupt handler, called when the next packet can be put onto the 
-//	network.
+// 	Interrupt handler, called when the network has finished sending
+//	one or more packets, so there is room for that many more in its
+//	send ring.
 //
 //	The name of this routine is a misnomer; if "reliability < 1",
 //	the packet could have been dropped by the network, so it won't get
@@ -341,6 +352,7 @@ PostOffice::IncomingPacket()
 void 
 PostOffice::PacketSent()
 { 
-    messageSent->V();
+    for (int i = network->NumSendsDone(); i > 0; i--)
+	sendRoom->V();
 }
 
@@ -29,7 +29,7 @@
 #define POST_H
 
 #include "network.h"
-#include "synchlist.h"
+#include "synch.h"
 
 // Mailbox address -- uniquely identifies a mailbox on a given machine.
 // A mailbox is just a place for temporary storage for messages.
@@ -74,6 +74,9 @@ class Mail {
 // for messages.   Incoming messages are put by the PostOffice into the 
 // appropriate mailbox, and these messages can then be retrieved by
 // threads on this machine.
+//
+// (A SynchList would do, but it needs condition variables; a count of
+// the messages does just as well.)
 
 class MailBox {
   public: 
@@ -87,7 +90,8 @@ class MailBox {
 				// mailbox (and wait if there is no message 
 				// to get!)
   private:
-    SynchList *messages;	// A mailbox is just a list of arrived messages
+    List *messages;		// A mailbox is just a list of arrived messages
+    Semaphore *numMessages;	// ... and how many there are
 };
 
 // The following class defines a "Post Office", or a collection of 
@@ -98,15 +102,26 @@ class MailBox {
 //
 // Incoming messages are put by the PostOffice into the 
 // appropriate mailbox, waking up any threads waiting on Receive.
+//
+// Send returns as soon as the network has taken the message, which it
+// does right away unless its send ring is full.  So a thread can send
+// "ringSize" messages back to back before it has to wait, and the
+// network only interrupts once for several of them.
 
 class PostOffice {
   public:
-    PostOffice(NetworkAddress addr, double reliability, int nBoxes);
+    PostOffice(NetworkAddress addr, double reliability, int nBoxes,
+		int ringSize);
 				// Allocate and initialize Post Office
 				//   "reliability" is how many packets
 				//   get dropped by the underlying network
+				//   "ringSize" is how many packets the
+				//   network holds each way
     ~PostOffice();		// De-allocate Post Office data
     
+    NetworkAddress Address() { return netAddr; }
+				// Network address of this machine
+
     void Send(PacketHeader pktHdr, MailHeader mailHdr, char *data);
     				// Send a message to a mailbox on a remote 
 				// machine.  The fromBox in the MailHeader is 
@@ -121,8 +136,8 @@ class PostOffice {
 				// and then put them in the correct mailbox
 
     void PacketSent();		// Interrupt handler, called when outgoing 
-				// packet has been put on network; next 
-				// packet can now be sent
+				// packets have been put on network; as
+				// many more can now be sent
     void IncomingPacket();	// Interrupt handler, called when incoming
    				// packet has arrived and can be pulled
 				// off of network (i.e., time to call 
@@ -134,8 +149,7 @@ class PostOffice {
     MailBox *boxes;		// Table of mail boxes to hold incoming mail
     int numBoxes;		// Number of mail boxes
     Semaphore *messageAvailable;// V'ed when message has arrived from network
-    Semaphore *messageSent;	// V'ed when next message can be sent to network
-    Lock *sendLock;		// Only one outgoing message at a time
+    Semaphore *sendRoom;	// Free slots in the network's send ring
 };
 
 #endif
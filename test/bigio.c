@@ -0,0 +1,47 @@
+/* bigio.c 
+ *    Test program to move a large file through the Read and Write
+ *    system calls, a buffer at a time.
+ *
+ *    Writes the file "bigio.data", then reads it back and checks it.
+ *    The statistics printed when Nachos halts give how many bytes
+ *    moved, in how many ticks and how much real time.
+ *    If anything goes wrong, it halts early, and fewer bytes show as
+ *    read.
+ */
+
+#include "syscall.h"
+
+#define BufSize		1024	/* eight pages */
+#define NumBufs		64
+
+char buf[BufSize];
+
+int
+main()
+{
+    OpenFileId f;
+    int i, j;
+
+    Create("bigio.data");
+    f = Open("bigio.data");
+    if (f < 0)
+	Halt();
+    for (i = 0; i < NumBufs; i++) {
+	for (j = 0; j < BufSize; j++)
+	    buf[j] = i + j;
+	Write(buf, BufSize, f);
+    }
+    Close(f);
+
+    f = Open("bigio.data");
+    for (i = 0; i < NumBufs; i++) {
+	if (Read(buf, BufSize, f) != BufSize)
+	    Halt();
+	for (j = 0; j < BufSize; j++)
+	    if (buf[j] != (char) (i + j))
+		Halt();
+    }
+    Close(f);
+    Halt();
+    /* not reached */
+}
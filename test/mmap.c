@@ -0,0 +1,37 @@
+/* mmap.c 
+ *    Test program to sort integers in place in a memory-mapped file.
+ *
+ *    The file "mmap.data" holds a count, followed by that many
+ *    integers (in the byte order of the simulated machine, that is,
+ *    little-endian).  Load it into the Nachos file system with -cp
+ *    before running this program; afterwards, -p mmap.data should
+ *    show the integers in sorted order.
+ *
+ *    Each page of the file is only read in when the sort first
+ *    touches it, and the pages it changed are written back by Munmap.
+ */
+
+#include "syscall.h"
+
+int
+main()
+{
+    int *A;
+    int n, i, j, tmp;
+
+    A = (int *) Mmap("mmap.data");
+    if (A == (int *) -1)
+	Halt();
+    n = A[0];
+
+    /* insertion sort, of A[1] .. A[n] */
+    for (i = 2; i <= n; i++) {
+	tmp = A[i];
+	for (j = i; j > 1 && A[j - 1] > tmp; j--)
+	    A[j] = A[j - 1];
+	A[j] = tmp;
+    }
+    Munmap((int) A);
+    Halt();
+    /* not reached */
+}
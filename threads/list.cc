@@ -243,6 +243,28 @@ List::SortedRemove(int *keyPtr)
 }
 
 
+//----------------------------------------------------------------------
+// List::SortedFirst
+//      Return the first "item" of a sorted list, without removing it;
+//	taking it off and putting it back would put it after any other
+//	items with the same key.
+//
+// Returns:
+//	Pointer to the first item, NULL if nothing on the list.
+//	Sets *keyPtr to the priority value of the item.
+//----------------------------------------------------------------------
+
+void *
+List::SortedFirst(int *keyPtr)
+{
+    if (IsEmpty())
+	return NULL;
+    if (keyPtr != NULL)
+        *keyPtr = first->key;
+    return first->item;
+}
+
+
 
 void
 List::Remove(void *item)
@@ -10,10 +10,14 @@
 //
 // Usage: nachos -d <debugflags> -rs <random seed #>
 //		-s -x <nachos file> -c <consoleIn> <consoleOut>
-//		-f -cp <unix file> <nachos file>
-//		-p <nachos file> -r <nachos file> -l -D -t
+//		-sc <consoleIn> <consoleOut>
+//		-f -disk <unix file> -geom <sectors per track> <tracks>
+//		-raid <level> -dmap -dsync -dcache <sectors> -dahead
+//		-dqueue <depth> -dtrace <unix file>
+//		-cp <unix file> <nachos file> -cpout <nachos file> <unix file>
+//		-p <nachos file> -r <nachos file> -l -D -t -frag -defrag
 //              -n <network reliability> -m <machine id>
-//              -o <other machine id>
+//              -o <other machine id> -nring <packets>
 //              -z
 //
 //    -d causes certain debugging messages to be printed (cf. utility.h)
@@ -24,20 +28,53 @@
 //    -s causes user programs to be executed in single-step mode
 //    -x runs a user program
 //    -c tests the console
+//    -sc tests the synchronous console, with its line editing, and
+//	times writing a line to it a character at a time and all at once
 //
 //  FILESYS
 //    -f causes the physical disk to be formatted
+//    -disk names the UNIX file holding the disk (default DISK); given
+//	more than once, it adds more disks, and the file system is on
+//	the first
+//    -geom gives the geometry of disks that don't exist yet (default
+//	32 tracks of 32 sectors)
+//    -raid makes all the disks into one, for the file system: level 0
+//	stripes the sectors across them, level 1 mirrors them
+//    -dmap maps that file into memory, rather than reading and
+//	writing it for every disk request
+//    -dsync maps it, and waits for each disk write to reach it
+//    -dcache gives the disk drives a write cache of that many sectors
+//    -dahead makes the drives read ahead after each read
+//    -dqueue lets the drives take that many requests at once, and
+//	do them in the fastest order
+//    -dtrace records every request made of the file system's disk
+//	in the UNIX file, for diskreplay
 //    -cp copies a file from UNIX to Nachos
+//    -cpout copies a file from Nachos to UNIX
 //    -p prints a Nachos file to stdout
 //    -r removes a Nachos file from the file system
+//    -mkdir creates a Nachos directory
 //    -l lists the contents of the Nachos directory
 //    -D prints the contents of the entire file system 
+//    -frag reports how fragmented the files and the free space are
+//    -defrag moves each fragmented file into one run of sectors
 //    -t tests the performance of the Nachos file system
+//    -ot measures the disk reads needed to open files
+//    -ds compares the disk scheduling policies
+//    -sw times small writes at unaligned offsets
+//    -ct checks that the file system survives crashes
+//    -gc compares creates and removes with and without group commit
+//    -cc reads and changes one directory from many threads at once
+//    -sf measures the disk reads needed to read many small files
+//    -pd compares reading from one disk with reading from several
+//    -rd times striped and mirrored arrays of 1, 2 and 4 disks
+//    -dm times reads and writes with each kind of disk drive
 //
 //  NETWORK
 //    -n sets the network reliability
 //    -m sets this machine's host id (needed for the network)
 //    -o runs a simple test of the Nachos network software
+//    -nring sets how many packets the network holds each way (default 1)
 //
 //  NOTE -- flags are ignored until the relevant assignment.
 //  Some of the flags are interpreted here; some in system.cc.
@@ -60,8 +97,13 @@ extern int testnum;
 // External functions used by this file
 
 extern void ThreadTest(void), Copy(char *unixFile, char *nachosFile);
-extern void Print(char *file), PerformanceTest(void);
+extern void CopyOut(char *nachosFile, char *unixFile);
+extern void Print(char *file), PerformanceTest(void), OpenTest(void);
+extern void DiskSchedTest(void), SmallWriteTest(void), CrashTest(void);
+extern void GroupCommitTest(void), ConcurrencyTest(void), SmallFileTest(void);
+extern void ParallelDiskTest(void), RaidTest(void), DriveModelTest(void);
 extern void StartProcess(char *file), ConsoleTest(char *in, char *out);
+extern void SynchConsoleTest(char *in, char *out);
 extern void MailTest(int networkID);
 
 //----------------------------------------------------------------------
@@ -124,13 +166,34 @@ main(int argc, char **argv)
 	    interrupt->Halt();		// once we start the console, then 
 					// Nachos will loop forever waiting 
 					// for console input
+	} else if (!strcmp(*argv, "-sc")) {	// test the synch console
+	    if (argc == 1)
+	        SynchConsoleTest(NULL, NULL);
+	    else {
+		ASSERT(argc > 2);
+	        SynchConsoleTest(*(argv + 1), *(argv + 2));
+	        argCount = 3;
+	    }
+	    interrupt->Halt();		// as for -c
 	}
 #endif // USER_PROGRAM
 #ifdef FILESYS
-	if (!strcmp(*argv, "-cp")) { 		// copy from UNIX to Nachos
+	if (!strcmp(*argv, "-disk")) {		// handled in Initialize
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-geom")) {	// handled in Initialize
+	    argCount = 3;
+	} else if (!strcmp(*argv, "-raid") || !strcmp(*argv, "-dcache")
+		|| !strcmp(*argv, "-dqueue") || !strcmp(*argv, "-dtrace")) {
+						// handled in Initialize
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-cp")) { 	// copy from UNIX to Nachos
 	    ASSERT(argc > 2);
 	    Copy(*(argv + 1), *(argv + 2));
 	    argCount = 3;
+	} else if (!strcmp(*argv, "-cpout")) {	// copy from Nachos to UNIX
+	    ASSERT(argc > 2);
+	    CopyOut(*(argv + 1), *(argv + 2));
+	    argCount = 3;
 	} else if (!strcmp(*argv, "-p")) {	// print a Nachos file
 	    ASSERT(argc > 1);
 	    Print(*(argv + 1));
@@ -139,12 +202,40 @@ main(int argc, char **argv)
 	    ASSERT(argc > 1);
 	    fileSystem->Remove(*(argv + 1));
 	    argCount = 2;
+	} else if (!strcmp(*argv, "-mkdir")) {	// make Nachos directory
+	    ASSERT(argc > 1);
+	    fileSystem->Mkdir(*(argv + 1));
+	    argCount = 2;
 	} else if (!strcmp(*argv, "-l")) {	// list Nachos directory
             fileSystem->List();
 	} else if (!strcmp(*argv, "-D")) {	// print entire filesystem
             fileSystem->Print();
+	} else if (!strcmp(*argv, "-frag")) {	// fragmentation report
+            fileSystem->PrintLayout();
+	} else if (!strcmp(*argv, "-defrag")) {	// defragment
+            fileSystem->Defragment();
 	} else if (!strcmp(*argv, "-t")) {	// performance test
             PerformanceTest();
+	} else if (!strcmp(*argv, "-ot")) {	// open test
+            OpenTest();
+	} else if (!strcmp(*argv, "-ds")) {	// disk scheduling test
+            DiskSchedTest();
+	} else if (!strcmp(*argv, "-sw")) {	// small write test
+            SmallWriteTest();
+	} else if (!strcmp(*argv, "-ct")) {	// crash test
+            CrashTest();
+	} else if (!strcmp(*argv, "-gc")) {	// group commit test
+            GroupCommitTest();
+	} else if (!strcmp(*argv, "-cc")) {	// concurrency test
+            ConcurrencyTest();
+	} else if (!strcmp(*argv, "-sf")) {	// small file test
+            SmallFileTest();
+	} else if (!strcmp(*argv, "-pd")) {	// parallel disk test
+            ParallelDiskTest();
+	} else if (!strcmp(*argv, "-rd")) {	// RAID test
+            RaidTest();
+	} else if (!strcmp(*argv, "-dm")) {	// drive model test
+            DriveModelTest();
 	}
 #endif // FILESYS
 #ifdef NETWORK
@@ -159,6 +250,10 @@ main(int argc, char **argv)
 #endif // NETWORK
     }
 
+#ifdef FILESYS
+    journal->Sync();		// Commit while we still have a thread
+				// to wait for the disk with
+#endif
     currentThread->Finish();	// NOTE: if the procedure "main" 
 				// returns, then the program "nachos"
 				// will exit (as any other normal program
@@ -27,6 +27,8 @@ class Scheduler {
 					// list, if any, and return thread.
     void Run(Thread* nextThread);	// Cause nextThread to start running
     void Print();			// Print contents of ready list
+    bool IsEmpty() { return readyList->IsEmpty(); }
+					// Is no thread ready to run?
     
   private:
     List *readyList;  		// queue of threads that are ready to run,
@@ -1,8 +1,8 @@
 // synch.cc 
-//	Routines for synchronizing threads.  Three kinds of
-//	synchronization routines are defined here: semaphores, locks 
-//   	and condition variables (the implementation of the last two
-//	are left to the reader).
+//	Routines for synchronizing threads.  Four kinds of
+//	synchronization routines are defined here: semaphores,
+//	reader/writer locks, locks and condition variables (the
+//	implementation of the last two are left to the reader).
 //
 // Any implementation of a synchronization routine needs some
 // primitive atomic operation.  We assume Nachos is running on
@@ -97,6 +97,128 @@ Semaphore::V()
     (void) interrupt->SetLevel(oldLevel);
 }
 
+//----------------------------------------------------------------------
+// RWLock::RWLock
+// 	Initialize a reader/writer lock, held by no one.
+//
+//	"debugName" is an arbitrary name, useful for debugging.
+//----------------------------------------------------------------------
+
+RWLock::RWLock(char* debugName)
+{
+    name = debugName;
+    readers = 0;
+    writing = FALSE;
+    writersWaiting = 0;
+    readQueue = new List;
+    writeQueue = new List;
+}
+
+//----------------------------------------------------------------------
+// RWLock::~RWLock
+// 	De-allocate the lock.  Assume no one holds it, or is waiting.
+//----------------------------------------------------------------------
+
+RWLock::~RWLock()
+{
+    delete readQueue;
+    delete writeQueue;
+}
+
+//----------------------------------------------------------------------
+// RWLock::AcquireShared
+// 	Wait until no thread is writing, or waiting to write, and then
+//	join the readers.
+//----------------------------------------------------------------------
+
+void
+RWLock::AcquireShared()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    while (writing || writersWaiting > 0) {
+	readQueue->Append((void *)currentThread);
+	currentThread->Sleep();
+    }
+    readers++;
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// RWLock::ReleaseShared
+// 	Leave the readers; the last one out lets a writer in.
+//----------------------------------------------------------------------
+
+void
+RWLock::ReleaseShared()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    ASSERT(readers > 0);
+    readers--;
+    if (readers == 0)
+	WakeWaiters();
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// RWLock::AcquireExclusive
+// 	Wait until no one else holds the lock, and then take it.
+//----------------------------------------------------------------------
+
+void
+RWLock::AcquireExclusive()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    while (writing || readers > 0) {
+	writersWaiting++;
+	writeQueue->Append((void *)currentThread);
+	currentThread->Sleep();
+	writersWaiting--;
+    }
+    writing = TRUE;
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// RWLock::ReleaseExclusive
+// 	Give up the lock, and let the next waiters in.
+//----------------------------------------------------------------------
+
+void
+RWLock::ReleaseExclusive()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    ASSERT(writing);
+    writing = FALSE;
+    WakeWaiters();
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// RWLock::WakeWaiters
+// 	The lock is free: wake up one waiting writer if there is one,
+//	otherwise every waiting reader.  They check again when they run,
+//	since someone else may have taken the lock in the meantime.
+//
+//	Called with interrupts disabled.
+//----------------------------------------------------------------------
+
+void
+RWLock::WakeWaiters()
+{
+    Thread *thread;
+
+    if ((thread = (Thread *)writeQueue->Remove()) != NULL) {
+	scheduler->ReadyToRun(thread);
+	return;
+    }
+    while ((thread = (Thread *)readQueue->Remove()) != NULL)
+	scheduler->ReadyToRun(thread);
+}
+
 // Dummy functions -- so we can compile our later assignments 
 // Note -- without a correct implementation of Condition::Wait(), 
 // the test case in the network assignment won't work!
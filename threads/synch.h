@@ -1,11 +1,11 @@
 // synch.h 
 //	Data structures for synchronizing threads.
 //
-//	Three kinds of synchronization are defined here: semaphores,
-//	locks, and condition variables.  The implementation for
-//	semaphores is given; for the latter two, only the procedure
-//	interface is given -- they are to be implemented as part of 
-//	the first assignment.
+//	Four kinds of synchronization are defined here: semaphores,
+//	reader/writer locks, locks, and condition variables.  The
+//	implementation for semaphores and reader/writer locks is given;
+//	for the latter two, only the procedure interface is given --
+//	they are to be implemented as part of the first assignment.
 //
 //	Note that all the synchronization objects take a "name" as
 //	part of the initialization.  This is solely for debugging purposes.
@@ -51,6 +51,41 @@ class Semaphore {
     List *queue;       // threads waiting in P() for the value to be > 0
 };
 
+// The following class defines a "reader/writer lock".  Any number of
+// threads may hold it shared, to read the data it protects, as long as
+// no thread holds it exclusive, to change that data:
+//
+//	AcquireShared/ReleaseShared -- read, alongside other readers
+//
+//	AcquireExclusive/ReleaseExclusive -- change, with no one else
+//		holding the lock
+//
+// Once a thread is waiting to change the data, new readers wait behind
+// it, so that a stream of readers cannot keep a writer out forever.
+// Like semaphores, it is implemented by disabling interrupts.
+
+class RWLock {
+  public:
+    RWLock(char* debugName);		// initialize, held by no one
+    ~RWLock();				// de-allocate; assume no one
+					// holds or is waiting for it
+    char* getName() { return name; }	// debugging assist
+
+    void AcquireShared();
+    void ReleaseShared();
+    void AcquireExclusive();
+    void ReleaseExclusive();
+
+  private:
+    char* name;				// for debugging
+    int readers;			// # of threads holding it shared
+    bool writing;			// is a thread holding it exclusive?
+    List *readQueue;			// threads waiting to read
+    List *writeQueue;			// threads waiting to write
+    int writersWaiting;			// # of threads in writeQueue
+    void WakeWaiters();			// let the next waiters in
+};
+
 // The following class defines a "lock".  A lock can be BUSY or FREE.
 // There are only two operations allowed on a lock: 
 //
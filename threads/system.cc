@@ -25,10 +25,16 @@ FileSystem  *fileSystem;
 
 #ifdef FILESYS
 SynchDisk   *synchDisk;
+SynchDisk   *synchDisks[MaxDisks];
+int numDisks;
+FileHeaderTable *fileHeaderTable;
+Journal *journal;
+DiskTrace *diskTrace;
 #endif
 
 #ifdef USER_PROGRAM	// requires either FILESYS or FILESYS_STUB
 Machine *machine;	// user program memory and registers
+SynchConsole *synchConsole;
 #endif
 
 #ifdef NETWORK
@@ -87,9 +93,19 @@ Initialize(int argc, char **argv)
 #ifdef FILESYS_NEEDED
     bool format = FALSE;	// format disk
 #endif
+#ifdef FILESYS
+    char *diskNames[MaxDisks];	// UNIX files holding the disks
+    DiskBacking diskBacking = DiskFile;	// how the disks use them
+    int raidLevel = -1;			// if not -1, make them one disk
+    DiskModel diskModel;		// how the drives behave
+    int sectorsPerTrack = DefaultSectorsPerTrack;
+    int numTracks = DefaultNumTracks;	// geometry of new disks
+    char *traceName = NULL;		// where to record disk requests
+#endif
 #ifdef NETWORK
     double rely = 1;		// network reliability
     int netname = 0;		// UNIX socket name
+    int ringSize = 1;		// packets the network holds each way
 #endif
     
     for (argc--, argv++; argc > 0; argc -= argCount, argv += argCount) {
@@ -116,6 +132,43 @@ Initialize(int argc, char **argv)
 	if (!strcmp(*argv, "-f"))
 	    format = TRUE;
 #endif
+#ifdef FILESYS
+	if (!strcmp(*argv, "-disk")) {
+	    ASSERT(argc > 1 && numDisks < MaxDisks);
+	    diskNames[numDisks++] = *(argv + 1);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-geom")) {
+	    ASSERT(argc > 2);
+	    sectorsPerTrack = atoi(*(argv + 1));
+	    numTracks = atoi(*(argv + 2));
+	    ASSERT(sectorsPerTrack > 0 && numTracks > 0	// room for the log?
+		&& numTracks <= MaxFileSectors * BitsInSector / sectorsPerTrack
+		&& JournalFits(sectorsPerTrack * numTracks));
+	    argCount = 3;
+	} else if (!strcmp(*argv, "-raid")) {
+	    ASSERT(argc > 1);
+	    raidLevel = atoi(*(argv + 1));
+	    ASSERT(raidLevel == 0 || raidLevel == 1);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-dcache")) {
+	    ASSERT(argc > 1);
+	    diskModel.cacheSectors = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-dqueue")) {
+	    ASSERT(argc > 1);
+	    diskModel.queueDepth = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-dtrace")) {
+	    ASSERT(argc > 1);
+	    traceName = *(argv + 1);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-dahead"))
+	    diskModel.readAhead = TRUE;
+	else if (!strcmp(*argv, "-dmap"))
+	    diskBacking = DiskMapped;
+	else if (!strcmp(*argv, "-dsync"))
+	    diskBacking = DiskMappedSync;
+#endif
 #ifdef NETWORK
 	if (!strcmp(*argv, "-l")) {
 	    ASSERT(argc > 1);
@@ -125,6 +178,11 @@ Initialize(int argc, char **argv)
 	    ASSERT(argc > 1);
 	    netname = atoi(*(argv + 1));
 	    argCount = 2;
+	} else if (!strcmp(*argv, "-nring")) {
+	    ASSERT(argc > 1);
+	    ringSize = atoi(*(argv + 1));
+	    ASSERT(ringSize > 0 && ringSize <= MaxNetworkRing);
+	    argCount = 2;
 	}
 #endif
     }
@@ -152,7 +210,27 @@ Initialize(int argc, char **argv)
 #endif
 
 #ifdef FILESYS
-    synchDisk = new SynchDisk("DISK");
+    if (numDisks == 0)
+	diskNames[numDisks++] = "DISK";
+    if (raidLevel != -1) {		// all the disks, as one
+	synchDisks[0] = new SynchDisk(diskNames, numDisks,
+	    (raidLevel == 0) ? Raid0 : Raid1, diskBacking,
+	    sectorsPerTrack, numTracks);
+	numDisks = 1;
+    } else {
+	for (int i = 0; i < numDisks; i++)
+	    synchDisks[i] = new SynchDisk(&diskNames[i], 1, Raid0,
+		diskBacking, sectorsPerTrack, numTracks);
+    }
+    for (int i = 0; i < numDisks; i++)
+	synchDisks[i]->SetModel(&diskModel);
+    synchDisk = synchDisks[0];
+    if (traceName != NULL) {
+	diskTrace = new DiskTrace(traceName, FALSE);
+	synchDisk->SetTrace(diskTrace);
+    }
+    fileHeaderTable = new FileHeaderTable(NumCachedHeaders);
+    journal = new Journal;
 #endif
 
 #ifdef FILESYS_NEEDED
@@ -160,7 +238,7 @@ Initialize(int argc, char **argv)
 #endif
 
 #ifdef NETWORK
-    postOffice = new PostOffice(netname, rely, 10);
+    postOffice = new PostOffice(netname, rely, 10, ringSize);
 #endif
 }
 
@@ -177,6 +255,7 @@ Cleanup()
 #endif
     
 #ifdef USER_PROGRAM
+    delete synchConsole;
     delete machine;
 #endif
 
@@ -185,7 +264,11 @@ Cleanup()
 #endif
 
 #ifdef FILESYS
-    delete synchDisk;
+    delete journal;
+    delete fileHeaderTable;
+    for (int i = 0; i < numDisks; i++)
+	delete synchDisks[i];
+    delete diskTrace;			// writes out the last of the trace
 #endif
     
     delete timer;
@@ -31,7 +31,10 @@ extern Timer *timer;				// the hardware alarm clock
 
 #ifdef USER_PROGRAM
 #include "machine.h"
+#include "synchconsole.h"
 extern Machine* machine;	// user program memory and registers
+extern SynchConsole *synchConsole;	// the console, once something
+					//  uses it
 #endif
 
 #ifdef FILESYS_NEEDED 		// FILESYS or FILESYS_STUB 
@@ -41,7 +44,17 @@ extern FileSystem  *fileSystem;
 
 #ifdef FILESYS
 #include "synchdisk.h"
-extern SynchDisk   *synchDisk;
+#include "filehdr.h"
+#include "journal.h"
+#define MaxDisks	8
+extern SynchDisk   *synchDisk;			// the file system's disk
+extern SynchDisk   *synchDisks[MaxDisks];	// every disk (or array of them),
+						//  synchDisk first
+extern int numDisks;
+extern FileHeaderTable *fileHeaderTable;	// in-core file headers
+extern Journal *journal;			// metadata log
+extern DiskTrace *diskTrace;			// synchDisk's requests, if
+						//  they are being recorded
 #endif
 
 #ifdef NETWORK
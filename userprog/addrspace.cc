@@ -11,6 +11,14 @@
 //		(if you haven't implemented the file system yet, you
 //		don't need to do this last step)
 //
+//	A program can also map files into its address space, above the
+//	stack.  Pages of a mapped file start out invalid; the first time
+//	the program touches one, the page fault brings it in from the
+//	file.  Physical pages not used by the program itself hold the
+//	mapped pages, and are replaced in clock order when they run out;
+//	a page the program has written to is written back to the file
+//	when it is replaced, or when the file is unmapped.
+//
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -19,6 +27,7 @@
 #include "system.h"
 #include "addrspace.h"
 #include "noff.h"
+#include "syscall.h"
 #ifdef HOST_SPARC
 #include <strings.h>
 #endif
@@ -85,8 +94,23 @@ AddrSpace::AddrSpace(OpenFile *executable)
 
     DEBUG('a', "Initializing address space, num pages %d, size %d\n", 
 					numPages, size);
-// first, set up the translation 
-    pageTable = new TranslationEntry[numPages];
+// first, set up the translation; the pages for mapped files come after
+// the program's own, and are invalid until something is mapped there
+    pageTable = new TranslationEntry[numPages + MaxMappedPages];
+    for (i = numPages; i < numPages + MaxMappedPages; i++) {
+	pageTable[i].virtualPage = i;
+	pageTable[i].physicalPage = -1;
+	pageTable[i].valid = FALSE;
+	pageTable[i].use = pageTable[i].dirty = FALSE;
+	pageTable[i].readOnly = FALSE;
+    }
+    for (i = 0; i < MaxMappings; i++)
+	mappings[i].file = NULL;
+    for (i = 0; i < MaxOpenFiles; i++)
+	openFiles[i] = NULL;
+    for (i = 0; i < NumPhysPages; i++)		// the program gets the first
+	frameOwner[i] = -1;			// numPages physical pages
+    clockHand = numPages;
     for (i = 0; i < numPages; i++) {
 	pageTable[i].virtualPage = i;	// for now, virtual page # = phys page #
 	pageTable[i].physicalPage = i;
@@ -120,12 +144,18 @@ AddrSpace::AddrSpace(OpenFile *executable)
 
 //----------------------------------------------------------------------
 // AddrSpace::~AddrSpace
-// 	Dealloate an address space.  Nothing for now!
+// 	Dealloate an address space, first unmapping any mapped files,
+//	so that what the program wrote to them is not lost.
 //----------------------------------------------------------------------
 
 AddrSpace::~AddrSpace()
 {
-   delete pageTable;
+   for (int i = 0; i < MaxMappings; i++)
+	if (mappings[i].file != NULL)
+	    Munmap(mappings[i].firstPage * PageSize);
+   for (int i = 0; i < MaxOpenFiles; i++)
+	delete openFiles[i];
+   delete [] pageTable;
 }
 
 //----------------------------------------------------------------------
@@ -182,5 +212,271 @@ void AddrSpace::SaveState()
 void AddrSpace::RestoreState() 
 {
     machine->pageTable = pageTable;
-    machine->pageTableSize = numPages;
+    machine->pageTableSize = numPages + MaxMappedPages;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Mmap
+// 	Map all of "file" into the address space, in the first run of
+//	free virtual pages for mapped files that is big enough.  Nothing
+//	is read in yet; the pages are brought in as they are touched.
+//	From now on the address space owns "file", and deletes it when
+//	the file is unmapped.
+//
+//	Return the virtual address the file starts at, or -1 if there
+//	is no room for it, or no physical page left to hold its pages.
+//
+//	"file" -- the open file to map
+//----------------------------------------------------------------------
+
+int
+AddrSpace::Mmap(OpenFile *file)
+{
+    int length = file->Length();
+    int pages = divRoundUp(length, PageSize);
+    int slot, first, i;
+    Mapping *m;
+
+    if (pages == 0 || numPages == NumPhysPages)
+	return -1;			// empty file, or no memory to spare
+    for (slot = 0; slot < MaxMappings; slot++)
+	if (mappings[slot].file == NULL)
+	    break;
+    if (slot == MaxMappings)
+	return -1;			// too many mappings
+
+    for (first = numPages; first + pages <= (int) numPages + MaxMappedPages;
+								first++) {
+	for (i = 0; i < MaxMappings; i++) {
+	    m = &mappings[i];
+	    if (m->file != NULL && first < m->firstPage + m->numPages
+				&& m->firstPage < first + pages)
+		break;			// overlaps mapping "i"
+	}
+	if (i == MaxMappings) {
+	    m = &mappings[slot];
+	    m->file = file;
+	    m->firstPage = first;
+	    m->numPages = pages;
+	    m->length = length;
+	    DEBUG('a', "Mapped %d bytes at 0x%x\n", length, first * PageSize);
+	    return first * PageSize;
+	}
+	first = m->firstPage + m->numPages - 1;	// skip past it
+    }
+    return -1;				// no room in the address space
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Munmap
+// 	Unmap the file mapped at "addr": write back every page of it
+//	the program has written to, free the physical pages it was in,
+//	and close the file.  Return FALSE if no file is mapped at "addr".
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::Munmap(int addr)
+{
+    Mapping *m = NULL;
+    int i;
+
+    for (i = 0; i < MaxMappings; i++)
+	if (mappings[i].file != NULL
+		&& mappings[i].firstPage * PageSize == addr)
+	    m = &mappings[i];
+    if (m == NULL)
+	return FALSE;
+    for (i = m->firstPage; i < m->firstPage + m->numPages; i++)
+	if (pageTable[i].valid)
+	    Evict(i);
+    delete m->file;
+    m->file = NULL;
+    DEBUG('a', "Unmapped the file at 0x%x\n", addr);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Translate
+// 	Return the physical address that virtual address "virtAddr" maps
+//	to, so that the kernel can move data straight to or from the
+//	user program's memory, the way the MMU would: the page's use bit,
+//	and if "writing", its dirty bit, are set.
+//
+//	Return -1 if "virtAddr" is not in the address space, or if the
+//	program can't write to it.  A page of a mapped file that isn't
+//	in memory is brought in if "bringIn", and otherwise -1 is
+//	returned; bringing in a page may replace another mapped page.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::Translate(int virtAddr, bool writing, bool bringIn)
+{
+    unsigned int vpn = (unsigned) virtAddr / PageSize;
+    TranslationEntry *entry;
+
+    if (virtAddr < 0 || vpn >= numPages + MaxMappedPages)
+	return -1;
+    entry = &pageTable[vpn];
+    if (!entry->valid && !(bringIn && PageFault(virtAddr)))
+	return -1;
+    if (writing && entry->readOnly)
+	return -1;
+    entry->use = TRUE;
+    if (writing)
+	entry->dirty = TRUE;
+    return entry->physicalPage * PageSize + virtAddr % PageSize;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::AddOpenFile
+// 	Give "file" the lowest free OpenFileId, and return it; from now on
+//	the address space owns "file".  Return -1 if the program already
+//	has as many files open as it can.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::AddOpenFile(OpenFile *file)
+{
+    for (int id = ConsoleOutput + 1; id < MaxOpenFiles; id++)
+	if (openFiles[id] == NULL) {
+	    openFiles[id] = file;
+	    return id;
+	}
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::FindOpenFile
+// 	Return the file with OpenFileId "id", or NULL if there is none.
+//----------------------------------------------------------------------
+
+OpenFile *
+AddrSpace::FindOpenFile(int id)
+{
+    if (id < 0 || id >= MaxOpenFiles)
+	return NULL;
+    return openFiles[id];
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CloseFile
+// 	Close the file with OpenFileId "id", so that the id can be used
+//	again.  Return FALSE if there is no such file.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::CloseFile(int id)
+{
+    OpenFile *file = FindOpenFile(id);
+
+    if (file == NULL)
+	return FALSE;
+    delete file;
+    openFiles[id] = NULL;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::FindMapping
+// 	Return the mapping that virtual page "vpn" belongs to, or NULL.
+//----------------------------------------------------------------------
+
+Mapping *
+AddrSpace::FindMapping(int vpn)
+{
+    for (int i = 0; i < MaxMappings; i++)
+	if (mappings[i].file != NULL && vpn >= mappings[i].firstPage
+		&& vpn < mappings[i].firstPage + mappings[i].numPages)
+	    return &mappings[i];
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::PageFault
+// 	The program touched "badVAddr", which had no valid translation.
+//	If it is in a mapped file, find a physical page for it, and fill
+//	it from the file (through the file system, and so its buffer
+//	cache); the faulting instruction is then simply tried again.
+//	The part of the last page past the end of the file reads as 0.
+//
+//	Return FALSE if "badVAddr" isn't in any mapped file.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::PageFault(int badVAddr)
+{
+    int vpn = (unsigned) badVAddr / PageSize;
+    Mapping *m = FindMapping(vpn);
+    int frame, offset;
+    char *page;
+
+    if (m == NULL)
+	return FALSE;
+    stats->numPageFaults++;
+    frame = FindFrame();
+    page = &machine->mainMemory[frame * PageSize];
+    offset = (vpn - m->firstPage) * PageSize;
+    DEBUG('a', "Page fault at 0x%x: reading file offset %d into page %d\n",
+		badVAddr, offset, frame);
+    bzero(page, PageSize);
+    m->file->ReadAt(page, min(PageSize, m->length - offset), offset);
+
+    frameOwner[frame] = vpn;
+    pageTable[vpn].physicalPage = frame;
+    pageTable[vpn].valid = TRUE;
+    pageTable[vpn].use = FALSE;
+    pageTable[vpn].dirty = FALSE;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::FindFrame
+// 	Return a free physical page for a mapped file.  If there is none,
+//	sweep the clock hand over the pages holding mapped files, giving
+//	each page that has been used since the last sweep another chance,
+//	and replace the first one that hasn't.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::FindFrame()
+{
+    int frame, vpn;
+
+    for (frame = numPages; frame < NumPhysPages; frame++)
+	if (frameOwner[frame] == -1)
+	    return frame;
+    for (;;) {
+	frame = clockHand;
+	clockHand = (clockHand + 1 < NumPhysPages) ? clockHand + 1 : numPages;
+	vpn = frameOwner[frame];
+	if (!pageTable[vpn].use)
+	    break;
+	pageTable[vpn].use = FALSE;
+    }
+    Evict(vpn);
+    return frame;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Evict
+// 	Take virtual page "vpn", of a mapped file, out of memory.  If the
+//	program has written to it, first write it back to the file, up to
+//	the end of the file.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::Evict(int vpn)
+{
+    Mapping *m = FindMapping(vpn);
+    int frame = pageTable[vpn].physicalPage;
+    int offset = (vpn - m->firstPage) * PageSize;
+
+    ASSERT(pageTable[vpn].valid);
+    if (pageTable[vpn].dirty) {
+	DEBUG('a', "Writing back page %d to file offset %d\n", vpn, offset);
+	m->file->WriteAt(&machine->mainMemory[frame * PageSize],
+			min(PageSize, m->length - offset), offset);
+    }
+    pageTable[vpn].valid = FALSE;
+    frameOwner[frame] = -1;
 }
@@ -18,6 +18,26 @@
 
 #define UserStackSize		1024 	// increase this as necessary!
 
+// Files can be mapped into the virtual pages just above the stack.
+// A mapped page is only brought into memory when the program touches
+// it, into one of the physical pages the program itself isn't using.
+#define MaxMappings		4	// files mapped at once
+#define MaxMappedPages		128	// virtual pages for mapped files
+
+#define MaxOpenFiles		16	// files a program can have open,
+					// counting the console
+
+// A file mapped into the address space, at virtual pages "firstPage"
+// through firstPage + numPages - 1.
+
+class Mapping {
+  public:
+    OpenFile *file;			// The file, NULL if the slot is free
+    int firstPage;			// First virtual page of the mapping
+    int numPages;			// Pages it covers
+    int length;				// Length of the file, in bytes
+};
+
 class AddrSpace {
   public:
     AddrSpace(OpenFile *executable);	// Create an address space,
@@ -31,11 +51,40 @@ class AddrSpace {
     void SaveState();			// Save/restore address space-specific
     void RestoreState();		// info on a context switch 
 
+    int Mmap(OpenFile *file);		// Map "file" into the address space,
+					// returning its virtual address
+    bool Munmap(int addr);		// Write back and unmap the file
+					// mapped at "addr"
+    bool PageFault(int badVAddr);	// Bring in the page of a mapped file
+					// holding "badVAddr"; FALSE if it
+					// isn't in any mapping
+
+    int Translate(int virtAddr, bool writing, bool bringIn);
+					// Physical address of "virtAddr",
+					// or -1 if it isn't in memory
+
+    int AddOpenFile(OpenFile *file);	// Give "file" an OpenFileId
+    OpenFile *FindOpenFile(int id);	// The file with OpenFileId "id"
+    bool CloseFile(int id);		// Close it, and free the id
+
   private:
     TranslationEntry *pageTable;	// Assume linear page table translation
 					// for now!
     unsigned int numPages;		// Number of pages in the virtual 
-					// address space
+					// address space, not counting the
+					// pages for mapped files
+    Mapping mappings[MaxMappings];	// Files mapped into the space
+    int frameOwner[NumPhysPages];	// Virtual page in each physical
+					// page for mapped files, -1 if free
+    int clockHand;			// Next physical page to consider
+					// replacing
+    OpenFile *openFiles[MaxOpenFiles];	// Indexed by OpenFileId; ids 0
+					// and 1 are the console
+
+    Mapping *FindMapping(int vpn);	// Which mapping holds page "vpn"?
+    int FindFrame();			// Find (or make) a free physical page
+    void Evict(int vpn);		// Write back the page if it is dirty,
+					// and take it out of memory
 };
 
 #endif // ADDRSPACE_H
@@ -22,6 +22,8 @@ BitMap::BitMap(int nitems)
     numBits = nitems;
     numWords = divRoundUp(numBits, BitsInWord);
     map = new unsigned int[numWords];
+    numSectors = divRoundUp(numBits, BitsInSector);
+    dirty = new bool[numSectors];
     for (int i = 0; i < numBits; i++) 
         Clear(i);
 }
@@ -34,6 +36,7 @@ BitMap::BitMap(int nitems)
 BitMap::~BitMap()
 { 
     delete map;
+    delete [] dirty;
 }
 
 //----------------------------------------------------------------------
@@ -48,6 +51,7 @@ BitMap::Mark(int which)
 { 
     ASSERT(which >= 0 && which < numBits);
     map[which / BitsInWord] |= 1 << (which % BitsInWord);
+    dirty[which / BitsInSector] = TRUE;
 }
     
 //----------------------------------------------------------------------
@@ -62,6 +66,7 @@ BitMap::Clear(int which)
 {
     ASSERT(which >= 0 && which < numBits);
     map[which / BitsInWord] &= ~(1 << (which % BitsInWord));
+    dirty[which / BitsInSector] = TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -102,6 +107,30 @@ BitMap::Find()
     return -1;
 }
 
+//----------------------------------------------------------------------
+// BitMap::FindRun
+// 	Return the # of the first of "n" consecutive clear bits, and as
+//	a side effect, set them all.  The first such run is used.
+//	If there is no run that long, return -1.
+//----------------------------------------------------------------------
+
+int
+BitMap::FindRun(int n)
+{
+    int start = 0;
+
+    for (int i = 0; i < numBits; i++) {
+	if (Test(i))
+	    start = i + 1;
+	else if (i - start + 1 == n) {
+	    for (int j = start; j <= i; j++)
+		Mark(j);
+	    return start;
+	}
+    }
+    return -1;
+}
+
 //----------------------------------------------------------------------
 // BitMap::NumClear
 // 	Return the number of clear bits in the bitmap.
@@ -149,11 +178,16 @@ void
 BitMap::FetchFrom(OpenFile *file) 
 {
     file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    for (int i = 0; i < numSectors; i++)
+	dirty[i] = FALSE;
 }
 
 //----------------------------------------------------------------------
 // BitMap::WriteBack
-// 	Store the contents of a bitmap to a Nachos file.
+// 	Store the contents of a bitmap to a Nachos file.  Only the
+//	sectors of the file with bits that were set or cleared since the
+//	last FetchFrom or WriteBack are written, each run of them at
+//	once; a new bitmap has all of them to write.
 //
 //	"file" is the place to write the bitmap to
 //----------------------------------------------------------------------
@@ -161,5 +195,17 @@ BitMap::FetchFrom(OpenFile *file)
 void
 BitMap::WriteBack(OpenFile *file)
 {
-   file->WriteAt((char *)map, numWords * sizeof(unsigned), 0);
+    int first, last, length = numWords * sizeof(unsigned);
+
+    for (first = 0; first < numSectors; first = last) {
+	if (!dirty[first]) {
+	    last = first + 1;
+	    continue;
+	}
+	for (last = first; last < numSectors && dirty[last]; last++)
+	    dirty[last] = FALSE;
+	(void) file->WriteAt((char *)map + first * SectorSize,
+			min(last * SectorSize, length) - first * SectorSize,
+			first * SectorSize);
+    }
 }
@@ -18,11 +18,16 @@
 #include "copyright.h"
 #include "utility.h"
 #include "openfile.h"
+#include "disk.h"
 
 // Definitions helpful for representing a bitmap as an array of integers
 #define BitsInByte 	8
 #define BitsInWord 	32
 
+// When the bitmap is kept in a file, WriteBack only writes the sectors
+// of the file with bits that have changed.
+#define BitsInSector	(SectorSize * BitsInByte)
+
 // The following class defines a "bitmap" -- an array of bits,
 // each of which can be independently set, cleared, and tested.
 //
@@ -44,13 +49,15 @@ class BitMap {
 				// effect, set the bit. 
 				// If no bits are clear, return -1.
     int NumClear();		// Return the number of clear bits
+    int FindRun(int n);		// Find "n" clear bits in a row, set them,
+				// and return the first; -1 if there are none
 
     void Print();		// Print contents of bitmap
     
     // These aren't needed until FILESYS, when we will need to read and 
     // write the bitmap to a file
     void FetchFrom(OpenFile *file); 	// fetch contents from disk 
-    void WriteBack(OpenFile *file); 	// write contents to disk
+    void WriteBack(OpenFile *file); 	// write changed contents to disk
 
   private:
     int numBits;			// number of bits in the bitmap
@@ -59,6 +66,9 @@ class BitMap {
 					//  multiple of the number of bits in
 					//  a word)
     unsigned int *map;			// bit storage
+    int numSectors;			// sectors of map, once in a file
+    bool *dirty;			// which of them have changed since
+					//  FetchFrom or WriteBack
 };
 
 #endif // BITMAP_H
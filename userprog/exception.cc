@@ -4,8 +4,9 @@
 //	transfer back to here from user code:
 //
 //	syscall -- The user code explicitly requests to call a procedure
-//	in the Nachos kernel.  Right now, the only function we support is
-//	"Halt".
+//	in the Nachos kernel.  Right now, we support "Halt", the file
+//	operations "Create", "Open", "Read", "Write" and "Close", and
+//	"Mmap" and "Munmap" to map files into the address space.
 //
 //	exceptions -- The user code does something that the CPU can't handle.
 //	For instance, accessing memory that doesn't exist, arithmetic errors,
@@ -14,8 +15,9 @@
 //	Interrupts (which can also cause control to transfer from user
 //	code into the Nachos kernel) are handled elsewhere.
 //
-// For now, this only handles the Halt() system call.
-// Everything else core dumps.
+// For now, this only handles the system calls above, on files and on
+// the console (ConsoleInput and ConsoleOutput), and page faults on
+// mapped files.  Everything else core dumps.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -25,6 +27,101 @@
 #include "system.h"
 #include "syscall.h"
 
+#define MaxUserString	256	// longest string a system call accepts
+
+//----------------------------------------------------------------------
+// AdvancePC
+// 	Step the user program past the system call instruction, so that
+//	when we return to it, it carries on after the call.
+//----------------------------------------------------------------------
+
+static void
+AdvancePC()
+{
+    machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
+    machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
+    machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg) + 4);
+}
+
+//----------------------------------------------------------------------
+// ReadUserString
+// 	Copy the '\0'-terminated string at "addr" in the user program's
+//	address space into "buf", which has room for "size" bytes.
+//	Return FALSE if the string can't be read, or is too long.
+//----------------------------------------------------------------------
+
+static bool
+ReadUserString(int addr, char *buf, int size)
+{
+    int value;
+
+    for (int i = 0; i < size; i++) {
+	if (!machine->ReadMem(addr + i, 1, &value)
+		&& !machine->ReadMem(addr + i, 1, &value))
+	    return FALSE;		// retry once, after a page fault
+	buf[i] = (char) value;
+	if (buf[i] == '\0')
+	    return TRUE;
+    }
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// UserIO
+// 	Read "size" bytes from "file" into the user program's buffer at
+//	"addr", or if "writing", write them from the buffer to the file.
+//	Return the number of bytes transferred, which is less than "size"
+//	at the end of the file, or if the buffer runs off the end of the
+//	address space.  A NULL "file" is the console, which reads no
+//	more than one line.
+//
+//	Rather than copy a byte at a time through ReadMem and WriteMem,
+//	we find where each page of the buffer is in physical memory, and
+//	hand the file system pointers straight into it.  Pages next to
+//	each other in physical memory go in one request, so that a large
+//	aligned buffer is moved a whole run of sectors at a time, between
+//	the disk (or buffer cache) and the program's memory, with no copy
+//	in between.  A run stops at a page of a mapped file that is not in
+//	memory, since bringing it in could replace a page already in the
+//	run.
+//----------------------------------------------------------------------
+
+static int
+UserIO(int addr, int size, OpenFile *file, bool writing)
+{
+    AddrSpace *space = currentThread->space;
+    int done = 0, start, runLen, next, result;
+
+    while (done < size) {
+	// reading the file means writing the program's memory
+	start = space->Translate(addr + done, !writing, TRUE);
+	if (start == -1)
+	    break;
+	runLen = min(size - done, PageSize - start % PageSize);
+	while (done + runLen < size) {
+	    next = space->Translate(addr + done + runLen, !writing, FALSE);
+	    if (next != start + runLen)
+		break;
+	    runLen += min(size - done - runLen, PageSize);
+	}
+	if (file == NULL && writing) {
+	    synchConsole->Write(&machine->mainMemory[start], runLen);
+	    result = runLen;
+	} else if (file == NULL) {
+	    result = synchConsole->Read(&machine->mainMemory[start], runLen);
+	    if (machine->mainMemory[start + result - 1] == '\n')
+		return done + result;	// that was the whole line
+	} else if (writing)
+	    result = file->Write(&machine->mainMemory[start], runLen);
+	else
+	    result = file->Read(&machine->mainMemory[start], runLen);
+	done += result;
+	if (result < runLen)
+	    break;
+    }
+    return done;
+}
+
 //----------------------------------------------------------------------
 // ExceptionHandler
 // 	Entry point into the Nachos kernel.  Called when a user program
@@ -52,10 +149,84 @@ void
 ExceptionHandler(ExceptionType which)
 {
     int type = machine->ReadRegister(2);
+    char name[MaxUserString];
+    OpenFile *file;
+    int result, size, ticks, millis;
 
     if ((which == SyscallException) && (type == SC_Halt)) {
 	DEBUG('a', "Shutdown, initiated by user program.\n");
+	if (synchConsole != NULL)
+	    synchConsole->Flush();	// let the display catch up
    	interrupt->Halt();
+    } else if ((which == SyscallException) && (type == SC_Create)) {
+	if (ReadUserString(machine->ReadRegister(4), name, MaxUserString))
+	    fileSystem->Create(name, 0);
+	AdvancePC();
+    } else if ((which == SyscallException) && (type == SC_Open)) {
+	result = -1;
+	if (ReadUserString(machine->ReadRegister(4), name, MaxUserString)
+		&& (file = fileSystem->Open(name)) != NULL) {
+	    result = currentThread->space->AddOpenFile(file);
+	    if (result == -1)
+		delete file;
+	}
+	machine->WriteRegister(2, result);
+	AdvancePC();
+    } else if ((which == SyscallException)
+		&& (type == SC_Read || type == SC_Write)) {
+	file = currentThread->space->FindOpenFile(machine->ReadRegister(6));
+	size = machine->ReadRegister(5);
+	result = -1;
+	if (machine->ReadRegister(6)
+		== ((type == SC_Write) ? ConsoleOutput : ConsoleInput)) {
+	    if (synchConsole == NULL)
+		synchConsole = new SynchConsole(NULL, NULL);
+	    if (size >= 0)
+		result = UserIO(machine->ReadRegister(4), size, NULL,
+							type == SC_Write);
+	} else if (file != NULL && size >= 0) {
+	    ticks = stats->totalTicks;
+	    millis = HostMilliseconds();
+	    if (type == SC_Write && file->Position() + size > file->Length())
+		fileSystem->Extend(file, file->Position() + size);
+	    result = UserIO(machine->ReadRegister(4), size, file,
+							type == SC_Write);
+	    stats->userIOTicks += stats->totalTicks - ticks;
+	    stats->userIOMillis += HostMilliseconds() - millis;
+	    if (type == SC_Write)
+		stats->numUserBytesWritten += result;
+	    else
+		stats->numUserBytesRead += result;
+	}
+	DEBUG('a', "%s of %d bytes returns %d\n",
+		(type == SC_Write) ? "Write" : "Read", size, result);
+	machine->WriteRegister(2, result);
+	AdvancePC();
+    } else if ((which == SyscallException) && (type == SC_Close)) {
+	currentThread->space->CloseFile(machine->ReadRegister(4));
+	AdvancePC();
+    } else if ((which == SyscallException) && (type == SC_Mmap)) {
+	result = -1;
+	if (ReadUserString(machine->ReadRegister(4), name, MaxUserString)) {
+	    if ((file = fileSystem->Open(name)) != NULL) {
+		result = currentThread->space->Mmap(file);
+		if (result == -1)
+		    delete file;
+	    }
+	    DEBUG('a', "Mmap of \"%s\" returns 0x%x\n", name, result);
+	}
+	machine->WriteRegister(2, result);
+	AdvancePC();
+    } else if ((which == SyscallException) && (type == SC_Munmap)) {
+	if (currentThread->space->Munmap(machine->ReadRegister(4)))
+	    machine->WriteRegister(2, 0);
+	else
+	    machine->WriteRegister(2, -1);
+	AdvancePC();
+    } else if ((which == PageFaultException)
+		&& currentThread->space->PageFault(
+				machine->ReadRegister(BadVAddrReg))) {
+	// the page is in memory now; return to retry the instruction
     } else {
 	printf("Unexpected user mode exception %d %d\n", which, type);
 	ASSERT(FALSE);
@@ -2,7 +2,8 @@
 //	Test routines for demonstrating that Nachos can load
 //	a user program and execute it.  
 //
-//	Also, routines for testing the Console hardware device.
+//	Also, routines for testing the Console hardware device, and
+//	the SynchConsole built on it.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -11,6 +12,7 @@
 #include "copyright.h"
 #include "system.h"
 #include "console.h"
+#include "synchconsole.h"
 #include "addrspace.h"
 #include "synch.h"
 
@@ -82,3 +84,66 @@ ConsoleTest (char *in, char *out)
 	if (ch == 'q') return;  // if q, quit
     }
 }
+
+//----------------------------------------------------------------------
+// ConsoleReport
+// 	Print how long the console took to display something, and in how
+//	many requests, since "ticks" and "requests".
+//----------------------------------------------------------------------
+
+static void
+ConsoleReport(char *what, int ticks, int requests)
+{
+    printf("%s: %d ticks, %d requests\n", what, stats->totalTicks - ticks,
+	stats->numConsoleWriteRequests - requests);
+    fflush(stdout);			// in case the display is stdout too
+}
+
+//----------------------------------------------------------------------
+// SynchConsoleTest
+// 	Test the synchronous console.  First write a line three ways: a
+//	character at a time, waiting for each to reach the display, as
+//	with no buffering; a character at a time, leaving them in the
+//	ring; and all at once; and print how long each took.  Then copy
+//	each line typed at the input back to the output.  Stop when the
+//	user types a line "q".
+//----------------------------------------------------------------------
+
+void
+SynchConsoleTest(char *in, char *out)
+{
+    char *message = "The quick brown fox jumps over the lazy dog.\n";
+    char line[ConsoleLineSize];
+    int length = strlen(message), ticks, requests, n, i;
+
+    synchConsole = new SynchConsole(in, out);
+
+    ticks = stats->totalTicks;
+    requests = stats->numConsoleWriteRequests;
+    for (i = 0; i < length; i++) {
+	synchConsole->Write(&message[i], 1);
+	synchConsole->Flush();
+    }
+    ConsoleReport("unbuffered", ticks, requests);
+
+    ticks = stats->totalTicks;
+    requests = stats->numConsoleWriteRequests;
+    for (i = 0; i < length; i++)
+	synchConsole->Write(&message[i], 1);
+    synchConsole->Flush();
+    ConsoleReport("a character at a time", ticks, requests);
+
+    ticks = stats->totalTicks;
+    requests = stats->numConsoleWriteRequests;
+    synchConsole->Write(message, length);
+    synchConsole->Flush();
+    ConsoleReport("all at once", ticks, requests);
+
+    for (;;) {
+	n = synchConsole->Read(line, ConsoleLineSize);
+	if (n == 2 && line[0] == 'q')
+	    break;
+	synchConsole->Write(line, n);
+    }
+    synchConsole->Flush();
+}
@@ -0,0 +1,261 @@
+// synchconsole.cc
+//	Routines to synchronously access the console.  The console is
+//	an asynchronous device (requests return immediately, and an
+//	interrupt happens later on).  This is a layer on top of the
+//	console providing a synchronous interface (requests wait until
+//	they can be satisfied), with ring buffers in between, so that
+//	output is sent to the display a buffer at a time, and input is
+//	edited a line at a time before anyone reads it.
+//
+//	Everything shared with the interrupt handlers is only touched
+//	with interrupts disabled.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "synchconsole.h"
+#include "system.h"
+
+// Dummy functions because C++ is weird about pointers to member functions
+static void SynchConsoleReadAvail(int c)
+{ SynchConsole *console = (SynchConsole *)c; console->ReadAvail(); }
+static void SynchConsoleWriteDone(int c)
+{ SynchConsole *console = (SynchConsole *)c; console->WriteDone(); }
+
+//----------------------------------------------------------------------
+// SynchConsole::SynchConsole
+// 	Initialize the synchronous interface to the console, in turn
+//	initializing the raw console.
+//
+//	"readFile" -- UNIX file simulating the keyboard (NULL -> use stdin)
+//	"writeFile" -- UNIX file simulating the display (NULL -> use stdout)
+//----------------------------------------------------------------------
+
+SynchConsole::SynchConsole(char *readFile, char *writeFile)
+{
+    outputHead = outputCount = sending = 0;
+    numOutput = numDisplayed = 0;
+    inputHead = inputCount = numLines = 0;
+    lineLength = 0;
+    readLock = new Semaphore("console read lock", 1);
+    writeLock = new Semaphore("console write lock", 1);
+    lineReady = new Semaphore("console line ready", 0);
+    roomReady = new Semaphore("console room ready", 0);
+    drained = new Semaphore("console drained", 0);
+    lineWaiting = roomWaiting = drainWaiting = 0;
+    console = new Console(readFile, writeFile, SynchConsoleReadAvail,
+			SynchConsoleWriteDone, (int) this);
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::~SynchConsole
+// 	De-allocate data structures needed for the synchronous console
+//	abstraction.
+//----------------------------------------------------------------------
+
+SynchConsole::~SynchConsole()
+{
+    delete console;
+    delete readLock;
+    delete writeLock;
+    delete lineReady;
+    delete roomReady;
+    delete drained;
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::Read
+// 	Wait until a whole line has been typed, then copy it into "data",
+//	stopping after the '\n', or after "size" bytes, in which case the
+//	rest of the line is left for the next Read.  Return the number of
+//	bytes copied.
+//----------------------------------------------------------------------
+
+int
+SynchConsole::Read(char *data, int size)
+{
+    IntStatus oldLevel;
+    int n = 0;
+
+    if (size <= 0)
+	return 0;
+    readLock->P();
+    oldLevel = interrupt->SetLevel(IntOff);
+    while (numLines == 0) {
+	lineWaiting++;
+	lineReady->P();
+    }
+    while (n < size) {
+	data[n] = input[inputHead];
+	inputHead = (inputHead + 1) % ConsoleBufferSize;
+	inputCount--;
+	if (data[n++] == '\n') {
+	    numLines--;
+	    break;
+	}
+    }
+    (void) interrupt->SetLevel(oldLevel);
+    readLock->V();
+    return n;
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::Write
+// 	Copy "size" bytes from "data" into the output ring, waiting for
+//	the display to make room whenever it is full, and start the
+//	display on them.  Return once they are all in the ring.
+//----------------------------------------------------------------------
+
+void
+SynchConsole::Write(char *data, int size)
+{
+    IntStatus oldLevel;
+    int done = 0, n;
+
+    writeLock->P();
+    oldLevel = interrupt->SetLevel(IntOff);
+    while (done < size) {
+	while (outputCount == ConsoleBufferSize) {
+	    roomWaiting++;
+	    roomReady->P();
+	}
+	n = min(size - done, ConsoleBufferSize - outputCount);
+	Output(&data[done], n);
+	done += n;
+	StartOutput();
+    }
+    (void) interrupt->SetLevel(oldLevel);
+    writeLock->V();
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::Flush
+// 	Wait until everything now in the output ring has gone to the
+//	display.  (Not until the ring is empty: echoes of what is being
+//	typed might keep it from ever emptying.)
+//----------------------------------------------------------------------
+
+void
+SynchConsole::Flush()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    int upTo = numOutput;
+
+    while (numDisplayed < upTo) {
+	drainWaiting++;
+	drained->P();
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::ReadAvail
+// 	Interrupt handler: a character has been typed.  Run it through
+//	the line discipline, and display the echo.
+//----------------------------------------------------------------------
+
+void
+SynchConsole::ReadAvail()
+{
+    Edit(console->GetChar());
+    StartOutput();
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::WriteDone
+// 	Interrupt handler: the display has finished the request we sent
+//	it.  Take those characters off the ring, send it whatever has
+//	been written since, and wake up anyone waiting for room, or for
+//	their output to be displayed.
+//----------------------------------------------------------------------
+
+void
+SynchConsole::WriteDone()
+{
+    outputHead = (outputHead + sending) % ConsoleBufferSize;
+    outputCount -= sending;
+    numDisplayed += sending;
+    sending = 0;
+    StartOutput();
+
+    for (; roomWaiting > 0; roomWaiting--)
+	roomReady->V();
+    for (; drainWaiting > 0; drainWaiting--)
+	drained->V();
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::Output
+// 	Add "size" bytes to the end of the output ring.  Anything that
+//	doesn't fit is dropped; Write makes sure it all fits, but the
+//	echo of typed characters can't wait for room.
+//----------------------------------------------------------------------
+
+void
+SynchConsole::Output(char *data, int size)
+{
+    for (int i = 0; i < size && outputCount < ConsoleBufferSize; i++) {
+	output[(outputHead + outputCount) % ConsoleBufferSize] = data[i];
+	outputCount++;
+	numOutput++;
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::StartOutput
+// 	If the display is free, send it everything in the output ring,
+//	up to the end of the buffer, in one request.  (What wraps around
+//	to the start of the buffer goes in the next request.)
+//----------------------------------------------------------------------
+
+void
+SynchConsole::StartOutput()
+{
+    if (sending > 0 || outputCount == 0)
+	return;					// busy, or nothing to do
+    sending = min(outputCount, ConsoleBufferSize - outputHead);
+    console->PutChars(&output[outputHead], sending);
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::Edit
+// 	The line discipline: add the typed character "ch" to the line
+//	being typed, or edit the line, and echo the result.  Once the
+//	line is finished, move it to the input ring, for Read; if there
+//	is no room for it there, it is lost.  So are characters typed
+//	past the end of a full line.
+//----------------------------------------------------------------------
+
+void
+SynchConsole::Edit(char ch)
+{
+    if (ch == '\r')
+	ch = '\n';
+    if (ch == ConsoleErase || ch == '\177') {
+	if (lineLength > 0) {
+	    lineLength--;
+	    Output("\b \b", 3);
+	}
+    } else if (ch == ConsoleKill) {
+	for (; lineLength > 0; lineLength--)
+	    Output("\b \b", 3);
+    } else if (ch == '\n') {
+	line[lineLength++] = ch;
+	Output(&ch, 1);
+	if (inputCount + lineLength <= ConsoleBufferSize) {
+	    for (int i = 0; i < lineLength; i++)
+		input[(inputHead + inputCount++) % ConsoleBufferSize] = line[i];
+	    numLines++;
+	    if (lineWaiting > 0) {
+		lineWaiting--;
+		lineReady->V();
+	    }
+	}
+	lineLength = 0;
+    } else if (lineLength < ConsoleLineSize - 1) {
+	line[lineLength++] = ch;
+	Output(&ch, 1);
+    }
+}
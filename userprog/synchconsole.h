@@ -0,0 +1,102 @@
+// synchconsole.h
+// 	Data structures to export a synchronous interface to the raw
+//	console device, for user programs.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef SYNCHCONSOLE_H
+#define SYNCHCONSOLE_H
+
+#include "console.h"
+#include "synch.h"
+
+#define ConsoleBufferSize	256	// size of each ring buffer
+#define ConsoleLineSize		128	// longest line that can be typed,
+					//  counting the '\n'
+
+// Characters the line discipline treats specially.
+#define ConsoleErase		'\b'	// erase the last character (so does
+					//  DEL)
+#define ConsoleKill		('U' & 0x1f)	// ^U: erase the whole line
+
+// The following class defines a "synchronous" console abstraction.
+// Like SynchDisk, it hides the device's interrupts: Read and Write
+// return once the data is in or out of the caller's buffer.
+//
+// Output goes into a ring buffer, and Write returns as soon as it is
+// there, without waiting for the display; whenever the display is
+// free, whatever is in the ring is sent to it in a single request
+// (Console::PutChars), so a buffer written all at once costs one
+// device interaction, not one per character.  Write only waits when
+// the ring is full.
+//
+// Input is "cooked", as on a UNIX terminal: typed characters are
+// echoed, and collected into a line that can be edited (ConsoleErase
+// and DEL erase a character, ConsoleKill the whole line; '\r' ends it
+// just like '\n').  Only when the line is finished does it go into
+// the input ring, where Read can have it.  Read waits for a whole
+// line, and returns no more than one line at a time.
+//
+// One reader and one writer at a time; others wait their turn.
+
+class SynchConsole {
+  public:
+    SynchConsole(char *readFile, char *writeFile);
+					// Initialize the console, with
+					// the UNIX files for the keyboard
+					// and display (NULL: stdin, stdout)
+    ~SynchConsole();			// De-allocate the console
+
+    int Read(char *data, int size);	// Wait for a line, and return up
+					// to "size" bytes of it, up to and
+					// including the '\n'
+    void Write(char *data, int size);	// Queue "size" bytes for the
+					// display, and return
+    void Flush();			// Wait until everything written so
+					// far is out
+
+    void ReadAvail();			// Called by the interrupt handler,
+    void WriteDone();			//  when a character is typed, and
+					//  when a write request is done
+
+  private:
+    Console *console;			// Raw console device
+
+    char output[ConsoleBufferSize];	// Ring of characters to display
+    int outputHead;			// ... first of them
+    int outputCount;			// ... how many there are
+    int sending;			// ... how many of the first have
+					//  been sent to the display
+    int numOutput;			// Characters ever put in the ring,
+    int numDisplayed;			//  and ever displayed
+
+    char input[ConsoleBufferSize];	// Ring of finished lines
+    int inputHead;			// ... first character
+    int inputCount;			// ... how many there are
+    int numLines;			// ... how many '\n's among them
+
+    char line[ConsoleLineSize];		// The line being typed
+    int lineLength;
+
+    Semaphore *readLock;		// Only one reader at a time,
+    Semaphore *writeLock;		//  and only one writer
+    Semaphore *lineReady;		// V'ed when a line is finished
+    int lineWaiting;			// ... if someone is waiting
+    Semaphore *roomReady;		// V'ed when the display takes some
+    int roomWaiting;			//  output, if someone is waiting
+    Semaphore *drained;			// V'ed when the display takes some
+    int drainWaiting;			//  output, for each Flush waiting
+
+    void Output(char *data, int size);	// Add to the output ring, dropping
+					// what doesn't fit
+    void StartOutput();			// Send the output ring to the
+					// display, if it is free
+    void Edit(char ch);			// Add to the line being typed, or
+					// edit it, and echo
+};
+
+#endif // SYNCHCONSOLE_H
@@ -29,6 +29,8 @@
 #define SC_Close	8
 #define SC_Fork		9
 #define SC_Yield	10
+#define SC_Mmap		11
+#define SC_Munmap	12
 
 #ifndef IN_ASM
 
@@ -124,6 +126,20 @@ void Fork(void (*func)());
  */
 void Yield();		
 
+/* Memory-mapped files: Mmap and Munmap. */
+
+/* Map the whole of the Nachos file "name" into the address space, and
+ * return the address it starts at, or -1 if it can't be mapped.  Pages
+ * of the file are read in as they are touched, and reads and writes
+ * through the mapping go to the file.
+ */
+int Mmap(char *name);
+
+/* Write back what was changed in the file mapped at "addr", and unmap
+ * it.  Return 0, or -1 if no file is mapped at "addr".
+ */
+int Munmap(int addr);
+
 #endif /* IN_ASM */
 
 #endif /* SYSCALL_H */